@@ -0,0 +1,77 @@
+/**
+ * Internal wrappers for waiting on and waking 32-bit words in shared memory (Linux futexes).
+ *
+ * Waiters and wakers may be in different processes, so the futexes are not private.
+ * Waiting only requires read access, so consumers may map the memory read-only.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_FUTEX_H_
+#define _ENERGYMON_FUTEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#pragma GCC visibility push(hidden)
+
+/**
+ * Block while *addr == val, for at most timeout_ns.
+ *
+ * @return 0 if woken or *addr != val, or -1 on failure (errno is set: ETIMEDOUT, EINTR, or ENOSYS if unsupported)
+ */
+static inline int energymon_futex_wait(const uint32_t* addr, uint32_t val, uint64_t timeout_ns) {
+#ifdef __linux__
+  struct timespec ts;
+  ts.tv_sec = (time_t) (timeout_ns / 1000000000);
+  ts.tv_nsec = (long) (timeout_ns % 1000000000);
+  if (syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0) && errno != EAGAIN) {
+    return -1;
+  }
+  return 0;
+#else
+  (void) addr;
+  (void) val;
+  (void) timeout_ns;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/**
+ * Wake all waiters without modifying *addr.
+ */
+static inline void energymon_futex_wake(const uint32_t* addr) {
+#ifdef __linux__
+  syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+  (void) addr;
+#endif
+}
+
+/**
+ * Increment *addr (with release semantics) and wake all waiters.
+ */
+static inline void energymon_futex_bump(uint32_t* addr) {
+  __atomic_add_fetch(addr, 1, __ATOMIC_RELEASE);
+  energymon_futex_wake(addr);
+}
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
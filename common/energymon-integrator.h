@@ -0,0 +1,175 @@
+/**
+ * Internal integration of periodic power readings into an energy total that's published to lock-free readers.
+ *
+ * A single writer (a polling thread) passes each power reading, and when it was taken, to energymon_integrator_update.
+ * Readers get the total from energymon_integrator_read.
+ * If enabled, reads extrapolate the last power reading over the time since the last update, capped at one polling
+ * interval, for finer resolution than the polling interval.
+ * Published totals never decrease, even if a later reading integrates less energy than readers extrapolated.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_INTEGRATOR_H_
+#define _ENERGYMON_INTEGRATOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include "energymon-seqlock.h"
+#include "energymon-time-util.h"
+
+#pragma GCC visibility push(hidden)
+
+// Environment variable to extrapolate energy between power readings in implementations that poll power sensors
+#define ENERGYMON_ENABLE_ESTIMATES "ENERGYMON_ENABLE_ESTIMATES"
+
+typedef struct energymon_integrator {
+  energymon_seqlock lock;
+  // published to readers
+  uint64_t total_uj;
+  uint64_t power_uw;
+  uint64_t time_us;
+  // the max time to extrapolate over, or 0 to disable extrapolation - constant after init
+  uint64_t extrapolate_us;
+  // private to the writer: the exact integrated energy, with the remainder below 1 uJ in units of 0.5 uW*us
+  uint64_t exact_uj;
+  uint64_t remainder;
+  // the last power reading and when it was taken, which anchor the next interval
+  uint64_t sample_uw;
+  uint64_t sample_us;
+  int have_sample;
+} energymon_integrator;
+
+/**
+ * @param in
+ *  the integrator
+ * @param extrapolate_us
+ *  the max time to extrapolate over (usually the polling interval), or 0 to disable extrapolation
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+static inline int energymon_integrator_init(energymon_integrator* in, uint64_t extrapolate_us) {
+  energymon_seqlock_init(&in->lock);
+  energymon_seqlock_store(&in->total_uj, 0);
+  energymon_seqlock_store(&in->power_uw, 0);
+  energymon_seqlock_store(&in->time_us, energymon_gettime_us());
+  in->extrapolate_us = extrapolate_us;
+  in->exact_uj = 0;
+  in->remainder = 0;
+  in->sample_uw = 0;
+  in->sample_us = energymon_seqlock_load(&in->time_us);
+  in->have_sample = 0;
+  return in->sample_us ? 0 : -1;
+}
+
+static inline void energymon_integrator_publish(energymon_integrator* in) {
+  uint64_t now_us;
+  uint64_t elapsed_us;
+  uint64_t total_uj = in->exact_uj;
+  uint64_t floor_uj;
+  energymon_seqlock_write_begin(&in->lock);
+  if (in->extrapolate_us) {
+    // read the clock while readers are blocked, so a reader that extrapolated from the last update read its clock first
+    now_us = energymon_gettime_us();
+    // the total is exact up to the sample time - extrapolate the rest of the way to now
+    if (in->have_sample && now_us > in->sample_us) {
+      elapsed_us = now_us - in->sample_us;
+      total_uj += in->sample_uw * (elapsed_us < in->extrapolate_us ? elapsed_us : in->extrapolate_us) / 1000000;
+    }
+    // don't publish less than readers may have already seen
+    elapsed_us = now_us - energymon_seqlock_load(&in->time_us);
+    if (elapsed_us > in->extrapolate_us) {
+      elapsed_us = in->extrapolate_us;
+    }
+    floor_uj = energymon_seqlock_load(&in->total_uj) + energymon_seqlock_load(&in->power_uw) * elapsed_us / 1000000;
+    if (total_uj < floor_uj) {
+      total_uj = floor_uj;
+    }
+    energymon_seqlock_store(&in->power_uw, in->have_sample ? in->sample_uw : 0);
+    energymon_seqlock_store(&in->time_us, now_us);
+  }
+  energymon_seqlock_store(&in->total_uj, total_uj);
+  energymon_seqlock_write_end(&in->lock);
+}
+
+/**
+ * Integrate the interval since the last update or skip with the trapezoidal rule, i.e., assuming power changed
+ * linearly between the last reading and this one.
+ * The first interval (after init or a skip) has no earlier reading, so it's integrated at this reading's power.
+ *
+ * For power with a second derivative bounded by M, the error is at most M * h^3 / 12 per interval of length h, so at
+ * most M * T * h^2 / 12 over a time T (plus less than 1 uJ from truncating totals to microjoules).
+ * This is quadratic in the polling interval, where a rectangle rule's error is linear in it (up to P' * T * h / 2 for
+ * a first derivative bounded by P'), so sources can be polled less often for the same accuracy.
+ * The time that power was sampled is uncertain by up to half the read's duration, so take sample_us at the midpoint.
+ * Must only be called by the single writer.
+ *
+ * @param in
+ *  the integrator
+ * @param power_uw
+ *  the power reading in microwatts
+ * @param sample_us
+ *  when the power was sampled, from energymon_gettime_us
+ */
+static inline void energymon_integrator_update(energymon_integrator* in, uint64_t power_uw, uint64_t sample_us) {
+  uint64_t elapsed_us = sample_us > in->sample_us ? sample_us - in->sample_us : 0;
+  // twice the energy in uW*us, to keep the trapezoid's halves exact
+  uint64_t twice_uw_us = (in->have_sample ? in->sample_uw + power_uw : 2 * power_uw) * elapsed_us + in->remainder;
+  in->remainder = twice_uw_us % 2000000;
+  in->exact_uj += twice_uw_us / 2000000;
+  in->sample_uw = power_uw;
+  in->sample_us = sample_us > in->sample_us ? sample_us : in->sample_us;
+  in->have_sample = 1;
+  energymon_integrator_publish(in);
+}
+
+/**
+ * Skip the time since the last update or skip without integrating it, e.g., if a power reading failed.
+ * Must only be called by the single writer.
+ *
+ * @param in
+ *  the integrator
+ * @param sample_us
+ *  when the reading was attempted, from energymon_gettime_us
+ */
+static inline void energymon_integrator_skip(energymon_integrator* in, uint64_t sample_us) {
+  in->sample_us = sample_us > in->sample_us ? sample_us : in->sample_us;
+  in->have_sample = 0;
+  energymon_integrator_publish(in);
+}
+
+/**
+ * Get the total energy, extrapolated to now if enabled.
+ *
+ * @return the energy in microjoules
+ */
+static inline uint64_t energymon_integrator_read(const energymon_integrator* in) {
+  uint32_t seq;
+  uint64_t total_uj;
+  uint64_t power_uw = 0;
+  uint64_t time_us = 0;
+  uint64_t now_us = 0;
+  do {
+    seq = energymon_seqlock_read_begin(&in->lock);
+    total_uj = energymon_seqlock_load(&in->total_uj);
+    if (in->extrapolate_us) {
+      power_uw = energymon_seqlock_load(&in->power_uw);
+      time_us = energymon_seqlock_load(&in->time_us);
+      now_us = energymon_gettime_us();
+    }
+  } while (energymon_seqlock_read_retry(&in->lock, seq));
+  if (now_us <= time_us) {
+    return total_uj;
+  }
+  return total_uj + power_uw * (now_us - time_us < in->extrapolate_us ? now_us - time_us : in->extrapolate_us) / 1000000;
+}
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,278 @@
+/**
+ * Internal polling engine for implementations that estimate energy by periodically reading power.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "energymon-poller.h"
+#include "energymon-time-util.h"
+
+// the shared timer thread, which runs while any non-dedicated sources are registered
+static struct {
+  pthread_cond_t cond;
+  int cond_initialized;
+  pthread_t thread;
+  int stop;
+  energymon_poller_source* sources;
+  // the source being read, which can't be stopped until the read finishes
+  const energymon_poller_source* busy;
+} engine;
+// protects the engine state and the sources list
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// serializes starting and stopping the timer thread
+static pthread_mutex_t lifecycle = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Read a source and integrate its power over the time since the last read.
+ */
+static void poll_source(energymon_poller_source* src) {
+  uint64_t power_uw = 0;
+  uint64_t start_us = energymon_gettime_us();
+  uint64_t end_us;
+  int ret;
+  int err_save;
+  errno = 0;
+  ret = src->read(src->ctx, &power_uw);
+  err_save = errno ? errno : EIO;
+  // anchor the reading to the middle of the read, since we don't know when the sensor sampled it
+  end_us = energymon_gettime_us();
+  if (ret) {
+    energymon_integrator_skip(&src->integrator, end_us);
+    fprintf(stderr, "%s: skipping power sensor reading: %s\n", src->name, strerror(err_save));
+    return;
+  }
+  energymon_integrator_update(&src->integrator, power_uw, start_us + (end_us - start_us) / 2);
+}
+
+/**
+ * Advance to the next deadline, skipping any that were missed rather than catching up.
+ */
+static void advance_deadline(energymon_poller_source* src, uint64_t now_ns) {
+  uint64_t interval_ns = src->interval_us * 1000;
+  uint64_t skip;
+  if (now_ns >= src->next_ns + interval_ns) {
+    skip = (now_ns - src->next_ns) / interval_ns;
+    src->missed += skip;
+    src->next_ns += skip * interval_ns;
+  }
+  src->next_ns += interval_ns;
+}
+
+static void* dedicated_thread(void* arg) {
+  energymon_poller_source* src = (energymon_poller_source*) arg;
+  energymon_timer timer;
+#ifndef __ANDROID__
+  int dummy_old_state;
+  // cancellation is only enabled while sleeping - canceling I/O can deadlock some devices
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &dummy_old_state);
+#endif
+  if (energymon_timer_init(&timer, src->interval_us)) {
+    // must be that CLOCK_MONOTONIC is not supported
+    perror(src->name);
+    return (void*) NULL;
+  }
+  while (1) {
+#ifndef __ANDROID__
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &dummy_old_state);
+#endif
+    energymon_timer_wait(&timer, &src->running);
+#ifndef __ANDROID__
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &dummy_old_state);
+#endif
+    if (!__atomic_load_n(&src->running, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+    poll_source(src);
+  }
+  return (void*) NULL;
+}
+
+/**
+ * Wait for the condition to be signaled or for the monotonic deadline to pass (UINT64_MAX to wait indefinitely).
+ */
+static void wait_until(uint64_t deadline_ns) {
+  struct timespec ts;
+  if (deadline_ns == UINT64_MAX) {
+    pthread_cond_wait(&engine.cond, &lock);
+    return;
+  }
+#if defined(__APPLE__) || defined(_WIN32)
+  // condition variables only support the realtime clock
+  uint64_t now_ns = energymon_gettime_ns();
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (deadline_ns > now_ns) {
+    deadline_ns = (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec + (deadline_ns - now_ns);
+  } else {
+    deadline_ns = (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+  }
+#endif
+  ts.tv_sec = (time_t) (deadline_ns / 1000000000);
+  ts.tv_nsec = (long) (deadline_ns % 1000000000);
+  pthread_cond_timedwait(&engine.cond, &lock, &ts);
+}
+
+static void* engine_thread(void* arg) {
+  energymon_poller_source* src;
+  uint64_t deadline_ns;
+  uint64_t now_ns;
+  (void) arg;
+  pthread_mutex_lock(&lock);
+  while (!engine.stop) {
+    for (deadline_ns = UINT64_MAX, src = engine.sources; src != NULL; src = src->next) {
+      if (src->next_ns < deadline_ns) {
+        deadline_ns = src->next_ns;
+      }
+    }
+    if ((now_ns = energymon_gettime_ns()) < deadline_ns) {
+      wait_until(deadline_ns);
+      continue;
+    }
+    // read every source that's due in this wakeup
+    for (src = engine.sources; src != NULL && !engine.stop;) {
+      if (src->next_ns > now_ns) {
+        src = src->next;
+        continue;
+      }
+      // the source can't be stopped (or freed) while busy
+      engine.busy = src;
+      pthread_mutex_unlock(&lock);
+      poll_source(src);
+      pthread_mutex_lock(&lock);
+      engine.busy = NULL;
+      pthread_cond_broadcast(&engine.cond);
+      advance_deadline(src, now_ns);
+      // other sources may have been stopped while unlocked, so rescan - sources already read are no longer due
+      src = engine.sources;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return (void*) NULL;
+}
+
+static int init_cond(void) {
+  pthread_condattr_t attr;
+  if ((errno = pthread_condattr_init(&attr))) {
+    return -1;
+  }
+#if !defined(__APPLE__) && !defined(_WIN32)
+  if ((errno = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC))) {
+    pthread_condattr_destroy(&attr);
+    return -1;
+  }
+#endif
+  errno = pthread_cond_init(&engine.cond, &attr);
+  pthread_condattr_destroy(&attr);
+  return errno ? -1 : 0;
+}
+
+int energymon_poller_start(energymon_poller_source* src) {
+  uint64_t interval_ns;
+  if (src == NULL || src->read == NULL || src->interval_us == 0 || src->running) {
+    errno = EINVAL;
+    return -1;
+  }
+  src->missed = 0;
+  src->next = NULL;
+  if (energymon_integrator_init(&src->integrator, getenv(ENERGYMON_ENABLE_ESTIMATES) ? src->interval_us : 0)) {
+    return -1;
+  }
+  src->running = 1;
+  if (src->dedicated) {
+    if ((errno = pthread_create(&src->thread, NULL, dedicated_thread, src))) {
+      src->running = 0;
+      return -1;
+    }
+    return 0;
+  }
+
+  // align the first deadline so that sources with aligned intervals share wakeups
+  interval_ns = src->interval_us * 1000;
+  src->next_ns = (energymon_gettime_ns() / interval_ns + 1) * interval_ns;
+  pthread_mutex_lock(&lifecycle);
+  pthread_mutex_lock(&lock);
+  if (!engine.cond_initialized) {
+    if (init_cond()) {
+      goto fail;
+    }
+    engine.cond_initialized = 1;
+  }
+  if (engine.sources == NULL) {
+    engine.stop = 0;
+    if ((errno = pthread_create(&engine.thread, NULL, engine_thread, NULL))) {
+      goto fail;
+    }
+  }
+  src->next = engine.sources;
+  engine.sources = src;
+  // the new source may have the earliest deadline
+  pthread_cond_broadcast(&engine.cond);
+  pthread_mutex_unlock(&lock);
+  pthread_mutex_unlock(&lifecycle);
+  return 0;
+
+fail:
+  src->running = 0;
+  pthread_mutex_unlock(&lock);
+  pthread_mutex_unlock(&lifecycle);
+  return -1;
+}
+
+int energymon_poller_stop(energymon_poller_source* src) {
+  energymon_poller_source** pp;
+  int stop_thread;
+  if (src == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (!src->running) {
+    return 0;
+  }
+  if (src->dedicated) {
+    __atomic_store_n(&src->running, 0, __ATOMIC_RELEASE);
+#ifndef __ANDROID__
+    pthread_cancel(src->thread);
+#endif
+    if ((errno = pthread_join(src->thread, NULL))) {
+      return -1;
+    }
+    return 0;
+  }
+
+  pthread_mutex_lock(&lifecycle);
+  pthread_mutex_lock(&lock);
+  for (pp = &engine.sources; *pp != NULL; pp = &(*pp)->next) {
+    if (*pp == src) {
+      *pp = src->next;
+      break;
+    }
+  }
+  while (engine.busy == src) {
+    pthread_cond_wait(&engine.cond, &lock);
+  }
+  src->running = 0;
+  if ((stop_thread = engine.sources == NULL)) {
+    engine.stop = 1;
+    pthread_cond_broadcast(&engine.cond);
+  }
+  pthread_mutex_unlock(&lock);
+  if (stop_thread) {
+    errno = pthread_join(engine.thread, NULL);
+  } else {
+    errno = 0;
+  }
+  pthread_mutex_unlock(&lifecycle);
+  return errno ? -1 : 0;
+}
+
+uint64_t energymon_poller_get_total_uj(const energymon_poller_source* src) {
+  return energymon_integrator_read(&src->integrator);
+}
@@ -0,0 +1,98 @@
+/**
+ * Internal polling engine for implementations that estimate energy by periodically reading power.
+ *
+ * Sources share a single timer thread, which schedules each one on its own interval.
+ * Deadlines are aligned to multiples of each source's interval, so sources whose intervals align (e.g., are equal or
+ * multiples of each other) are read in the same wakeup.
+ * Sources whose reads may block for a long time (e.g., device I/O) can instead be read on a dedicated thread, so they
+ * don't delay other sources.
+ * The engine integrates power with the trapezoidal rule between the times of successive reads, without accumulating
+ * rounding error - see energymon_integrator_update for its error bound.
+ * If the ENERGYMON_ENABLE_ESTIMATES environment variable is set, reads extrapolate the last power reading over the time
+ * since the last read (up to one interval).
+ *
+ * With static libraries, all implementations in a process share the timer thread.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_POLLER_H_
+#define _ENERGYMON_POLLER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include <pthread.h>
+#include "energymon-integrator.h"
+
+#pragma GCC visibility push(hidden)
+
+/**
+ * Read the source's current power.
+ *
+ * @param ctx
+ *  the source's context
+ * @param power_uw
+ *  the power in microwatts
+ * @return 0 on success, -1 on failure (errno should be set), in which case the interval isn't integrated
+ */
+typedef int (*energymon_poller_read_fn)(void* ctx, uint64_t* power_uw);
+
+typedef struct energymon_poller_source {
+  // set by the caller before energymon_poller_start
+  // used in error messages
+  const char* name;
+  energymon_poller_read_fn read;
+  void* ctx;
+  uint64_t interval_us;
+  // read on a dedicated thread, for reads that may block
+  int dedicated;
+
+  // private
+  energymon_integrator integrator;
+  uint64_t next_ns;
+  // deadlines skipped because a read ran a full interval or more late
+  uint64_t missed;
+  int running;
+  pthread_t thread;
+  struct energymon_poller_source* next;
+} energymon_poller_source;
+
+/**
+ * Start polling a source.
+ * The first read is at the source's next aligned deadline, at most one interval from now.
+ *
+ * @param src
+ *  the source, which must remain valid until energymon_poller_stop
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_poller_start(energymon_poller_source* src);
+
+/**
+ * Stop polling a source, waiting for a read in progress to finish.
+ * Does nothing if the source isn't being polled.
+ *
+ * @param src
+ *  the source
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_poller_stop(energymon_poller_source* src);
+
+/**
+ * Get the energy integrated so far, extrapolated to now if estimates are enabled.
+ *
+ * @param src
+ *  the source
+ * @return the energy in microjoules
+ */
+uint64_t energymon_poller_get_total_uj(const energymon_poller_source* src);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
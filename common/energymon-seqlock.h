@@ -0,0 +1,193 @@
+/**
+ * Internal single-writer sequence lock for publishing small snapshots (e.g., energy counters) to lock-free readers.
+ *
+ * The writer brackets updates with energymon_seqlock_write_begin/end.
+ * Readers retry until energymon_seqlock_read_retry returns 0, so they never block the writer.
+ * Data protected by the lock must be accessed with energymon_seqlock_load/store so that concurrent accesses are atomic.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_SEQLOCK_H_
+#define _ENERGYMON_SEQLOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include <sched.h>
+
+#pragma GCC visibility push(hidden)
+
+typedef struct energymon_seqlock {
+  uint32_t seq;
+} energymon_seqlock;
+
+static inline void energymon_seqlock_init(energymon_seqlock* sl) {
+  __atomic_store_n(&sl->seq, 0, __ATOMIC_RELAXED);
+}
+
+static inline void energymon_seqlock_write_begin(energymon_seqlock* sl) {
+  // only one writer, so a relaxed load of our own last store is fine
+  uint32_t seq = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&sl->seq, seq + 1, __ATOMIC_RELAXED);
+  // order the odd sequence before the data stores
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void energymon_seqlock_write_end(energymon_seqlock* sl) {
+  uint32_t seq = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+  // order the data stores before the even sequence
+  __atomic_store_n(&sl->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+// how many times energymon_seqlock_try_read_begin checks for a write to finish before giving up - writers hold the
+// lock for nanoseconds, so this is only reached if the writer was descheduled for a long time or died during a write
+#define ENERGYMON_SEQLOCK_SPIN_MAX (1 << 20)
+
+/**
+ * Pause between checks while spinning, yielding the CPU every so often in case the writer is waiting for it.
+ */
+static inline void energymon_seqlock_relax(uint32_t spins) {
+  if ((spins & 1023) == 1023) {
+    sched_yield();
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * Begin a read, spinning while a write is in progress.
+ *
+ * @return the sequence to pass to energymon_seqlock_read_retry
+ */
+static inline uint32_t energymon_seqlock_read_begin(const energymon_seqlock* sl) {
+  uint32_t seq;
+  while ((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+  return seq;
+}
+
+/**
+ * Begin a read like energymon_seqlock_read_begin, but give up if a write doesn't finish after
+ * ENERGYMON_SEQLOCK_SPIN_MAX checks.
+ * Use when the writer is another process, which may die during a write and leave the lock held forever.
+ *
+ * @param seq
+ *  the sequence to pass to energymon_seqlock_read_retry
+ * @return 0 on success, -1 if a write is still in progress
+ */
+static inline int energymon_seqlock_try_read_begin(const energymon_seqlock* sl, uint32_t* seq) {
+  uint32_t spins;
+  for (spins = 0; (*seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1; spins++) {
+    if (spins == ENERGYMON_SEQLOCK_SPIN_MAX) {
+      return -1;
+    }
+    energymon_seqlock_relax(spins);
+  }
+  return 0;
+}
+
+/**
+ * End a read.
+ *
+ * @return non-zero if a write intervened and the read must be retried
+ */
+static inline int energymon_seqlock_read_retry(const energymon_seqlock* sl, uint32_t seq) {
+  // order the data loads before the sequence re-check
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq;
+}
+
+// 64-bit atomics may not be lock-free on 32-bit platforms, e.g., ARM before ARMv7
+// define ENERGYMON_SEQLOCK_FORCE_SPLIT to use the 32-bit implementation anyway, e.g., to test it on 64-bit platforms
+#if !defined(ENERGYMON_SEQLOCK_FORCE_SPLIT) && defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+#define ENERGYMON_SHARED_U64_LOCK_FREE 1
+#else
+// torn accesses to protected data are caught by the sequence check, so 32-bit halves are enough (and avoid libatomic)
+typedef uint32_t __attribute__((may_alias)) energymon_seqlock_u32;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ENERGYMON_SEQLOCK_LO 1
+#else
+#define ENERGYMON_SEQLOCK_LO 0
+#endif
+#endif
+
+static inline uint64_t energymon_seqlock_load(const uint64_t* p) {
+#ifdef ENERGYMON_SHARED_U64_LOCK_FREE
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+  const energymon_seqlock_u32* h = (const energymon_seqlock_u32*) (const void*) p;
+  return (uint64_t) __atomic_load_n(&h[1 - ENERGYMON_SEQLOCK_LO], __ATOMIC_RELAXED) << 32 |
+         __atomic_load_n(&h[ENERGYMON_SEQLOCK_LO], __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void energymon_seqlock_store(uint64_t* p, uint64_t val) {
+#ifdef ENERGYMON_SHARED_U64_LOCK_FREE
+  __atomic_store_n(p, val, __ATOMIC_RELAXED);
+#else
+  energymon_seqlock_u32* h = (energymon_seqlock_u32*) (void*) p;
+  __atomic_store_n(&h[ENERGYMON_SEQLOCK_LO], (uint32_t) val, __ATOMIC_RELAXED);
+  __atomic_store_n(&h[1 - ENERGYMON_SEQLOCK_LO], (uint32_t) (val >> 32), __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+ * A 64-bit value with a single writer and lock-free readers, e.g., an energy total updated by a polling thread.
+ * Readers never observe a torn value: the value is a 64-bit atomic where those are lock-free, otherwise it's
+ * protected by a seqlock.
+ */
+typedef struct energymon_shared_u64 {
+#ifndef ENERGYMON_SHARED_U64_LOCK_FREE
+  energymon_seqlock lock;
+#endif
+  uint64_t val;
+} energymon_shared_u64;
+
+static inline uint64_t energymon_shared_u64_load(const energymon_shared_u64* s) {
+#ifdef ENERGYMON_SHARED_U64_LOCK_FREE
+  return __atomic_load_n(&s->val, __ATOMIC_RELAXED);
+#else
+  uint32_t seq;
+  uint64_t val;
+  do {
+    seq = energymon_seqlock_read_begin(&s->lock);
+    val = energymon_seqlock_load(&s->val);
+  } while (energymon_seqlock_read_retry(&s->lock, seq));
+  return val;
+#endif
+}
+
+/**
+ * Must only be called by the single writer.
+ */
+static inline void energymon_shared_u64_store(energymon_shared_u64* s, uint64_t val) {
+#ifdef ENERGYMON_SHARED_U64_LOCK_FREE
+  __atomic_store_n(&s->val, val, __ATOMIC_RELAXED);
+#else
+  energymon_seqlock_write_begin(&s->lock);
+  energymon_seqlock_store(&s->val, val);
+  energymon_seqlock_write_end(&s->lock);
+#endif
+}
+
+/**
+ * Must only be called by the single writer.
+ */
+static inline void energymon_shared_u64_add(energymon_shared_u64* s, uint64_t val) {
+  energymon_shared_u64_store(s, energymon_shared_u64_load(s) + val);
+}
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
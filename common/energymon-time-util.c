@@ -23,3 +23,15 @@ uint64_t energymon_gettime_elapsed_us(uint64_t* since_us) {
 int energymon_sleep_us(uint64_t us, volatile const int* ignore_interrupt) {
   return ptime_sleep_us_no_interrupt(us, ignore_interrupt);
 }
+
+int energymon_sleep_until_ns(uint64_t deadline_ns, volatile const int* ignore_interrupt) {
+  return ptime_sleep_until_ns(PTIME_MONOTONIC, deadline_ns, ignore_interrupt);
+}
+
+int energymon_timer_init(energymon_timer* timer, uint64_t period_us) {
+  return ptime_timer_init(timer, PTIME_MONOTONIC, period_us * 1000);
+}
+
+int energymon_timer_wait(energymon_timer* timer, volatile const int* ignore_interrupt) {
+  return ptime_timer_wait(timer, ignore_interrupt);
+}
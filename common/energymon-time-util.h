@@ -9,6 +9,7 @@ extern "C" {
 #endif
 
 #include <inttypes.h>
+#include "ptime/ptime.h"
 
 #pragma GCC visibility push(hidden)
 
@@ -46,6 +47,43 @@ uint64_t energymon_gettime_elapsed_us(uint64_t* since_us);
  */
 int energymon_sleep_us(uint64_t us, volatile const int* ignore_interrupt);
 
+/**
+ * Sleep until the specified monotonic time (as from energymon_gettime_ns).
+ *
+ * @param deadline_ns
+ *  the absolute time in nanoseconds
+ * @param ignore_interrupt
+ *  whether to ignore interrupts (true if not specified)
+ * @return 0 on success, error code on failure
+ */
+int energymon_sleep_until_ns(uint64_t deadline_ns, volatile const int* ignore_interrupt);
+
+/* A periodic timer on the monotonic clock, for polling loops that must not drift - see ptime_timer */
+typedef ptime_timer energymon_timer;
+
+/**
+ * Initialize a periodic timer, with the first deadline one period from now.
+ *
+ * @param timer
+ *  the timer
+ * @param period_us
+ *  the period in microseconds, must be > 0
+ * @return 0 on success, -1 on failure
+ */
+int energymon_timer_init(energymon_timer* timer, uint64_t period_us);
+
+/**
+ * Sleep until the timer's next deadline.
+ * Deadlines are skipped if the caller is a full period or more late, and counted in timer->missed.
+ *
+ * @param timer
+ *  the timer
+ * @param ignore_interrupt
+ *  whether to ignore interrupts (true if not specified)
+ * @return 0 on success, -1 on failure or interrupt
+ */
+int energymon_timer_wait(energymon_timer* timer, volatile const int* ignore_interrupt);
+
 #pragma GCC visibility pop
 
 #ifdef __cplusplus
@@ -0,0 +1,290 @@
+/**
+ * Internal utility functions for discovering CPU topology from sysfs.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "energymon-topology.h"
+#include "energymon-topology-util.h"
+#include "energymon-util.h"
+
+#define CPU_DIR "/devices/system/cpu"
+#define NODE_DIR "/devices/system/node"
+#define NODE_PREFIX "node"
+
+/**
+ * Read a small file into buf.
+ * Returns the number of bytes read, or -1 on failure (errno is set).
+ */
+static ssize_t read_file(const char* path, char* buf, size_t len) {
+  ssize_t ret;
+  int err_save;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  ret = read(fd, buf, len);
+  err_save = errno;
+  close(fd);
+  errno = err_save;
+  return ret;
+}
+
+static int read_file_int(const char* path, int* val) {
+  char buf[24];
+  uint64_t tmp;
+  ssize_t len = read_file(path, buf, sizeof(buf));
+  if (len < 0) {
+    return -1;
+  }
+  if (!energymon_strntou64(buf, (size_t) len, &tmp)) {
+    return -1;
+  }
+  if (tmp > INT32_MAX) {
+    errno = ERANGE;
+    return -1;
+  }
+  *val = (int) tmp;
+  return 0;
+}
+
+static void mask_set(uint64_t* mask, uint64_t cpu) {
+  mask[cpu / 64] |= (uint64_t) 1 << (cpu % 64);
+}
+
+static int mask_isset(const uint64_t* mask, unsigned int cpu) {
+  return mask != NULL && ((mask[cpu / 64] >> (cpu % 64)) & 1);
+}
+
+static int is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+int energymon_topology_parse_cpulist(const char* buf, size_t len, uint64_t* mask) {
+  uint64_t first;
+  uint64_t last;
+  size_t n;
+  size_t i = 0;
+  int count = 0;
+  memset(mask, 0, ENERGYMON_TOPOLOGY_CPU_WORDS * sizeof(uint64_t));
+  while (len > 0 && is_space(buf[len - 1])) {
+    len--;
+  }
+  while (i < len) {
+    if ((n = energymon_strntou64(buf + i, len - i, &first)) == 0) {
+      return -1;
+    }
+    i += n;
+    last = first;
+    if (i < len && buf[i] == '-') {
+      i++;
+      if ((n = energymon_strntou64(buf + i, len - i, &last)) == 0) {
+        return -1;
+      }
+      i += n;
+    }
+    if (last < first || last >= ENERGYMON_TOPOLOGY_MAX_CPUS) {
+      errno = ERANGE;
+      return -1;
+    }
+    for (; first <= last; first++, count++) {
+      mask_set(mask, first);
+    }
+    if (i < len) {
+      // a trailing comma is malformed too
+      if (buf[i] != ',' || ++i == len) {
+        errno = EINVAL;
+        return -1;
+      }
+    }
+  }
+  return count;
+}
+
+static int read_cpulist(const char* path, uint64_t* mask) {
+  char buf[4096];
+  ssize_t len = read_file(path, buf, sizeof(buf));
+  if (len < 0) {
+    return -1;
+  }
+  return energymon_topology_parse_cpulist(buf, (size_t) len, mask);
+}
+
+int energymon_topology_get_cpu_ids(const char* sysfs_root, unsigned int cpu, int* package_id, int* die_id) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s"CPU_DIR"/cpu%u/topology/physical_package_id", sysfs_root, cpu);
+  if (read_file_int(path, package_id)) {
+    if (errno == ENOENT) {
+      // offline CPUs don't export topology
+      errno = ENODEV;
+    }
+    return -1;
+  }
+  snprintf(path, sizeof(path), "%s"CPU_DIR"/cpu%u/topology/die_id", sysfs_root, cpu);
+  if (read_file_int(path, die_id)) {
+    if (errno != ENOENT) {
+      return -1;
+    }
+    *die_id = 0;
+  }
+  return 0;
+}
+
+/**
+ * Find the single NUMA node containing all CPUs in the topology.
+ * Returns the node ID, or -1 if unknown or if CPUs span multiple nodes (not an error).
+ */
+static int topology_find_numa_node(const char* sysfs_root, const energymon_topology* topo) {
+  char path[256];
+  uint64_t node_mask[ENERGYMON_TOPOLOGY_CPU_WORDS];
+  uint64_t node_id;
+  struct dirent* entry;
+  const char* id;
+  size_t n;
+  unsigned int i;
+  unsigned int n_in_node;
+  int node = -1;
+  DIR* dir;
+  snprintf(path, sizeof(path), "%s"NODE_DIR, sysfs_root);
+  // non-NUMA kernels may not have this directory
+  if ((dir = opendir(path)) == NULL) {
+    return -1;
+  }
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, NODE_PREFIX, sizeof(NODE_PREFIX) - 1)) {
+      continue;
+    }
+    id = entry->d_name + sizeof(NODE_PREFIX) - 1;
+    if ((n = energymon_strntou64(id, strlen(id), &node_id)) == 0 || id[n] != '\0' || node_id > INT32_MAX) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s"NODE_DIR"/"NODE_PREFIX"%"PRIu64"/cpulist", sysfs_root, node_id);
+    if (read_cpulist(path, node_mask) <= 0) {
+      continue;
+    }
+    for (n_in_node = 0, i = 0; i < ENERGYMON_TOPOLOGY_CPU_WORDS; i++) {
+      n_in_node += (unsigned int) __builtin_popcountll(node_mask[i] & topo->cpus[i]);
+    }
+    if (n_in_node == topo->cpu_count) {
+      node = (int) node_id;
+      break;
+    }
+    if (n_in_node > 0) {
+      // spans multiple nodes
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+int energymon_topology_get_package(const char* sysfs_root, int package_id, int die_id, energymon_topology* topo) {
+  char path[256];
+  uint64_t online[ENERGYMON_TOPOLOGY_CPU_WORDS];
+  unsigned int cpu;
+  int pkg;
+  int die;
+  memset(topo, 0, sizeof(*topo));
+  snprintf(path, sizeof(path), "%s"CPU_DIR"/online", sysfs_root);
+  if (read_cpulist(path, online) < 0) {
+    return -1;
+  }
+  for (cpu = 0; cpu < ENERGYMON_TOPOLOGY_MAX_CPUS; cpu++) {
+    if (!mask_isset(online, cpu)) {
+      continue;
+    }
+    if (energymon_topology_get_cpu_ids(sysfs_root, cpu, &pkg, &die)) {
+      if (errno == ENODEV) {
+        // went offline
+        continue;
+      }
+      return -1;
+    }
+    if ((package_id < 0 || pkg == package_id) && (die_id < 0 || die == die_id)) {
+      mask_set(topo->cpus, cpu);
+      topo->cpu_count++;
+    }
+  }
+  if (topo->cpu_count == 0) {
+    errno = ENODEV;
+    return -1;
+  }
+  topo->package_id = package_id < 0 ? -1 : package_id;
+  topo->die_id = package_id < 0 ? -1 : die_id;
+  topo->numa_node = topology_find_numa_node(sysfs_root, topo);
+  return 0;
+}
+
+int energymon_topology_get_cpu(const char* sysfs_root, unsigned int cpu, energymon_topology* topo) {
+  int package_id;
+  int die_id;
+  if (energymon_topology_get_cpu_ids(sysfs_root, cpu, &package_id, &die_id)) {
+    return -1;
+  }
+  return energymon_topology_get_package(sysfs_root, package_id, die_id, topo);
+}
+
+typedef struct package_cpu {
+  int package_id;
+  int die_id;
+  unsigned int cpu;
+} package_cpu;
+
+int energymon_topology_get_package_cpus(const char* sysfs_root, const uint64_t* avoid, unsigned int* cpus, size_t n) {
+  char path[256];
+  uint64_t online[ENERGYMON_TOPOLOGY_CPU_WORDS];
+  package_cpu* pkgs;
+  unsigned int n_pkgs = 0;
+  unsigned int cpu;
+  unsigned int i;
+  int pkg;
+  int die;
+  snprintf(path, sizeof(path), "%s"CPU_DIR"/online", sysfs_root);
+  if (read_cpulist(path, online) < 0) {
+    return -1;
+  }
+  if ((pkgs = malloc(ENERGYMON_TOPOLOGY_MAX_CPUS * sizeof(package_cpu))) == NULL) {
+    return -1;
+  }
+  for (cpu = 0; cpu < ENERGYMON_TOPOLOGY_MAX_CPUS; cpu++) {
+    if (!mask_isset(online, cpu)) {
+      continue;
+    }
+    if (energymon_topology_get_cpu_ids(sysfs_root, cpu, &pkg, &die)) {
+      if (errno == ENODEV) {
+        // went offline
+        continue;
+      }
+      free(pkgs);
+      return -1;
+    }
+    for (i = 0; i < n_pkgs && (pkgs[i].package_id != pkg || pkgs[i].die_id != die); i++);
+    if (i == n_pkgs) {
+      pkgs[n_pkgs].package_id = pkg;
+      pkgs[n_pkgs].die_id = die;
+      pkgs[n_pkgs].cpu = cpu;
+      n_pkgs++;
+    } else if (mask_isset(avoid, pkgs[i].cpu) && !mask_isset(avoid, cpu)) {
+      pkgs[i].cpu = cpu;
+    }
+  }
+  for (i = 0; i < n_pkgs && i < n; i++) {
+    cpus[i] = pkgs[i].cpu;
+  }
+  free(pkgs);
+  if (n_pkgs == 0) {
+    errno = ENODEV;
+    return -1;
+  }
+  return (int) n_pkgs;
+}
@@ -0,0 +1,102 @@
+/**
+ * Internal utility functions for discovering CPU topology from sysfs.
+ * The sysfs root is a parameter so that fixture directories can be used for testing.
+ */
+#ifndef _ENERGYMON_TOPOLOGY_UTIL_H_
+#define _ENERGYMON_TOPOLOGY_UTIL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "energymon-topology.h"
+
+#pragma GCC visibility push(hidden)
+
+#define ENERGYMON_TOPOLOGY_SYSFS_ROOT "/sys"
+
+/**
+ * Parse a CPU list, e.g., "0-3,8,10-11", as found in sysfs "cpulist", "online", and "cpumask" files.
+ * Trailing whitespace is permitted.
+ *
+ * @param buf
+ *  the source buffer, need not be null-terminated
+ * @param len
+ *  the maximum number of chars to examine
+ * @param mask
+ *  the destination bitmask, which is cleared first (ENERGYMON_TOPOLOGY_CPU_WORDS in length)
+ * @return the number of CPUs in the list, or -1 on failure (errno is set)
+ */
+int energymon_topology_parse_cpulist(const char* buf, size_t len, uint64_t* mask);
+
+/**
+ * Read a CPU's package and die IDs.
+ * Kernels that predate die support don't provide a die ID, in which case it's reported as 0.
+ *
+ * @param sysfs_root
+ *  the sysfs root, e.g., ENERGYMON_TOPOLOGY_SYSFS_ROOT
+ * @param cpu
+ *  the CPU ID
+ * @param package_id
+ *  not NULL
+ * @param die_id
+ *  not NULL
+ * @return 0 on success, -1 on failure (errno is set, ENODEV if the CPU is offline or doesn't exist)
+ */
+int energymon_topology_get_cpu_ids(const char* sysfs_root, unsigned int cpu, int* package_id, int* die_id);
+
+/**
+ * Get the topology of all online CPUs in a package and die.
+ *
+ * @param sysfs_root
+ *  the sysfs root, e.g., ENERGYMON_TOPOLOGY_SYSFS_ROOT
+ * @param package_id
+ *  the package ID, or -1 to match all packages
+ * @param die_id
+ *  the die ID, or -1 to match all dies
+ * @param topo
+ *  not NULL
+ * @return 0 on success, -1 on failure (errno is set, ENODEV if no CPUs match)
+ */
+int energymon_topology_get_package(const char* sysfs_root, int package_id, int die_id, energymon_topology* topo);
+
+/**
+ * Get the topology of the package and die that a CPU belongs to.
+ *
+ * @param sysfs_root
+ *  the sysfs root, e.g., ENERGYMON_TOPOLOGY_SYSFS_ROOT
+ * @param cpu
+ *  the CPU ID
+ * @param topo
+ *  not NULL
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_topology_get_cpu(const char* sysfs_root, unsigned int cpu, energymon_topology* topo);
+
+/**
+ * Select one online CPU for each (package, die) pair, e.g., to read package-scoped MSRs.
+ * CPUs are ordered by the lowest CPU ID in each (package, die).
+ * By default, the lowest CPU ID in each (package, die) is selected, but CPUs in the avoid mask are only selected if
+ * there are no other online CPUs in the (package, die).
+ *
+ * @param sysfs_root
+ *  the sysfs root, e.g., ENERGYMON_TOPOLOGY_SYSFS_ROOT
+ * @param avoid
+ *  bitmask of CPUs to avoid (ENERGYMON_TOPOLOGY_CPU_WORDS in length), or NULL
+ * @param cpus
+ *  the selected CPUs, may be NULL if n is 0
+ * @param n
+ *  the length of cpus - at most n CPUs are written
+ * @return the number of (package, die) pairs, which may exceed n, or -1 on failure (errno is set)
+ */
+int energymon_topology_get_package_cpus(const char* sysfs_root, const uint64_t* avoid, unsigned int* cpus, size_t n);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
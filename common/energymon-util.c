@@ -6,6 +6,7 @@
  */
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include "energymon-util.h"
 
@@ -27,3 +28,126 @@ char* energymon_strencpy(char* dest, const char* src, size_t n) {
   }
   return dest;
 }
+
+static inline int is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static inline int is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Returns 0 on success, -1 on overflow
+static inline int accumulate_digit(uint64_t* val, char c) {
+  uint64_t d = (uint64_t) (c - '0');
+  if (*val > (UINT64_MAX - d) / 10) {
+    return -1;
+  }
+  *val = *val * 10 + d;
+  return 0;
+}
+
+// Skip leading whitespace and an optional '+'; returns the index of the first char after that prefix
+static inline size_t skip_prefix(const char* buf, size_t len) {
+  size_t i = 0;
+  while (i < len && is_space(buf[i])) {
+    i++;
+  }
+  if (i < len && buf[i] == '+') {
+    i++;
+  }
+  return i;
+}
+
+size_t energymon_strntou64(const char* buf, size_t len, uint64_t* val) {
+  if (buf == NULL || val == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  uint64_t v = 0;
+  size_t start = skip_prefix(buf, len);
+  size_t i;
+  for (i = start; i < len && is_digit(buf[i]); i++) {
+    if (accumulate_digit(&v, buf[i])) {
+      errno = ERANGE;
+      return 0;
+    }
+  }
+  if (i == start) {
+    errno = EINVAL;
+    return 0;
+  }
+  *val = v;
+  return i;
+}
+
+size_t energymon_strntou64_fixed(const char* buf, size_t len, unsigned int frac_digits, uint64_t* val) {
+  if (buf == NULL || val == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  uint64_t v = 0;
+  size_t start = skip_prefix(buf, len);
+  size_t n_digits = 0;
+  size_t i;
+  unsigned int f = 0;
+  for (i = start; i < len && is_digit(buf[i]); i++, n_digits++) {
+    if (accumulate_digit(&v, buf[i])) {
+      errno = ERANGE;
+      return 0;
+    }
+  }
+  if (i < len && buf[i] == '.') {
+    for (i++; i < len && is_digit(buf[i]); i++, n_digits++) {
+      if (f < frac_digits) {
+        if (accumulate_digit(&v, buf[i])) {
+          errno = ERANGE;
+          return 0;
+        }
+        f++;
+      }
+    }
+  }
+  if (n_digits == 0) {
+    errno = EINVAL;
+    return 0;
+  }
+  // pad any missing fractional digits
+  for (; f < frac_digits; f++) {
+    if (accumulate_digit(&v, '0')) {
+      errno = ERANGE;
+      return 0;
+    }
+  }
+  *val = v;
+  return i;
+}
+
+uint64_t energymon_accumulate_u32(uint64_t* total, uint32_t* last, uint32_t raw) {
+  // unsigned subtraction handles a single wrap
+  *total += (uint32_t) (raw - *last);
+  *last = raw;
+  return *total;
+}
+
+int energymon_fixed_mul_init(energymon_fixed_mul* fm, double ratio) {
+  if (fm == NULL || !(ratio >= 0) || ratio >= 4294967296.0) {
+    errno = EINVAL;
+    return -1;
+  }
+  // use the most precision that keeps mul < 2^32, so the fractional part of the product can't overflow
+  fm->shift = 32;
+  while (fm->shift > 0 && ratio * (double) ((uint64_t) 1 << fm->shift) >= 4294967296.0) {
+    fm->shift--;
+  }
+  fm->mul = (uint64_t) (ratio * (double) ((uint64_t) 1 << fm->shift) + 0.5);
+  if (fm->mul > UINT32_MAX) {
+    fm->mul = UINT32_MAX;
+  }
+  return 0;
+}
+
+uint64_t energymon_fixed_mul_apply(uint64_t value, const energymon_fixed_mul* fm) {
+  const uint64_t lo_mask = ((uint64_t) 1 << fm->shift) - 1;
+  return (value >> fm->shift) * fm->mul + (((value & lo_mask) * fm->mul) >> fm->shift);
+}
@@ -8,6 +8,7 @@
 extern "C" {
 #endif
 
+#include <inttypes.h>
 #include <stddef.h>
 
 #pragma GCC visibility push(hidden)
@@ -26,6 +27,85 @@ extern "C" {
  */
 char* energymon_strencpy(char* dest, const char* src, size_t n);
 
+/**
+ * Parse an unsigned decimal integer from a buffer that need not be null-terminated, e.g., data read from a sysfs file.
+ * Leading whitespace and an optional '+' sign are skipped, then digits are consumed until the first non-digit or until
+ * len chars have been examined.
+ * Unlike strtoull, there are no locale lookups or base prefixes, and negative values are rejected.
+ *
+ * @param buf
+ *  the source buffer
+ * @param len
+ *  the maximum number of chars to examine, e.g., the return value of read/pread
+ * @param val
+ *  the parsed value, not modified on failure
+ * @return the number of chars consumed, or 0 on failure (errno is EINVAL if there are no digits, ERANGE on overflow)
+ */
+size_t energymon_strntou64(const char* buf, size_t len, uint64_t* val);
+
+/**
+ * Like energymon_strntou64, but also parse a fractional part and scale the result by 10^frac_digits.
+ * E.g., "1.25" with frac_digits=6 parses as 1250000.
+ * Fractional digits beyond frac_digits are consumed but truncated.
+ *
+ * @param buf
+ *  the source buffer
+ * @param len
+ *  the maximum number of chars to examine
+ * @param frac_digits
+ *  the number of fractional decimal digits to keep
+ * @param val
+ *  the parsed value, not modified on failure
+ * @return the number of chars consumed, or 0 on failure (errno is EINVAL if there are no digits, ERANGE on overflow)
+ */
+size_t energymon_strntou64_fixed(const char* buf, size_t len, unsigned int frac_digits, uint64_t* val);
+
+/**
+ * Accumulate a wrapping 32-bit hardware counter (e.g., a RAPL energy status MSR) into an exact 64-bit raw total.
+ * The counter must not advance by 2^32 or more between calls.
+ *
+ * @param total
+ *  the running total of raw counts, initially 0
+ * @param last
+ *  the last raw counter value, initially 0
+ * @param raw
+ *  the new raw counter value
+ * @return the updated total
+ */
+uint64_t energymon_accumulate_u32(uint64_t* total, uint32_t* last, uint32_t raw);
+
+/**
+ * A fixed-point multiplier: value * ratio ~= (value * mul) >> shift, with mul < 2^32.
+ * Ratios that are powers of 2 times an integer < 2^32 (e.g., RAPL units in uJ = 10^6 / 2^ESU) are exact.
+ */
+typedef struct energymon_fixed_mul {
+  uint64_t mul;
+  unsigned int shift;
+} energymon_fixed_mul;
+
+/**
+ * Precompute a fixed-point multiplier for a ratio, so that conversions avoid floating point.
+ *
+ * @param fm
+ *  the multiplier to initialize
+ * @param ratio
+ *  the conversion ratio, must be >= 0 and < 2^32
+ * @return 0 on success, -1 on failure (errno is EINVAL)
+ */
+int energymon_fixed_mul_init(energymon_fixed_mul* fm, double ratio);
+
+/**
+ * Multiply a value by a fixed-point ratio, rounding down.
+ * Intermediate results don't overflow as long as the result fits in 64 bits.
+ *
+ * @param value
+ *  the value to scale
+ * @param fm
+ *  the multiplier
+ * @return value * ratio
+ */
+uint64_t energymon_fixed_mul_apply(uint64_t value, const energymon_fixed_mul* fm);
+
 #pragma GCC visibility pop
 
 #ifdef __cplusplus
@@ -298,3 +298,78 @@ int ptime_sleep_us_no_interrupt(uint64_t us, volatile const int* ignore_interrup
 #endif
   return ret ? -1 : 0;
 }
+
+int ptime_sleep_until_ns(ptime_clock_id clk_id, uint64_t deadline_ns, volatile const int* ignore_interrupt) {
+  int ret;
+#if defined(__MACH__) || defined(_WIN32)
+  // no absolute sleep, so sleep relative to the current time
+  uint64_t now_ns;
+  do {
+    if (!(now_ns = ptime_gettime_ns(clk_id))) {
+      return -1;
+    }
+    if (now_ns >= deadline_ns) {
+      return 0;
+    }
+    errno = 0;
+    ret = ptime_sleep_ns(deadline_ns - now_ns) ? -1 : 0;
+  } while (ret != 0 && errno == EINTR && (ignore_interrupt == NULL ? 1 : *ignore_interrupt));
+#else
+  struct timespec ts;
+  clockid_t clockid;
+  switch (clk_id) {
+    case PTIME_REALTIME:
+      clockid = CLOCK_REALTIME;
+      break;
+    case PTIME_MONOTONIC:
+      clockid = PTIME_CLOCKID_T_MONOTONIC;
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  ptime_ns_to_timespec(deadline_ns, &ts);
+  do {
+    ret = clock_nanosleep(clockid, TIMER_ABSTIME, &ts, NULL);
+  } while (ret == EINTR && (ignore_interrupt == NULL ? 1 : *ignore_interrupt));
+  if (ret) {
+    errno = ret;
+  }
+#endif
+  return ret ? -1 : 0;
+}
+
+int ptime_timer_init(ptime_timer* timer, ptime_clock_id clk_id, uint64_t period_ns) {
+  uint64_t now_ns;
+  if (timer == NULL || period_ns == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (!(now_ns = ptime_gettime_ns(clk_id))) {
+    return -1;
+  }
+  timer->clk_id = clk_id;
+  timer->period_ns = period_ns;
+  timer->deadline_ns = now_ns + period_ns;
+  timer->missed = 0;
+  return 0;
+}
+
+int ptime_timer_wait(ptime_timer* timer, volatile const int* ignore_interrupt) {
+  uint64_t now_ns;
+  uint64_t skip;
+  if (!(now_ns = ptime_gettime_ns(timer->clk_id))) {
+    return -1;
+  }
+  // less than a period late just runs late, otherwise skip to the most recent deadline
+  if (now_ns >= timer->deadline_ns + timer->period_ns) {
+    skip = (now_ns - timer->deadline_ns) / timer->period_ns;
+    timer->missed += skip;
+    timer->deadline_ns += skip * timer->period_ns;
+  }
+  if (ptime_sleep_until_ns(timer->clk_id, timer->deadline_ns, ignore_interrupt)) {
+    return -1;
+  }
+  timer->deadline_ns += timer->period_ns;
+  return 0;
+}
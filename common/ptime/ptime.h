@@ -98,6 +98,61 @@ uint64_t ptime_sleep_us(uint64_t us);
  */
 int ptime_sleep_us_no_interrupt(uint64_t us, volatile const int* ignore_interrupt);
 
+/**
+ * Sleep until the given absolute time on the given clock.
+ * If the sleep is interrupted with EINTR, goes back to sleep if ignore_interrupt is NULL or evaluates to true.
+ * Returns immediately if the time has already passed.
+ *
+ * @param clk_id
+ * @param deadline_ns
+ * @param ignore_interrupt may be NULL
+ *
+ * @return 0 on success, -1 otherwise
+ */
+int ptime_sleep_until_ns(ptime_clock_id clk_id, uint64_t deadline_ns, volatile const int* ignore_interrupt);
+
+/*
+ * Periodic timers
+ */
+
+/**
+ * A periodic timer with absolute deadlines, so the period doesn't drift by the time spent between waits.
+ * Deadlines are at start + N * period_ns.
+ */
+typedef struct ptime_timer {
+  ptime_clock_id clk_id;
+  uint64_t period_ns;
+  // the next deadline
+  uint64_t deadline_ns;
+  // the number of deadlines skipped because the caller was a full period or more late
+  uint64_t missed;
+} ptime_timer;
+
+/**
+ * Initialize a periodic timer, with the first deadline one period from now.
+ *
+ * @param timer
+ * @param clk_id
+ * @param period_ns must be > 0
+ *
+ * @return 0 on success, -1 otherwise
+ */
+int ptime_timer_init(ptime_timer* timer, ptime_clock_id clk_id, uint64_t period_ns);
+
+/**
+ * Sleep until the timer's next deadline, then advance it by one period.
+ * If the caller is already late by a full period or more, the passed deadlines are skipped (and counted in "missed")
+ * so that the timer stays on its original schedule.
+ * If the sleep is interrupted with EINTR, goes back to sleep if ignore_interrupt is NULL or evaluates to true,
+ * otherwise returns without advancing the deadline.
+ *
+ * @param timer
+ * @param ignore_interrupt may be NULL
+ *
+ * @return 0 on success, -1 otherwise
+ */
+int ptime_timer_wait(ptime_timer* timer, volatile const int* ignore_interrupt);
+
 #pragma GCC visibility pop
 
 #ifdef __cplusplus
@@ -6,11 +6,27 @@
  */
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "energymon.h"
 #include "energymon-cray-pm-common.h"
+#include "energymon-util.h"
+
+int energymon_cray_pm_common_read_u64(int fd, uint64_t* val) {
+  char buf[32];
+  ssize_t len;
+  if ((len = pread(fd, buf, sizeof(buf), 0)) < 0) {
+    return -1;
+  }
+  if (len == 0) {
+    errno = ENODATA;
+    return -1;
+  }
+  return energymon_strntou64(buf, (size_t) len, val) ? 0 : -1;
+}
 
 int energymon_cray_pm_common_init(energymon* em, const char* file) {
   assert(file != NULL);
@@ -24,7 +40,7 @@ int energymon_cray_pm_common_init(energymon* em, const char* file) {
   }
   char buf[64];
   snprintf(buf, sizeof(buf), CRAY_PM_BASE_DIR"/%s", file);
-  if ((state->f = fopen(buf, "r")) == NULL) {
+  if ((state->fd = open(buf, O_RDONLY)) < 0) {
     perror(buf);
     free(state);
     return -1;
@@ -40,11 +56,10 @@ uint64_t energymon_cray_pm_common_read_total(const energymon* em) {
   }
   const energymon_cray_pm_common* state = (energymon_cray_pm_common*) em->state;
   uint64_t joules = 0;
-  errno = 0;
-  rewind(state->f);
-  if (fscanf(state->f, "%"PRIu64" J", &joules) != 1) {
+  if (energymon_cray_pm_common_read_u64(state->fd, &joules)) {
     return 0;
   }
+  errno = 0;
   return joules * 1000000;
 }
 
@@ -54,8 +69,8 @@ int energymon_cray_pm_common_finish(energymon* em) {
     return -1;
   }
   const energymon_cray_pm_common* state = (energymon_cray_pm_common*) em->state;
-  if (state->f != NULL) {
-    fclose(state->f);
+  if (state->fd >= 0) {
+    close(state->fd);
   }
   free(em->state);
   em->state = NULL;
@@ -71,15 +86,15 @@ uint64_t energymon_cray_pm_common_get_interval(const energymon* em) {
   // default is 10 Hz
   uint64_t us = 100000;
   uint64_t hz = 0;
-  FILE* f = fopen(CRAY_PM_BASE_DIR"/raw_scan_hz", "r");
-  if (f == NULL) {
+  int fd = open(CRAY_PM_BASE_DIR"/raw_scan_hz", O_RDONLY);
+  if (fd < 0) {
     perror(CRAY_PM_BASE_DIR"/raw_scan_hz");
   } else {
-    if (fscanf(f, "%"PRIu64, &hz) == 1 && hz > 0) {
+    if (!energymon_cray_pm_common_read_u64(fd, &hz) && hz > 0) {
       // TODO: What if hz doesn't divide evenly?
       us = 1000000 / hz;
     }
-    fclose(f);
+    close(fd);
   }
   return us;
 }
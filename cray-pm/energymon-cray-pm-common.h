@@ -13,7 +13,6 @@ extern "C" {
 
 #include <inttypes.h>
 #include <stddef.h>
-#include <stdio.h>
 #include "energymon.h"
 
 #pragma GCC visibility push(hidden)
@@ -21,9 +20,20 @@ extern "C" {
 #define CRAY_PM_BASE_DIR "/sys/cray/pm_counters"
 
 typedef struct energymon_cray_pm_common {
-  FILE* f;
+  int fd;
 } energymon_cray_pm_common;
 
+/**
+ * Read a counter value from the beginning of an open Cray PM file, e.g., "123456 J".
+ *
+ * @param fd
+ *  the open file descriptor
+ * @param val
+ *  the parsed value
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_cray_pm_common_read_u64(int fd, uint64_t* val);
+
 int energymon_cray_pm_common_init(energymon* em, const char* file);
 
 uint64_t energymon_cray_pm_common_read_total(const energymon* em);
@@ -5,10 +5,12 @@
  * @date 2017-06-28
  */
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "energymon.h"
 #include "energymon-cray-pm.h"
 #include "energymon-cray-pm-common.h"
@@ -36,7 +38,7 @@ typedef enum energymon_cray_pm_file {
 typedef struct energymon_cray_pm {
   energymon file[FILE_COUNT];
   int has_file[FILE_COUNT];
-  FILE* f_freshness;
+  int fd_freshness;
 } energymon_cray_pm;
 
 static int cray_pm_open_files(energymon_cray_pm* state) {
@@ -121,7 +123,7 @@ int energymon_init_cray_pm(energymon* em) {
   if (state == NULL) {
     return -1;
   }
-  if ((state->f_freshness = fopen(CRAY_PM_BASE_DIR"/freshness", "r")) == NULL) {
+  if ((state->fd_freshness = open(CRAY_PM_BASE_DIR"/freshness", O_RDONLY)) < 0) {
     perror(CRAY_PM_BASE_DIR"/freshness");
     free(state);
     return -1;
@@ -147,7 +149,7 @@ uint64_t energymon_read_total_cray_pm(const energymon* em) {
   uint64_t fresh_start = 1;
   uint64_t fresh_end = 0;
   const energymon_cray_pm* state = (energymon_cray_pm*) em->state;
-  if (state->f_freshness == NULL) {
+  if (state->fd_freshness < 0) {
     errno = EINVAL;
     return 0;
   }
@@ -155,8 +157,7 @@ uint64_t energymon_read_total_cray_pm(const energymon* em) {
   while (fresh_start != fresh_end) {
     errno = 0;
     joules = 0;
-    rewind(state->f_freshness);
-    if (fscanf(state->f_freshness, "%"PRIu64, &fresh_start) != 1) {
+    if (energymon_cray_pm_common_read_u64(state->fd_freshness, &fresh_start)) {
       return 0;
     }
     for (i = 0; i < FILE_COUNT; i++) {
@@ -169,8 +170,7 @@ uint64_t energymon_read_total_cray_pm(const energymon* em) {
         joules += tmp;
       }
     }
-    rewind(state->f_freshness);
-    if (fscanf(state->f_freshness, "%"PRIu64, &fresh_end) != 1) {
+    if (energymon_cray_pm_common_read_u64(state->fd_freshness, &fresh_end)) {
       return 0;
     }
   }
@@ -192,8 +192,8 @@ int energymon_finish_cray_pm(energymon* em) {
       }
     }
   }
-  if (state->f_freshness != NULL) {
-    if (fclose(state->f_freshness) && !err_save) {
+  if (state->fd_freshness >= 0) {
+    if (close(state->fd_freshness) && !err_save) {
       err_save = errno;
     }
   }
@@ -18,9 +18,8 @@
 #include <error.h>
 #include "energymon.h"
 #ifdef ENERGYMON_IBMPOWERNV_USE_POWER
-#include <pthread.h>
 #include "energymon-ibmpowernv-power.h"
-#include "energymon-time-util.h"
+#include "energymon-poller.h"
 #else
 #include "energymon-ibmpowernv.h"
 #endif
@@ -68,44 +67,26 @@ typedef struct energymon_ibmpowernv {
   const sensors_chip_name* cn;
   int subfeat_nr;
 #ifdef ENERGYMON_IBMPOWERNV_USE_POWER
-  // thread variables
-  pthread_t thread;
-  int poll_sensors;
-  // total energy estimate
-  uint64_t total_uj;
+  // polls the sensor and integrates the total energy estimate
+  energymon_poller_source poller;
 #endif
 } energymon_ibmpowernv;
 
 #ifdef ENERGYMON_IBMPOWERNV_USE_POWER
 /**
- * pthread function to poll the sensors at regular intervals.
+ * Read the sensor, called at regular intervals by the poller.
  */
-static void* ibmpowernv_poll_sensor(void* args) {
-  energymon_ibmpowernv* state = (energymon_ibmpowernv*) args;
+static int ibmpowernv_read_power(void* ctx, uint64_t* power_uw) {
+  const energymon_ibmpowernv* state = (const energymon_ibmpowernv*) ctx;
   double w;
-  uint64_t exec_us;
-  uint64_t last_us;
   int rc;
-  if (!(last_us = energymon_gettime_us())) {
-    // must be that CLOCK_MONOTONIC is not supported
-    perror("ibmpowernv_poll_sensor: energymon_gettime_us");
-    return (void*) NULL;
-  }
-  energymon_sleep_us(ENERGYMON_IBMPOWERNV_UPDATE_INTERVAL_US, &state->poll_sensors);
-  while (state->poll_sensors) {
-    if ((rc = sensors_get_value(state->cn, state->subfeat_nr, &w))) {
-      fprintf(stderr, "ibmpowernv_poll_sensor: sensors_get_value: %s\n", sensors_strerror(rc));
-    }
-    exec_us = energymon_gettime_elapsed_us(&last_us);
-    if (!rc) {
-      state->total_uj += (uint64_t) (w * (double) exec_us);
-    }
-    // sleep for the update interval of the sensors
-    if (state->poll_sensors) {
-      energymon_sleep_us(ENERGYMON_IBMPOWERNV_UPDATE_INTERVAL_US, &state->poll_sensors);
-    }
+  if ((rc = sensors_get_value(state->cn, state->subfeat_nr, &w))) {
+    fprintf(stderr, "ibmpowernv_read_power: sensors_get_value: %s\n", sensors_strerror(rc));
+    errno = EIO;
+    return -1;
   }
-  return (void*) NULL;
+  *power_uw = (uint64_t) (w * 1000000);
+  return 0;
 }
 #endif
 
@@ -240,10 +221,12 @@ int energymon_init_ibmpowernv(energymon* em) {
 
 #ifdef ENERGYMON_IBMPOWERNV_USE_POWER
   int err_save;
-  // start sensor polling thread
-  state->poll_sensors = 1;
-  errno = pthread_create(&state->thread, NULL, ibmpowernv_poll_sensor, state);
-  if (errno) {
+  // start polling sensor
+  state->poller.name = "energymon-ibmpowernv-power";
+  state->poller.read = ibmpowernv_read_power;
+  state->poller.ctx = state;
+  state->poller.interval_us = ENERGYMON_IBMPOWERNV_UPDATE_INTERVAL_US;
+  if (energymon_poller_start(&state->poller)) {
     err_save = errno;
     close_sensor(state);
     cleanup_libsensors();
@@ -269,7 +252,7 @@ uint64_t energymon_read_total_ibmpowernv(const energymon* em) {
   errno = 0;
   const energymon_ibmpowernv* state = (energymon_ibmpowernv*) em->state;
 #ifdef ENERGYMON_IBMPOWERNV_USE_POWER
-  return state->total_uj;
+  return energymon_poller_get_total_uj(&state->poller);
 #else
   // OCC docs say that samples are collected every 250 us, w/ a 4-byte counter (so 2^32 - 1 max samples).
   // So a sensor rollover/reset could occur roughly: 2^32 samples * (1 s / 4000 samples) / 60 / 60 / 24 ~= 12.4 days?
@@ -306,13 +289,9 @@ int energymon_finish_ibmpowernv(energymon* em) {
   int err_save = 0;
   energymon_ibmpowernv* state = (energymon_ibmpowernv*) em->state;
 #ifdef ENERGYMON_IBMPOWERNV_USE_POWER
-  if (state->poll_sensors) {
-    // stop sensors polling thread and cleanup
-    state->poll_sensors = 0;
-#ifndef __ANDROID__
-    pthread_cancel(state->thread);
-#endif
-    err_save = pthread_join(state->thread, NULL);
+  // stop polling sensor
+  if (energymon_poller_stop(&state->poller)) {
+    err_save = errno;
   }
 #endif
   close_sensor(state);
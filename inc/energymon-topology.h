@@ -0,0 +1,51 @@
+/**
+ * Describe the CPUs covered by an energy channel, so that energy can be correlated with per-socket load.
+ * Implementations that support it provide an energymon_get_channel_topology_* function.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_TOPOLOGY_H_
+#define _ENERGYMON_TOPOLOGY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+
+/* The maximum number of CPUs that can be represented in a topology CPU mask */
+#define ENERGYMON_TOPOLOGY_MAX_CPUS 1024
+#define ENERGYMON_TOPOLOGY_CPU_WORDS (ENERGYMON_TOPOLOGY_MAX_CPUS / 64)
+
+typedef struct energymon_topology {
+  // physical package (socket) ID, or -1 if the channel is not package-scoped (e.g., platform energy)
+  int package_id;
+  // die ID within the package, or -1 if the channel is not die-scoped
+  int die_id;
+  // NUMA node ID, or -1 if unknown or if the CPUs span multiple nodes
+  int numa_node;
+  // number of CPUs set in the cpus mask
+  unsigned int cpu_count;
+  // bitmask of online CPUs covered by the channel, where CPU N is bit (N % 64) of cpus[N / 64]
+  uint64_t cpus[ENERGYMON_TOPOLOGY_CPU_WORDS];
+} energymon_topology;
+
+/**
+ * Check if a CPU is covered by a topology.
+ *
+ * @param topo
+ *  not NULL
+ * @param cpu
+ *  the CPU ID
+ * @return 1 if the CPU is in the mask, 0 otherwise
+ */
+static inline int energymon_topology_has_cpu(const energymon_topology* topo, unsigned int cpu) {
+  return cpu < ENERGYMON_TOPOLOGY_MAX_CPUS && ((topo->cpus[cpu / 64] >> (cpu % 64)) & 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,14 +8,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "energymon.h"
 #include "energymon-jetson.h"
-#include "energymon-time-util.h"
+#include "energymon-poller.h"
 #include "energymon-util.h"
 #include "ina3221.h"
 #include "ina3221x.h"
@@ -46,11 +45,8 @@ int energymon_get_default(energymon* em) {
 typedef struct energymon_jetson {
   // sensor update interval in microseconds
   unsigned long polling_delay_us;
-  // thread variables
-  pthread_t thread;
-  int poll_sensors;
-  // total energy estimate
-  uint64_t total_uj;
+  // polls the sensors and integrates the total energy estimate
+  energymon_poller_source poller;
   // sensor file descriptors
   // INA3221X provides power (mw) files; INA3221 provides voltage (mv) and current (ma) files
   size_t count;
@@ -162,57 +158,39 @@ static int ina3221x_walk_i2c_drivers_dir_for_default(int* fds, size_t* n_fds, un
 }
 
 /**
- * pthread function to poll the sensor(s) at regular intervals.
+ * Read the sensor(s), called at regular intervals by the poller.
  */
-static void* jetson_poll_sensors(void* args) {
-  energymon_jetson* state = (energymon_jetson*) args;
+static int jetson_read_power(void* ctx, uint64_t* power_uw) {
+  const energymon_jetson* state = (const energymon_jetson*) ctx;
   char cdata[8];
   char cdata2[8];
-  unsigned long sum_mw;
-  unsigned long mv;
-  unsigned long ma;
+  ssize_t len;
+  ssize_t len2;
+  uint64_t sum_mw;
+  uint64_t mw;
+  uint64_t mv;
+  uint64_t ma;
   size_t i;
-  uint64_t exec_us;
-  uint64_t last_us;
-  int err_save;
-  if (!(last_us = energymon_gettime_us())) {
-    // must be that CLOCK_MONOTONIC is not supported
-    perror("jetson_poll_sensors");
-    return (void*) NULL;
-  }
-  energymon_sleep_us(state->polling_delay_us, &state->poll_sensors);
-  while (state->poll_sensors) {
-    // read individual sensors
-    for (sum_mw = 0, errno = 0, i = 0; i < state->count && !errno; i++) {
-      if (state->fds_mw[i] > 0) {
-        if (pread(state->fds_mw[i], cdata, sizeof(cdata), 0) > 0) {
-          sum_mw += strtoul(cdata, NULL, 0);
-        }
-      } else {
-        if (pread(state->fds_mv[i], cdata, sizeof(cdata), 0) > 0) {
-          if (pread(state->fds_ma[i], cdata2, sizeof(cdata2), 0) > 0) {
-            mv = strtoul(cdata, NULL, 0);
-            ma = strtoul(cdata2, NULL, 0);
-            sum_mw += mv * ma / 1000;
-          }
-        }
+  for (sum_mw = 0, errno = 0, i = 0; i < state->count && !errno; i++) {
+    if (state->fds_mw[i] > 0) {
+      if ((len = pread(state->fds_mw[i], cdata, sizeof(cdata), 0)) > 0 &&
+          energymon_strntou64(cdata, (size_t) len, &mw)) {
+        sum_mw += mw;
       }
-    }
-    err_save = errno;
-    exec_us = energymon_gettime_elapsed_us(&last_us);
-    if (err_save) {
-      errno = err_save;
-      perror("jetson_poll_sensors: skipping power sensor reading");
     } else {
-      state->total_uj += (uint64_t) (sum_mw * exec_us / 1000);
-    }
-    // sleep for the update interval of the sensors
-    if (state->poll_sensors) {
-      energymon_sleep_us(state->polling_delay_us, &state->poll_sensors);
+      if ((len = pread(state->fds_mv[i], cdata, sizeof(cdata), 0)) > 0 &&
+          (len2 = pread(state->fds_ma[i], cdata2, sizeof(cdata2), 0)) > 0 &&
+          energymon_strntou64(cdata, (size_t) len, &mv) &&
+          energymon_strntou64(cdata2, (size_t) len2, &ma)) {
+        sum_mw += mv * ma / 1000;
+      }
     }
-    errno = 0;
   }
-  return (void*) NULL;
+  if (errno) {
+    return -1;
+  }
+  *power_uw = sum_mw * 1000;
+  return 0;
 }
 
 // Uses strtok_r to parse the input string into an array (str may be free'd afterward)
@@ -394,7 +372,7 @@ static int get_driver(int* is_ina3221, int* is_ina3221x) {
 }
 
 /**
- * Open all sensor files and start the thread to poll the sensors.
+ * Open all sensor files and start polling the sensors.
  */
 int energymon_init_jetson(energymon* em) {
   if (em == NULL || em->state != NULL) {
@@ -456,10 +434,12 @@ int energymon_init_jetson(energymon* em) {
     return -1;
   }
 
-  // start sensors polling thread
-  state->poll_sensors = 1;
-  errno = pthread_create(&state->thread, NULL, jetson_poll_sensors, state);
-  if (errno) {
+  // start polling sensors
+  state->poller.name = "energymon-jetson";
+  state->poller.read = jetson_read_power;
+  state->poller.ctx = state;
+  state->poller.interval_us = state->polling_delay_us;
+  if (energymon_poller_start(&state->poller)) {
     err_save = errno;
     energymon_finish_jetson(em);
     errno = err_save;
@@ -501,13 +481,9 @@ int energymon_finish_jetson(energymon* em) {
   int err_save = 0;
   energymon_jetson* state = (energymon_jetson*) em->state;
 
-  if (state->poll_sensors) {
-    // stop sensors polling thread and cleanup
-    state->poll_sensors = 0;
-#ifndef __ANDROID__
-    pthread_cancel(state->thread);
-#endif
-    err_save = pthread_join(state->thread, NULL);
+  // stop polling sensors
+  if (energymon_poller_stop(&state->poller)) {
+    err_save = errno;
   }
 
   // close individual sensor files
@@ -535,7 +511,7 @@ uint64_t energymon_read_total_jetson(const energymon* em) {
     return 0;
   }
   errno = 0;
-  return ((energymon_jetson*) em->state)->total_uj;
+  return energymon_poller_get_total_uj(&((energymon_jetson*) em->state)->poller);
 }
 
 char* energymon_get_source_jetson(char* buffer, size_t n) {
@@ -1,25 +1,41 @@
 /**
  * Read energy from X86 MSRs (Model-Specific Registers).
  *
- * By default, the MSR on cpu0 is read. To configure other MSRs, set the
- * ENERGYMON_MSRS environment variable with a comma-delimited list of CPU IDs,
- * e.g.:
+ * By default, the MSRs on one CPU per package (and die) are read, as discovered
+ * from sysfs. To configure other MSRs, set the ENERGYMON_MSRS environment
+ * variable with a comma-delimited list of CPU IDs, e.g.:
  *   export ENERGYMON_MSRS=0,4,8,12
  *
+ * By default, only the package domain is read. To configure other domains, set
+ * the ENERGYMON_MSR_DOMAINS environment variable, e.g.:
+ *   export ENERGYMON_MSR_DOMAINS=pkg,dram
+ *
+ * To refresh MSRs from reader threads pinned to each MSR's CPU, set the reader
+ * interval in microseconds, e.g.:
+ *   export ENERGYMON_MSR_READER_INTERVAL_US=1000
+ *
  * @author Connor Imes
  * @author Hank Hoffmann
  */
 
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 #include "energymon.h"
 #include "energymon-msr.h"
+#include "energymon-seqlock.h"
+#include "energymon-time-util.h"
+#include "energymon-topology.h"
+#include "energymon-topology-util.h"
 #include "energymon-util.h"
 
 #ifdef ENERGYMON_DEFAULT
@@ -43,18 +59,188 @@ int energymon_get_default(energymon* em) {
 /* DRAM RAPL Domain */
 #define MSR_DRAM_ENERGY_STATUS		0x619
 
+/* msr-safe batch interface, from msr-safe's msr_batch.h */
+#define MSR_BATCH_DEV "/dev/cpu/msr_batch"
+
+struct msr_batch_op {
+  uint16_t cpu;     // In: CPU to execute {rd/wr}msr instruction
+  uint16_t isrdmsr; // In: 0=wrmsr, non-zero=rdmsr
+  int32_t err;      // Out: set if error occurred with this operation
+  uint32_t msr;     // In: MSR Address to perform operation
+  uint64_t msrdata; // In/Out: Input/Result to/from operation
+  uint64_t wmask;   // Out: Write mask applied to wrmsr
+};
+
+struct msr_batch_array {
+  uint32_t numops;           // In: # of operations in operations array
+  struct msr_batch_op* ops;  // In: Array[numops] of operations
+};
+
+#define X86_IOC_MSR_BATCH _IOWR('c', 0xA2, struct msr_batch_array)
+
+typedef struct msr_domain {
+  const char* name;
+  off_t msr;
+} msr_domain;
+
+static const msr_domain MSR_DOMAINS[] = {
+  { "pkg", MSR_PKG_ENERGY_STATUS },
+  { "pp0", MSR_PP0_ENERGY_STATUS },
+  { "pp1", MSR_PP1_ENERGY_STATUS },
+  { "dram", MSR_DRAM_ENERGY_STATUS },
+};
+#define MSR_DOMAINS_MAX (sizeof(MSR_DOMAINS) / sizeof(MSR_DOMAINS[0]))
+#define MSR_DOMAIN_DEFAULT "pkg"
+#define MSR_DOMAIN_IDX_DRAM 3
+
+// the 32-bit energy counters can wrap in about a minute at high power, and a wrap is only caught if the counter is
+// read at least once in between
+#define MSR_READER_INTERVAL_MAX_US 10000000
+
+// Server parts use fixed DRAM energy units of 15.3 uJ (1/2^16 J) rather than MSR_RAPL_POWER_UNIT.
+// Intel family 6 models, per the Linux intel_rapl driver.
+#define MSR_DRAM_ENERGY_STATUS_UNITS_FIXED 16
+static const unsigned int MSR_DRAM_FIXED_UNITS_MODELS[] = {
+  0x3F, // Haswell-X
+  0x4F, // Broadwell-X
+  0x56, // Broadwell-D
+  0x55, // Skylake-X
+  0x57, // Xeon Phi Knights Landing
+  0x85, // Xeon Phi Knights Mill
+  0x6A, // Ice Lake-X
+  0x6C, // Ice Lake-D
+  0x8F, // Sapphire Rapids-X
+  0xCF, // Emerald Rapids-X
+  0xAD, // Granite Rapids-X
+  0xAE, // Granite Rapids-D
+  0xAF, // Sierra Forest-X
+};
+
+typedef struct msr_channel {
+  // exact running total of raw counts, accumulated from the 32-bit counter
+  uint64_t raw_total;
+  uint32_t raw_last;
+  // converts raw counts to uJ
+  energymon_fixed_mul to_uj;
+  double energy_units;
+} msr_channel;
+
+struct energymon_msr;
+
 typedef struct msr_info {
+  unsigned int cpu;
   int fd;
-  unsigned int n_overflow;
-  uint64_t energy_last;
-  double energy_units;
+  // indexed the same as the state's domains array
+  msr_channel channels[MSR_DOMAINS_MAX];
+  // reader thread mode: the reader publishes energy_uj and err through the seqlock
+  struct energymon_msr* state;
+  pthread_t reader;
+  int has_reader;
+  // initialized before the reader starts, so a failure is reported by energymon_init_msr
+  energymon_timer timer;
+  energymon_seqlock lock;
+  uint64_t err;
+  uint64_t energy_uj[MSR_DOMAINS_MAX];
 } msr_info;
 
 typedef struct energymon_msr {
+  // msr-safe batch device and ops for all channels, or 0/NULL if using per-CPU reads
+  int batch_fd;
+  struct msr_batch_array batch;
+  // reader threads are used if the interval is non-zero
+  uint64_t reader_interval_us;
+  volatile int readers_run;
+  unsigned int n_domains;
+  // indexes into MSR_DOMAINS
+  unsigned int domains[MSR_DOMAINS_MAX];
   unsigned int msr_count;
   msr_info msrs[];
 } energymon_msr;
 
+/**
+ * Check /proc/cpuinfo for a CPU model with fixed DRAM energy units.
+ * Returns 1 if fixed, 0 otherwise (including if cpuinfo can't be read).
+ */
+static int msr_is_dram_units_fixed(void) {
+  char line[256];
+  unsigned int family = 0;
+  unsigned int model = 0;
+  int is_intel = 0;
+  size_t i;
+  FILE* f = fopen("/proc/cpuinfo", "r");
+  if (f == NULL) {
+    return 0;
+  }
+  // only need the first processor's entry
+  while (fgets(line, sizeof(line), f) != NULL && line[0] != '\n') {
+    if (!strncmp(line, "vendor_id", sizeof("vendor_id") - 1)) {
+      is_intel = strstr(line, "GenuineIntel") != NULL;
+    } else {
+      // "model name" also starts with "model", but won't match the format
+      sscanf(line, "cpu family : %u", &family);
+      sscanf(line, "model : %u", &model);
+    }
+  }
+  fclose(f);
+  if (!is_intel || family != 6) {
+    return 0;
+  }
+  for (i = 0; i < sizeof(MSR_DRAM_FIXED_UNITS_MODELS) / sizeof(MSR_DRAM_FIXED_UNITS_MODELS[0]); i++) {
+    if (model == MSR_DRAM_FIXED_UNITS_MODELS[i]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Parse the ENERGYMON_MSR_DOMAINS env var into the state's domains array.
+ * Returns 0 on success, -1 on failure (errno is set).
+ */
+static int msr_domains_init(energymon_msr* state) {
+  char* tmp;
+  char* tok;
+  char* saveptr;
+  unsigned int i;
+  int requested[MSR_DOMAINS_MAX] = { 0 };
+  const char* env_domains = getenv(ENERGYMON_MSR_DOMAINS_ENV_VAR);
+  if (env_domains == NULL) {
+    env_domains = MSR_DOMAIN_DEFAULT;
+  }
+  if ((tmp = strdup(env_domains)) == NULL) {
+    return -1;
+  }
+  for (tok = strtok_r(tmp, ENERGYMON_MSRS_DELIMS, &saveptr); tok;
+       tok = strtok_r(NULL, ENERGYMON_MSRS_DELIMS, &saveptr)) {
+    for (i = 0; i < MSR_DOMAINS_MAX && strcasecmp(tok, MSR_DOMAINS[i].name); i++);
+    if (i == MSR_DOMAINS_MAX) {
+      fprintf(stderr, "energymon_init_msr: Unknown domain: %s\n", tok);
+      free(tmp);
+      errno = EINVAL;
+      return -1;
+    }
+    requested[i] = 1;
+  }
+  free(tmp);
+  // keep a consistent domain order regardless of how they were specified
+  for (state->n_domains = 0, i = 0; i < MSR_DOMAINS_MAX; i++) {
+    if (requested[i]) {
+      state->domains[state->n_domains++] = i;
+    }
+  }
+  if (state->n_domains == 0) {
+    fprintf(stderr, "energymon_init_msr: No domains specified: "ENERGYMON_MSR_DOMAINS_ENV_VAR"=%s\n", env_domains);
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+static const char* get_sysfs_root(void) {
+  const char* sysfs_root = getenv(ENERGYMON_MSR_SYSFS_ROOT_ENV_VAR);
+  return sysfs_root == NULL ? ENERGYMON_TOPOLOGY_SYSFS_ROOT : sysfs_root;
+}
+
 /**
  * env_cores is consumed by strtok_r, so cannot be reused after this function.
  */
@@ -72,22 +258,98 @@ static inline unsigned int count_msrs(char* env_cores) {
  * env_cores is consumed by strtok_r, so cannot be reused after this function.
  * Returns the errno (if any)
  */
-static inline int msr_info_init(msr_info* m, unsigned int n, char* env_cores) {
+static inline int parse_msrs(char* env_cores, unsigned int* cpus, unsigned int n) {
+  unsigned int i;
+  uint64_t cpu;
+  char* saveptr;
+  const char* tok = strtok_r(env_cores, ENERGYMON_MSRS_DELIMS, &saveptr);
+  for (i = 0; tok && i < n; i++) {
+    if (energymon_strntou64(tok, strlen(tok), &cpu) != strlen(tok) || cpu > UINT32_MAX) {
+      fprintf(stderr, "energymon_init_msr: Invalid CPU ID: %s\n", tok);
+      return EINVAL;
+    }
+    cpus[i] = (unsigned int) cpu;
+    tok = strtok_r(NULL, ENERGYMON_MSRS_DELIMS, &saveptr);
+  }
+  return 0;
+}
+
+/**
+ * Get the CPUs to read MSRs from, either from ENERGYMON_MSRS or by choosing one CPU per package (and die).
+ * Returns the number of CPUs (and allocates *cpus), or 0 on failure (errno is set).
+ */
+static unsigned int get_msrs(unsigned int** cpus) {
+  uint64_t avoid[ENERGYMON_TOPOLOGY_CPU_WORDS];
+  const uint64_t* avoid_mask = NULL;
+  unsigned int ncores;
+  char* tmp;
+  int ret;
+  const char* env_cores = getenv(ENERGYMON_MSR_ENV_VAR);
+  const char* env_avoid = getenv(ENERGYMON_MSR_AVOID_CPUS_ENV_VAR);
+  if (env_cores != NULL) {
+    // explicit list overrides discovery
+    if ((tmp = strdup(env_cores)) == NULL) {
+      return 0;
+    }
+    ncores = count_msrs(tmp);
+    free(tmp);
+    if (ncores == 0) {
+      errno = EINVAL;
+      perror("Parsing number of cores from " ENERGYMON_MSR_ENV_VAR " env var");
+      return 0;
+    }
+    if ((*cpus = malloc(ncores * sizeof(unsigned int))) == NULL) {
+      return 0;
+    }
+    if ((tmp = strdup(env_cores)) == NULL) {
+      free(*cpus);
+      return 0;
+    }
+    ret = parse_msrs(tmp, *cpus, ncores);
+    free(tmp);
+    if (ret) {
+      free(*cpus);
+      errno = ret;
+      return 0;
+    }
+    return ncores;
+  }
+
+  if (env_avoid != NULL) {
+    if (energymon_topology_parse_cpulist(env_avoid, strlen(env_avoid), avoid) < 0) {
+      fprintf(stderr, "energymon_init_msr: Failed to parse "ENERGYMON_MSR_AVOID_CPUS_ENV_VAR": %s\n", env_avoid);
+      errno = EINVAL;
+      return 0;
+    }
+    avoid_mask = avoid;
+  }
+  if ((*cpus = malloc(ENERGYMON_TOPOLOGY_MAX_CPUS * sizeof(unsigned int))) == NULL) {
+    return 0;
+  }
+  if ((ret = energymon_topology_get_package_cpus(get_sysfs_root(), avoid_mask, *cpus, ENERGYMON_TOPOLOGY_MAX_CPUS)) < 0) {
+    // topology may not be available, e.g., in some containers - keep the old default
+    fprintf(stderr, "energymon_init_msr: Failed to discover CPU packages, using cpu 0: %s\n", strerror(errno));
+    (*cpus)[0] = 0;
+    ret = 1;
+  }
+  return (unsigned int) ret;
+}
+
+static inline int msr_info_init(energymon_msr* state, const unsigned int* cpus) {
   uint64_t msr_val;
   unsigned int i;
+  unsigned int d;
   unsigned int energy_status_units;
   char filename[32];
-  char* saveptr;
-  const char* tok = env_cores == NULL ? "0" :
-    strtok_r(env_cores, ENERGYMON_MSRS_DELIMS, &saveptr);
-  for (i = 0; tok && i < n; i++) {
-    m[i].n_overflow = 0;
-    m[i].energy_last = 0;
+  msr_info* m = state->msrs;
+  const int dram_units_fixed = msr_is_dram_units_fixed();
+  for (i = 0; i < state->msr_count; i++) {
+    m[i].cpu = cpus[i];
     // first try msr_safe file
-    snprintf(filename, sizeof(filename), "/dev/cpu/%s/msr_safe", tok);
+    snprintf(filename, sizeof(filename), "/dev/cpu/%u/msr_safe", m[i].cpu);
     if ((m[i].fd = open(filename, O_RDONLY)) <= 0) {
       // fall back on regular msr file
-      snprintf(filename, sizeof(filename), "/dev/cpu/%s/msr", tok);
+      snprintf(filename, sizeof(filename), "/dev/cpu/%u/msr", m[i].cpu);
       if ((m[i].fd = open(filename, O_RDONLY)) <= 0) {
         perror(filename);
         return errno;
@@ -101,12 +363,198 @@ static inline int msr_info_init(msr_info* m, unsigned int n, char* env_cores) {
     // Energy related information (in Joules) is based on the multiplier,
     // 1/2^ESU; where ESU is an unsigned integer represented by bits 12:8.
     energy_status_units = ((msr_val >> 8) & 0x1f);
-    // At 5 bits only, 0 <= energy_status_units < 32, so bit shift instead,
-    // no need to use "pow" and require linking to math library
-    // m[i].energy_units = pow(0.5, energy_status_units);
-    m[i].energy_units = 1.0 / (1 << energy_status_units);
-    tok = env_cores == NULL ? NULL :
-      strtok_r(NULL, ENERGYMON_MSRS_DELIMS, &saveptr);
+    for (d = 0; d < state->n_domains; d++) {
+      m[i].channels[d].raw_total = 0;
+      m[i].channels[d].raw_last = 0;
+      // At 5 bits only, 0 <= energy_status_units < 32, so bit shift instead,
+      // no need to use "pow" and require linking to math library
+      // m[i].channels[d].energy_units = pow(0.5, energy_status_units);
+      if (state->domains[d] == MSR_DOMAIN_IDX_DRAM && dram_units_fixed) {
+        m[i].channels[d].energy_units = 1.0 / (1 << MSR_DRAM_ENERGY_STATUS_UNITS_FIXED);
+      } else {
+        m[i].channels[d].energy_units = 1.0 / (1 << energy_status_units);
+      }
+      // 10^6 / 2^ESU is exactly representable, so conversions are exact
+      energymon_fixed_mul_init(&m[i].channels[d].to_uj, m[i].channels[d].energy_units * 1000000.0);
+      // verify that the domain is supported - unsupported MSRs fail to read
+      if (pread(m[i].fd, &msr_val, sizeof(msr_val), MSR_DOMAINS[state->domains[d]].msr) != sizeof(msr_val)) {
+        fprintf(stderr, "energymon_init_msr: Domain not supported on cpu %u: %s\n",
+                m[i].cpu, MSR_DOMAINS[state->domains[d]].name);
+        return ENODEV;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * Update a channel with a new raw MSR value and return its energy in uJ.
+ */
+static inline uint64_t msr_channel_update(msr_channel* c, uint64_t msr_val) {
+  // bits 31:0 hold the energy consumption counter, ignore upper 32 bits
+  return energymon_fixed_mul_apply(energymon_accumulate_u32(&c->raw_total, &c->raw_last, (uint32_t) msr_val),
+                                   &c->to_uj);
+}
+
+/**
+ * Try to use the msr-safe batch device to read all channels with a single ioctl.
+ * Failure isn't an error - per-CPU reads are used instead.
+ */
+static void msr_batch_init(energymon_msr* state) {
+  unsigned int i;
+  unsigned int d;
+  size_t ch;
+  uint32_t n_ops = state->msr_count * state->n_domains;
+  int fd = open(MSR_BATCH_DEV, O_RDWR);
+  if (fd <= 0) {
+    return;
+  }
+  if ((state->batch.ops = calloc(n_ops, sizeof(struct msr_batch_op))) == NULL) {
+    close(fd);
+    return;
+  }
+  state->batch.numops = n_ops;
+  for (ch = 0, i = 0; i < state->msr_count; i++) {
+    for (d = 0; d < state->n_domains; d++, ch++) {
+      state->batch.ops[ch].cpu = (uint16_t) state->msrs[i].cpu;
+      state->batch.ops[ch].isrdmsr = 1;
+      state->batch.ops[ch].msr = (uint32_t) MSR_DOMAINS[state->domains[d]].msr;
+    }
+  }
+  // verify that the batch works, e.g., that the MSRs are in the allowlist
+  if (ioctl(fd, X86_IOC_MSR_BATCH, &state->batch) == 0) {
+    for (ch = 0; ch < n_ops && !state->batch.ops[ch].err; ch++);
+    if (ch == n_ops) {
+      state->batch_fd = fd;
+      return;
+    }
+  }
+  free(state->batch.ops);
+  state->batch.ops = NULL;
+  state->batch.numops = 0;
+  close(fd);
+}
+
+/**
+ * Read all domains for a CPU and publish them to readers.
+ */
+static void msr_reader_refresh(msr_info* m) {
+  uint64_t energy_uj[MSR_DOMAINS_MAX];
+  uint64_t msr_val;
+  unsigned int d;
+  int err = 0;
+  for (d = 0; d < m->state->n_domains; d++) {
+    if (pread(m->fd, &msr_val, sizeof(uint64_t), MSR_DOMAINS[m->state->domains[d]].msr) != sizeof(uint64_t)) {
+      err = errno ? errno : EIO;
+      break;
+    }
+    energy_uj[d] = msr_channel_update(&m->channels[d], msr_val);
+  }
+  energymon_seqlock_write_begin(&m->lock);
+  energymon_seqlock_store(&m->err, (uint64_t) err);
+  if (!err) {
+    for (d = 0; d < m->state->n_domains; d++) {
+      energymon_seqlock_store(&m->energy_uj[d], energy_uj[d]);
+    }
+  }
+  energymon_seqlock_write_end(&m->lock);
+}
+
+/**
+ * pthread function to refresh a CPU's MSRs locally, so reads don't need an IPI.
+ */
+static void* msr_reader(void* arg) {
+  msr_info* m = (msr_info*) arg;
+  while (m->state->readers_run) {
+    energymon_timer_wait(&m->timer, &m->state->readers_run);
+    if (m->state->readers_run) {
+      msr_reader_refresh(m);
+    }
+  }
+  return (void*) NULL;
+}
+
+static int msr_readers_stop(energymon_msr* state) {
+  int err_save = 0;
+  int err;
+  unsigned int i;
+  state->readers_run = 0;
+  for (i = 0; i < state->msr_count; i++) {
+    if (state->msrs[i].has_reader) {
+#ifndef __ANDROID__
+      pthread_cancel(state->msrs[i].reader);
+#endif
+      if ((err = pthread_join(state->msrs[i].reader, NULL)) && !err_save) {
+        err_save = err;
+      }
+      state->msrs[i].has_reader = 0;
+    }
+  }
+  return err_save;
+}
+
+/**
+ * Start one reader thread per MSR CPU, pinned to that CPU.
+ * Returns 0 on success, or the error code.
+ */
+static int msr_readers_start(energymon_msr* state) {
+  pthread_attr_t attr;
+  cpu_set_t cpuset;
+  unsigned int i;
+  int err;
+  state->readers_run = 1;
+  for (i = 0; i < state->msr_count; i++) {
+    state->msrs[i].state = state;
+    energymon_seqlock_init(&state->msrs[i].lock);
+    // publish an initial value so reads never see an empty snapshot
+    msr_reader_refresh(&state->msrs[i]);
+    if ((err = (int) energymon_seqlock_load(&state->msrs[i].err))) {
+      return err;
+    }
+    if (energymon_timer_init(&state->msrs[i].timer, state->reader_interval_us)) {
+      err = errno;
+      perror("energymon_init_msr: energymon_timer_init");
+      return err;
+    }
+    CPU_ZERO(&cpuset);
+    CPU_SET(state->msrs[i].cpu, &cpuset);
+    if ((err = pthread_attr_init(&attr))) {
+      return err;
+    }
+    if (!(err = pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset))) {
+      err = pthread_create(&state->msrs[i].reader, &attr, msr_reader, &state->msrs[i]);
+    }
+    pthread_attr_destroy(&attr);
+    if (err) {
+      fprintf(stderr, "energymon_init_msr: Failed to start reader thread on cpu %u: %s\n",
+              state->msrs[i].cpu, strerror(err));
+      return err;
+    }
+    state->msrs[i].has_reader = 1;
+  }
+  return 0;
+}
+
+/**
+ * Parse the optional reader interval from ENERGYMON_MSR_READER_INTERVAL_US.
+ * Returns 0 on success, -1 on failure (errno is set).
+ */
+static int msr_reader_interval_init(energymon_msr* state) {
+  const char* env_interval = getenv(ENERGYMON_MSR_READER_INTERVAL_US_ENV_VAR);
+  if (env_interval == NULL) {
+    return 0;
+  }
+  if (energymon_strntou64(env_interval, strlen(env_interval), &state->reader_interval_us) != strlen(env_interval) ||
+      state->reader_interval_us == 0) {
+    fprintf(stderr, "energymon_init_msr: Invalid "ENERGYMON_MSR_READER_INTERVAL_US_ENV_VAR": %s\n", env_interval);
+    errno = EINVAL;
+    return -1;
+  }
+  if (state->reader_interval_us > MSR_READER_INTERVAL_MAX_US) {
+    fprintf(stderr, "energymon_init_msr: "ENERGYMON_MSR_READER_INTERVAL_US_ENV_VAR" is too long to catch energy "
+            "counter overflows, must be at most %d: %s\n", MSR_READER_INTERVAL_MAX_US, env_interval);
+    errno = EINVAL;
+    return -1;
   }
   return 0;
 }
@@ -117,72 +565,131 @@ int energymon_init_msr(energymon* em) {
     return -1;
   }
 
-  unsigned int ncores = 1;
-  char* tmp = NULL;
-  // get a delimited list of cores with MSRs to read from
-  const char* env_cores = getenv(ENERGYMON_MSR_ENV_VAR);
-  if (env_cores != NULL) {
-    if ((tmp = strdup(env_cores)) == NULL) {
-      return -1;
-    }
-    ncores = count_msrs(tmp);
-    free(tmp);
-    if (ncores == 0) {
-      errno = EINVAL;
-      perror("Parsing number of cores from " ENERGYMON_MSR_ENV_VAR " env var");
-      return -1;
-    }
-    if ((tmp = strdup(env_cores)) == NULL) {
-      return -1;
-    }
+  unsigned int* cpus = NULL;
+  unsigned int ncores = get_msrs(&cpus);
+  if (ncores == 0) {
+    return -1;
   }
 
   size_t size = sizeof(energymon_msr) + ncores * sizeof(msr_info);
   energymon_msr* state = calloc(1, size);
   if (state == NULL) {
-    free(tmp);
+    free(cpus);
     return -1;
   }
   state->msr_count = ncores;
+  if (msr_domains_init(state) || msr_reader_interval_init(state)) {
+    free(cpus);
+    free(state);
+    return -1;
+  }
 
   // open the MSR files
   em->state = state;
-  int save_err = msr_info_init(state->msrs, ncores, tmp);
-  free(tmp);
+  int save_err = msr_info_init(state, cpus);
+  free(cpus);
   if (save_err) {
     energymon_finish_msr(em);
     errno = save_err;
     return -1;
   }
+  if (state->reader_interval_us > 0) {
+    if ((save_err = msr_readers_start(state))) {
+      energymon_finish_msr(em);
+      errno = save_err;
+      return -1;
+    }
+  } else {
+    msr_batch_init(state);
+  }
 
   return 0;
 }
 
-uint64_t energymon_read_total_msr(const energymon* em) {
-  if (em == NULL || em->state == NULL) {
+/**
+ * Read the latest snapshots published by the reader threads.
+ * Returns 0 on error (check errno), otherwise the total energy.
+ */
+static uint64_t msr_read_readers(const energymon_msr* state, uint64_t* energy_uj, size_t n) {
+  uint64_t snapshot[MSR_DOMAINS_MAX];
+  uint64_t total = 0;
+  uint64_t err;
+  uint32_t seq;
+  unsigned int i;
+  unsigned int d;
+  size_t ch;
+  for (ch = 0, i = 0; i < state->msr_count; i++) {
+    do {
+      seq = energymon_seqlock_read_begin(&state->msrs[i].lock);
+      err = energymon_seqlock_load(&state->msrs[i].err);
+      for (d = 0; d < state->n_domains; d++) {
+        snapshot[d] = energymon_seqlock_load(&state->msrs[i].energy_uj[d]);
+      }
+    } while (energymon_seqlock_read_retry(&state->msrs[i].lock, seq));
+    if (err) {
+      errno = (int) err;
+      return 0;
+    }
+    for (d = 0; d < state->n_domains; d++, ch++) {
+      if (ch < n) {
+        energy_uj[ch] = snapshot[d];
+      }
+      total += snapshot[d];
+    }
+  }
+  errno = 0;
+  return total;
+}
+
+uint64_t energymon_read_channels_msr(const energymon* em, uint64_t* energy_uj, size_t n) {
+  if (em == NULL || em->state == NULL || (energy_uj == NULL && n > 0)) {
     errno = EINVAL;
     return 0;
   }
 
   unsigned int i;
+  unsigned int d;
+  size_t ch;
   uint64_t msr_val;
+  uint64_t uj;
   uint64_t total = 0;
   energymon_msr* state = (energymon_msr*) em->state;
-  for (errno = 0, i = 0; i < state->msr_count && !errno; i++) {
-    if (pread(state->msrs[i].fd, &msr_val, sizeof(uint64_t),
-              MSR_PKG_ENERGY_STATUS) == sizeof(uint64_t)) {
-      // bits 31:0 hold the energy consumption counter, ignore upper 32 bits
-      msr_val &= 0xFFFFFFFF;
-      // overflows at 32 bits
-      if (msr_val < state->msrs[i].energy_last) {
-        state->msrs[i].n_overflow++;
+  if (state->reader_interval_us > 0) {
+    return msr_read_readers(state, energy_uj, n);
+  }
+  errno = 0;
+  if (state->batch_fd > 0 && ioctl(state->batch_fd, X86_IOC_MSR_BATCH, &state->batch) < 0) {
+    return 0;
+  }
+  for (ch = 0, i = 0; i < state->msr_count; i++) {
+    for (d = 0; d < state->n_domains; d++, ch++) {
+      if (state->batch_fd > 0) {
+        // ops are ordered the same as channels
+        if (state->batch.ops[ch].err) {
+          errno = -state->batch.ops[ch].err > 0 ? -state->batch.ops[ch].err : EIO;
+          return 0;
+        }
+        msr_val = state->batch.ops[ch].msrdata;
+      } else if (pread(state->msrs[i].fd, &msr_val, sizeof(uint64_t),
+                       MSR_DOMAINS[state->domains[d]].msr) != sizeof(uint64_t)) {
+        // all domains for a CPU are read from the same fd
+        if (!errno) {
+          errno = EIO;
+        }
+        return 0;
       }
-      state->msrs[i].energy_last = msr_val;
-      total += (uint64_t) ((double) (msr_val + state->msrs[i].n_overflow * (uint64_t) UINT32_MAX)
-                           * state->msrs[i].energy_units * 1000000.0);
+      uj = msr_channel_update(&state->msrs[i].channels[d], msr_val);
+      if (ch < n) {
+        energy_uj[ch] = uj;
+      }
+      total += uj;
     }
   }
-  return errno ? 0 : total;
+  return total;
+}
+
+uint64_t energymon_read_total_msr(const energymon* em) {
+  return energymon_read_channels_msr(em, NULL, 0);
 }
 
 int energymon_finish_msr(energymon* em) {
@@ -191,14 +698,18 @@ int energymon_finish_msr(energymon* em) {
     return -1;
   }
 
-  int err_save = 0;
   unsigned int i;
   energymon_msr* state = em->state;
+  int err_save = msr_readers_stop(state);
   for (i = 0; i < state->msr_count; i++) {
     if (state->msrs[i].fd > 0 && close(state->msrs[i].fd)) {
       err_save = errno;
     }
   }
+  if (state->batch_fd > 0 && close(state->batch_fd)) {
+    err_save = errno;
+  }
+  free(state->batch.ops);
   free(em->state);
   em->state = NULL;
   errno = err_save;
@@ -215,6 +726,11 @@ uint64_t energymon_get_interval_msr(const energymon* em) {
     errno = EINVAL;
     return 0;
   }
+  const energymon_msr* state = (const energymon_msr*) em->state;
+  // with reader threads, values only refresh as often as the readers do
+  if (state != NULL && state->reader_interval_us > 1000) {
+    return state->reader_interval_us;
+  }
   return 1000;
 }
 
@@ -226,10 +742,13 @@ uint64_t energymon_get_precision_msr(const energymon* em) {
   energymon_msr* state = (energymon_msr*) em->state;
   double units = 0;
   unsigned int i;
+  unsigned int d;
   for (i = 0; i < state->msr_count; i++) {
-    // precision limited by the largest units (they should all be the same though)
-    if (state->msrs[i].energy_units > units) {
-      units = state->msrs[i].energy_units;
+    for (d = 0; d < state->n_domains; d++) {
+      // precision limited by the largest units
+      if (state->msrs[i].channels[d].energy_units > units) {
+        units = state->msrs[i].channels[d].energy_units;
+      }
     }
   }
   return (uint64_t) (units * 1000000);
@@ -239,6 +758,37 @@ int energymon_is_exclusive_msr(void) {
   return 0;
 }
 
+size_t energymon_get_channel_count_msr(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  const energymon_msr* state = (energymon_msr*) em->state;
+  return (size_t) state->msr_count * state->n_domains;
+}
+
+char* energymon_get_channel_name_msr(const energymon* em, size_t channel, char* buffer, size_t n) {
+  if (em == NULL || em->state == NULL || buffer == NULL || n == 0 ||
+      channel >= energymon_get_channel_count_msr(em)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  const energymon_msr* state = (energymon_msr*) em->state;
+  snprintf(buffer, n, "cpu-%u:%s", state->msrs[channel / state->n_domains].cpu,
+           MSR_DOMAINS[state->domains[channel % state->n_domains]].name);
+  return buffer;
+}
+
+int energymon_get_channel_topology_msr(const energymon* em, size_t channel, energymon_topology* topo) {
+  if (em == NULL || em->state == NULL || topo == NULL ||
+      channel >= energymon_get_channel_count_msr(em)) {
+    errno = EINVAL;
+    return -1;
+  }
+  const energymon_msr* state = (energymon_msr*) em->state;
+  return energymon_topology_get_cpu(get_sysfs_root(), state->msrs[channel / state->n_domains].cpu, topo);
+}
+
 int energymon_get_msr(energymon* em) {
   if (em == NULL) {
     errno = EINVAL;
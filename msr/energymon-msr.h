@@ -1,11 +1,28 @@
 /**
  * Read energy from X86 MSRs (Model-Specific Registers).
  *
- * By default, the MSR on cpu0 is read. To configure other MSRs, set the
- * ENERGYMON_MSRS environment variable with a comma-delimited list of CPU IDs,
- * e.g.:
+ * By default, the MSRs on one CPU per package (and die) are read, as discovered
+ * from sysfs. To configure other MSRs, set the ENERGYMON_MSRS environment
+ * variable with a comma-delimited list of CPU IDs, e.g.:
  *   export ENERGYMON_MSRS=0,4,8,12
  *
+ * To keep automatic discovery away from CPUs running latency-critical work, set
+ * ENERGYMON_MSR_AVOID_CPUS with a CPU list, e.g.:
+ *   export ENERGYMON_MSR_AVOID_CPUS=0-3,24-27
+ *
+ * By default, only the package domain is read. To configure other domains, set
+ * the ENERGYMON_MSR_DOMAINS environment variable with a comma-delimited list of
+ * domains (pkg, pp0, pp1, dram), e.g.:
+ *   export ENERGYMON_MSR_DOMAINS=pkg,dram
+ *
+ * To avoid sending an IPI to each MSR's CPU on every read, set the
+ * ENERGYMON_MSR_READER_INTERVAL_US environment variable. A reader thread pinned
+ * to each MSR's CPU then refreshes its MSRs locally at that interval, and reads
+ * return the latest published values, e.g.:
+ *   export ENERGYMON_MSR_READER_INTERVAL_US=1000
+ * The interval may be at most 10 seconds, so that energy counter overflows
+ * aren't missed.
+ *
  * @author Hank Hoffmann
  * @author Connor Imes
  */
@@ -19,11 +36,24 @@ extern "C" {
 #include <inttypes.h>
 #include <stddef.h>
 #include "energymon.h"
+#include "energymon-topology.h"
 
 /* Environment variable for specifying the MSRs to use */
 #define ENERGYMON_MSR_ENV_VAR "ENERGYMON_MSRS"
 #define ENERGYMON_MSRS_DELIMS ", :;|"
 
+/* Environment variable for specifying CPUs to avoid when discovering MSRs, in sysfs CPU list format */
+#define ENERGYMON_MSR_AVOID_CPUS_ENV_VAR "ENERGYMON_MSR_AVOID_CPUS"
+
+/* Environment variable for overriding the sysfs root used for discovery, e.g., for testing */
+#define ENERGYMON_MSR_SYSFS_ROOT_ENV_VAR "ENERGYMON_MSR_SYSFS_ROOT"
+
+/* Environment variable for enabling pinned reader threads with a refresh interval in microseconds */
+#define ENERGYMON_MSR_READER_INTERVAL_US_ENV_VAR "ENERGYMON_MSR_READER_INTERVAL_US"
+
+/* Environment variable for specifying the RAPL domains to read (same delimiters) */
+#define ENERGYMON_MSR_DOMAINS_ENV_VAR "ENERGYMON_MSR_DOMAINS"
+
 int energymon_init_msr(energymon* em);
 
 uint64_t energymon_read_total_msr(const energymon* em);
@@ -40,6 +70,57 @@ int energymon_is_exclusive_msr(void);
 
 int energymon_get_msr(energymon* em);
 
+/**
+ * Get the number of channels, i.e., (CPU, domain) pairs.
+ *
+ * @param em
+ *  an initialized energymon
+ * @return the channel count, or 0 on failure (errno is set)
+ */
+size_t energymon_get_channel_count_msr(const energymon* em);
+
+/**
+ * Get a human-readable name for a channel, e.g., "cpu-0:pkg" or "cpu-0:dram".
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_msr)
+ * @param buffer
+ *  the destination buffer, which will be null-terminated
+ * @param n
+ *  the buffer size
+ * @return pointer to buffer, or NULL on failure (errno is set)
+ */
+char* energymon_get_channel_name_msr(const energymon* em, size_t channel, char* buffer, size_t n);
+
+/**
+ * Get the total energy and the per-channel energy in microjoules from a single read pass.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param energy_uj
+ *  array to store per-channel energy values, may be NULL if n is 0
+ * @param n
+ *  the array length - values are written for at most n channels
+ * @return total energy (in uJ), or 0 on failure (errno is set)
+ */
+uint64_t energymon_read_channels_msr(const energymon* em, uint64_t* energy_uj, size_t n);
+
+/**
+ * Get the topology of the CPUs covered by a channel, i.e., the package (and die) of the channel's CPU.
+ * Other domains, e.g., "dram", report the topology of the package they belong to.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_msr)
+ * @param topo
+ *  the topology to populate
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_get_channel_topology_msr(const energymon* em, size_t channel, energymon_topology* topo);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,7 +9,6 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,7 +16,7 @@
 #include <sys/ioctl.h>
 #include "energymon.h"
 #include "energymon-odroid-ioctl.h"
-#include "energymon-time-util.h"
+#include "energymon-poller.h"
 #include "energymon-util.h"
 
 #ifdef ENERGYMON_DEFAULT
@@ -63,11 +62,8 @@ typedef struct energymon_odroid_ioctl {
   ina231_sensor_t sensor[SENSOR_COUNT];
   // sensor update interval in microseconds
   unsigned long poll_delay_us;
-  // total energy estimate
-  uint64_t total_uj;
-  // thread variables
-  pthread_t thread;
-  int poll_sensors;
+  // polls the sensors and integrates the total energy estimate
+  energymon_poller_source poller;
 } energymon_odroid_ioctl;
 
 static inline int set_sensor_enable(ina231_sensor_t* sensor, int enable) {
@@ -130,13 +126,9 @@ int energymon_finish_odroid_ioctl(energymon* em) {
 
   int err_save = 0;
   energymon_odroid_ioctl* state = (energymon_odroid_ioctl*) em->state;
-  if (state->poll_sensors) {
-    // stop sensors polling thread and cleanup
-    state->poll_sensors = 0;
-#ifndef __ANDROID__
-    pthread_cancel(state->thread);
-#endif
-    err_save = pthread_join(state->thread, NULL);
+  // stop polling sensors
+  if (energymon_poller_stop(&state->poller)) {
+    err_save = errno;
   }
   if (close_all_sensors(state)) {
     err_save = err_save ? err_save : errno;
@@ -148,47 +140,26 @@ int energymon_finish_odroid_ioctl(energymon* em) {
 }
 
 /**
- * pthread function to poll the sensors at regular intervals.
+ * Read the sensors, called at regular intervals by the poller.
  */
-static void* odroid_ioctl_poll_sensors(void* args) {
-  energymon_odroid_ioctl* state = (energymon_odroid_ioctl*) args;
+static int odroid_ioctl_read_power(void* ctx, uint64_t* power_uw) {
+  energymon_odroid_ioctl* state = (energymon_odroid_ioctl*) ctx;
   uint64_t sum_uw;
   unsigned int i;
-  uint64_t exec_us;
-  uint64_t last_us;
-  int err_save;
-  if (!(last_us = energymon_gettime_us())) {
-    // must be that CLOCK_MONOTONIC is not supported
-    perror("odroid_ioctl_poll_sensors");
-    return (void*) NULL;
-  }
-  energymon_sleep_us(state->poll_delay_us, &state->poll_sensors);
-  while (state->poll_sensors) {
-    // read individual sensors
-    for (errno = 0, sum_uw = 0, i = 0; i < SENSOR_COUNT && !errno; i++) {
-      if (!read_sensor_data(&state->sensor[i])) {
-        sum_uw += state->sensor[i].data.cur_uW;
-      }
-    }
-    err_save = errno;
-    exec_us = energymon_gettime_elapsed_us(&last_us);
-    if (err_save) {
-      errno = err_save;
-      perror("odroid_ioctl_poll_sensors: skipping power sensor reading");
-    } else {
-      state->total_uj += sum_uw * exec_us / 1000000;
+  for (errno = 0, sum_uw = 0, i = 0; i < SENSOR_COUNT && !errno; i++) {
+    if (!read_sensor_data(&state->sensor[i])) {
+      sum_uw += state->sensor[i].data.cur_uW;
     }
-    // sleep for the update interval of the sensors
-    if (state->poll_sensors) {
-      energymon_sleep_us(state->poll_delay_us, &state->poll_sensors);
-    }
-    errno = 0;
   }
-  return (void*) NULL;
+  if (errno) {
+    return -1;
+  }
+  *power_uw = sum_uw;
+  return 0;
 }
 
 /**
- * Open all sensor files and start the thread to poll the sensors.
+ * Open all sensor files and start polling the sensors.
  */
 int energymon_init_odroid_ioctl(energymon* em) {
   if (em == NULL || em->state != NULL) {
@@ -214,11 +185,12 @@ int energymon_init_odroid_ioctl(energymon* em) {
     return -1;
   }
 
-  // start sensors polling thread
-  state->poll_sensors = 1;
-  errno = pthread_create(&state->thread, NULL, odroid_ioctl_poll_sensors,
-                         state);
-  if (errno) {
+  // start polling sensors
+  state->poller.name = "energymon-odroid-ioctl";
+  state->poller.read = odroid_ioctl_read_power;
+  state->poller.ctx = state;
+  state->poller.interval_us = state->poll_delay_us;
+  if (energymon_poller_start(&state->poller)) {
     err_save = errno;
     close_all_sensors(state);
     free(state);
@@ -236,7 +208,7 @@ uint64_t energymon_read_total_odroid_ioctl(const energymon* em) {
     return 0;
   }
   errno = 0;
-  return ((energymon_odroid_ioctl*) em->state)->total_uj;
+  return energymon_poller_get_total_uj(&((energymon_odroid_ioctl*) em->state)->poller);
 }
 
 char* energymon_get_source_odroid_ioctl(char* buffer, size_t n) {
@@ -9,14 +9,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "energymon.h"
 #include "energymon-odroid.h"
-#include "energymon-time-util.h"
+#include "energymon-poller.h"
 #include "energymon-util.h"
 
 #ifdef ENERGYMON_DEFAULT
@@ -35,11 +34,8 @@ int energymon_get_default(energymon* em) {
 typedef struct energymon_odroid {
   // sensor update interval in microseconds
   unsigned long read_delay_us;
-  // thread variables
-  pthread_t thread;
-  int poll_sensors;
-  // total energy estimate
-  uint64_t total_uj;
+  // polls the sensors and integrates the total energy estimate
+  energymon_poller_source poller;
   // sensor file descriptors
   unsigned int count;
   int fds[];
@@ -51,9 +47,11 @@ typedef struct energymon_odroid {
 static inline int is_sensor_enabled(const char* file) {
   int fd;
   char cdata[24];
+  ssize_t len = 0;
+  uint64_t enabled = 0;
   int err_save = 0;
   if ((fd = open(file, O_RDONLY)) > 0) {
-    if (read(fd, cdata, sizeof(cdata)) < 0) {
+    if ((len = read(fd, cdata, sizeof(cdata))) < 0) {
       err_save = errno;
     }
     if (close(fd)) {
@@ -61,12 +59,15 @@ static inline int is_sensor_enabled(const char* file) {
     }
     errno = err_save;
   }
-  return errno ? 0 : atoi(cdata);
+  if (errno || len <= 0 || !energymon_strntou64(cdata, (size_t) len, &enabled)) {
+    return 0;
+  }
+  return enabled != 0;
 }
 
 static inline unsigned long get_update_interval(char** sensors, unsigned int num) {
   unsigned long ret = 0;
-  unsigned long tmp;
+  uint64_t tmp;
   unsigned int i;
   char file[64];
   int fd;
@@ -86,13 +87,11 @@ static inline unsigned long get_update_interval(char** sensors, unsigned int num
       perror(file);
     }
     if (read_ret > 0) {
-      errno = 0;
-      tmp = strtoul(cdata, NULL, 0);
-      if (errno) {
+      if (!energymon_strntou64(cdata, (size_t) read_ret, &tmp)) {
         perror(file);
       } else {
         // keep the largest update_interval
-        ret = tmp > ret ? tmp : ret;
+        ret = tmp > ret ? (unsigned long) tmp : ret;
       }
     }
   }
@@ -115,13 +114,9 @@ int energymon_finish_odroid(energymon* em) {
   unsigned int i;
   energymon_odroid* state = (energymon_odroid*) em->state;
 
-  if (state->poll_sensors) {
-    // stop sensors polling thread and cleanup
-    state->poll_sensors = 0;
-#ifndef __ANDROID__
-    pthread_cancel(state->thread);
-#endif
-    err_save = pthread_join(state->thread, NULL);
+  // stop polling sensors
+  if (energymon_poller_stop(&state->poller)) {
+    err_save = errno;
   }
 
   // close individual sensor files
@@ -203,48 +198,31 @@ static inline char** get_sensor_directories(unsigned int* count) {
 }
 
 /**
- * pthread function to poll the sensors at regular intervals.
+ * Read the sensors, called at regular intervals by the poller.
  */
-static void* odroid_poll_sensors(void* args) {
-  energymon_odroid* state = (energymon_odroid*) args;
+static int odroid_read_power(void* ctx, uint64_t* power_uw) {
+  const energymon_odroid* state = (const energymon_odroid*) ctx;
   char cdata[8];
-  double sum_w;
+  ssize_t len;
+  uint64_t uw;
+  uint64_t sum_uw;
   unsigned int i;
-  uint64_t exec_us;
-  uint64_t last_us;
-  int err_save;
-  if (!(last_us = energymon_gettime_us())) {
-    // must be that CLOCK_MONOTONIC is not supported
-    perror("odroid_poll_sensors");
-    return (void*) NULL;
-  }
-  energymon_sleep_us(state->read_delay_us, &state->poll_sensors);
-  while (state->poll_sensors) {
-    // read individual sensors
-    for (sum_w = 0, errno = 0, i = 0; i < state->count && !errno; i++) {
-      if (pread(state->fds[i], cdata, sizeof(cdata), 0) > 0) {
-        sum_w += strtod(cdata, NULL);
-      }
+  for (sum_uw = 0, errno = 0, i = 0; i < state->count && !errno; i++) {
+    // values are in Watts with up to 6 decimal places
+    if ((len = pread(state->fds[i], cdata, sizeof(cdata), 0)) > 0 &&
+        energymon_strntou64_fixed(cdata, (size_t) len, 6, &uw)) {
+      sum_uw += uw;
     }
-    err_save = errno;
-    exec_us = energymon_gettime_elapsed_us(&last_us);
-    if (err_save) {
-      errno = err_save;
-      perror("odroid_poll_sensors: skipping power sensor reading");
-    } else {
-      state->total_uj += (uint64_t) (sum_w * (double) exec_us);
-    }
-    // sleep for the update interval of the sensors
-    if (state->poll_sensors) {
-      energymon_sleep_us(state->read_delay_us, &state->poll_sensors);
-    }
-    errno = 0;
   }
-  return (void*) NULL;
+  if (errno) {
+    return -1;
+  }
+  *power_uw = sum_uw;
+  return 0;
 }
 
 /**
- * Open all sensor files and start the thread to poll the sensors.
+ * Open all sensor files and start polling the sensors.
  */
 int energymon_init_odroid(energymon* em) {
   if (em == NULL || em->state != NULL) {
@@ -308,10 +286,12 @@ int energymon_init_odroid(energymon* em) {
   // we're finished with this variable
   free_sensor_directories(sensor_dirs, state->count);
 
-  // start sensors polling thread
-  state->poll_sensors = 1;
-  errno = pthread_create(&state->thread, NULL, odroid_poll_sensors, state);
-  if (errno) {
+  // start polling sensors
+  state->poller.name = "energymon-odroid";
+  state->poller.read = odroid_read_power;
+  state->poller.ctx = state;
+  state->poller.interval_us = state->read_delay_us;
+  if (energymon_poller_start(&state->poller)) {
     err_save = errno;
     energymon_finish_odroid(em);
     errno = err_save;
@@ -327,7 +307,7 @@ uint64_t energymon_read_total_odroid(const energymon* em) {
     return 0;
   }
   errno = 0;
-  return ((energymon_odroid*) em->state)->total_uj;
+  return energymon_poller_get_total_uj(&((energymon_odroid*) em->state)->poller);
 }
 
 char* energymon_get_source_odroid(char* buffer, size_t n) {
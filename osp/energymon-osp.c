@@ -32,8 +32,8 @@
 #include <string.h>
 #include "energymon.h"
 #ifdef ENERGYMON_OSP_USE_POLLING
-#include <pthread.h>
 #include "energymon-osp-polling.h"
+#include "energymon-poller.h"
 #else
 #include "energymon-osp.h"
 #endif
@@ -104,9 +104,8 @@ typedef struct energymon_osp {
   hid_device* device;
   unsigned char buf[OSP_BUF_SIZE];
 #ifdef ENERGYMON_OSP_USE_POLLING
-  uint64_t total_uj;
-  pthread_t thread;
-  int poll;
+  // polls the device and integrates the total energy estimate
+  energymon_poller_source poller;
 #else
   double wh_surplus;
 #endif
@@ -184,16 +183,9 @@ static int em_osp_finish(energymon* em, int start_errno) {
   int err_save = start_errno;
 
 #ifdef ENERGYMON_OSP_USE_POLLING
-  if (state->poll) {
-    // stop sensors polling thread and cleanup
-    state->poll = 0;
-#ifndef __ANDROID__
-   pthread_cancel(state->thread);
-#endif
-    errno = pthread_join(state->thread, NULL);
-    if (errno && !err_save) {
-      err_save = errno;
-    }
+  // stop polling device
+  if (energymon_poller_stop(&state->poller) && !err_save) {
+    err_save = errno;
   }
 #endif
 
@@ -240,52 +232,23 @@ static int em_osp_finish(energymon* em, int start_errno) {
 
 #ifdef ENERGYMON_OSP_USE_POLLING
 /**
- * pthread function to poll the device at regular intervals
+ * Read the device, called at regular intervals by the poller.
  */
-static void* osp_poll_device(void* args) {
-  energymon_osp* state = (energymon_osp*) args;
+static int osp_read_power(void* ctx, uint64_t* power_uw) {
+  energymon_osp* state = (energymon_osp*) ctx;
   double watts;
-  uint64_t exec_us;
-  uint64_t last_us;
-#ifndef __ANDROID__
-  int dummy_old_state;
-#endif
-  if (!(last_us = energymon_gettime_us())) {
-    // must be that CLOCK_MONOTONIC is not supported
-    perror("osp_poll_device: energymon_gettime_us");
-    return (void*) NULL;
+  if (em_osp_request_data_retry(state, ENERGYMON_OSP_RETRIES, NULL)) {
+    return -1;
   }
-  while (state->poll) {
-#ifndef __ANDROID__
-    // Deadlock can occur during disconnect if thread is canceled during I/O
-    // Enable thread cancel while sleeping, disable during I/O
-    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &dummy_old_state);
-#endif
-    errno = 0;
-    if (em_osp_request_data_retry(state, ENERGYMON_OSP_RETRIES, &state->poll) == 0) {
-      // Watt value always starts at index 17
-      state->buf[OSP_BUF_SIZE - 1] = '\0';
-      errno = 0;
-      watts = strtod((const char*) &state->buf[17], NULL);
-      if (errno) {
-        perror("osp_poll_device: strtod");
-        watts = 0;
-      }
-    } else {
-      perror("osp_poll_device: em_osp_request_data_retry");
-      watts = 0;
-    }
-    exec_us = energymon_gettime_elapsed_us(&last_us);
-    state->total_uj += (uint64_t) (watts * (double) exec_us);
-    // sleep for the polling delay
-    if (state->poll) {
-#ifndef __ANDROID__
-      pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &dummy_old_state);
-#endif
-      energymon_sleep_us(ENERGYMON_OSP_POLL_DELAY_US, &state->poll);
-    }
+  // Watt value always starts at index 17
+  state->buf[OSP_BUF_SIZE - 1] = '\0';
+  errno = 0;
+  watts = strtod((const char*) &state->buf[17], NULL);
+  if (errno) {
+    return -1;
   }
-  return (void*) NULL;
+  *power_uw = (uint64_t) (watts * 1000000);
+  return 0;
 }
 #endif
 
@@ -384,11 +347,14 @@ int energymon_init_osp(energymon* em) {
   }
 
 #ifdef ENERGYMON_OSP_USE_POLLING
-  // start device polling thread
-  state->poll = 1;
-  errno = pthread_create(&state->thread, NULL, osp_poll_device, state);
-  if (errno) {
-    return em_osp_init_fail(em, ENERGYMON_INIT_OSP": pthread_create", errno);
+  // start polling device - HID I/O blocks, so don't share the poller's timer thread
+  state->poller.name = "energymon-osp-polling";
+  state->poller.read = osp_read_power;
+  state->poller.ctx = state;
+  state->poller.interval_us = ENERGYMON_OSP_POLL_DELAY_US;
+  state->poller.dedicated = 1;
+  if (energymon_poller_start(&state->poller)) {
+    return em_osp_init_fail(em, ENERGYMON_INIT_OSP": energymon_poller_start", errno);
   }
 #endif
 
@@ -407,7 +373,7 @@ uint64_t energymon_read_total_osp(const energymon* em) {
   energymon_osp* state = (energymon_osp*) em->state;
 #ifdef ENERGYMON_OSP_USE_POLLING
   errno = 0;
-  return state->total_uj;
+  return energymon_poller_get_total_uj(&state->poller);
 #else
   double wh;
   if (em_osp_request_data_retry(state, ENERGYMON_OSP_RETRIES, NULL)) {
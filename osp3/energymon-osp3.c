@@ -14,6 +14,7 @@
 #include <osp3.h>
 #include "energymon.h"
 #include "energymon-osp3.h"
+#include "energymon-seqlock.h"
 #include "energymon-util.h"
 
 #ifdef ENERGYMON_DEFAULT
@@ -41,11 +42,12 @@ typedef enum energymon_osp3_power_source {
 
 typedef struct energymon_osp3 {
   osp3_device* dev;
-  uint64_t total_uj;
+  // read concurrently with the polling thread's updates
+  energymon_shared_u64 total_uj;
   pthread_t thread;
   int poll;
   energymon_osp3_power_source src;
-  uint64_t interval_us;
+  energymon_shared_u64 interval_us;
 } energymon_osp3;
 
 // Bigger than anything an OSP3 should produce.
@@ -115,6 +117,7 @@ static void* osp3_poll_device(void* args) {
   uint8_t cs8_2s;
   uint8_t cs8_xor;
   unsigned long ms_last = 0;
+  uint64_t interval_us;
   if (osp3_flush(state->dev) < 0) {
     // Continue anyway...
     perror("osp3_poll_device: osp3_flush");
@@ -150,8 +153,10 @@ static void* osp3_poll_device(void* args) {
       fprintf(stderr, "osp3_poll_device: checksum failed (cs8_2s=%02x, cs8_xor=%02x): %s", cs8_2s, cs8_xor, line);
     } else {
       // This could be wrong if we miss a log entry, but it's as good as we can do...
-      state->total_uj += log_entry_to_uj(&log_entry, ms_last, state->src);
-      log_entry_to_interval_us(&log_entry, ms_last, &state->interval_us);
+      energymon_shared_u64_add(&state->total_uj, log_entry_to_uj(&log_entry, ms_last, state->src));
+      interval_us = energymon_shared_u64_load(&state->interval_us);
+      log_entry_to_interval_us(&log_entry, ms_last, &interval_us);
+      energymon_shared_u64_store(&state->interval_us, interval_us);
       ms_last = log_entry.ms;
     }
   }
@@ -198,7 +203,7 @@ int energymon_init_osp3(energymon* em) {
     return -1;
   }
   state->src = src;
-  state->interval_us = ENERGYMON_OSP3_INTERVAL_US_DEFAULT;
+  energymon_shared_u64_store(&state->interval_us, ENERGYMON_OSP3_INTERVAL_US_DEFAULT);
   em->state = state;
 
   // start device polling thread
@@ -220,7 +225,7 @@ uint64_t energymon_read_total_osp3(const energymon* em) {
   }
   energymon_osp3* state = (energymon_osp3*) em->state;
   errno = 0;
-  return state->total_uj;
+  return energymon_shared_u64_load(&state->total_uj);
 }
 
 int energymon_finish_osp3(energymon* em) {
@@ -257,7 +262,7 @@ uint64_t energymon_get_interval_osp3(const energymon* em) {
     return 0;
   }
   energymon_osp3* state = (energymon_osp3*) em->state;
-  return state == NULL ? ENERGYMON_OSP3_INTERVAL_US_DEFAULT : state->interval_us;
+  return state == NULL ? ENERGYMON_OSP3_INTERVAL_US_DEFAULT : energymon_shared_u64_load(&state->interval_us);
 }
 
 uint64_t energymon_get_precision_osp3(const energymon* em) {
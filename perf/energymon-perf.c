@@ -0,0 +1,532 @@
+/**
+ * Read energy from Intel/AMD RAPL via the Linux perf_event "power" PMU.
+ *
+ * Unlike the powercap sysfs files, the kernel maintains 64-bit event counts,
+ * so no overflow handling is needed here.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "energymon.h"
+#include "energymon-perf.h"
+#include "energymon-topology.h"
+#include "energymon-topology-util.h"
+#include "energymon-util.h"
+
+#ifdef ENERGYMON_DEFAULT
+#include "energymon-default.h"
+int energymon_get_default(energymon* em) {
+  return energymon_get_perf(em);
+}
+#endif
+
+// tests point this at a fixture
+#ifndef PERF_POWER_DIR
+#define PERF_POWER_DIR "/sys/bus/event_source/devices/power"
+#endif
+#define PERF_EVENT_PREFIX "energy-"
+#define PERF_EVENT_UNIT "Joules"
+
+// Domain names as exposed by the kernel, without the PERF_EVENT_PREFIX
+static const char* const PERF_DOMAINS[] = {
+  "cores",
+  "pkg",
+  "ram",
+  "gpu",
+  "psys",
+};
+#define PERF_DOMAINS_MAX (sizeof(PERF_DOMAINS) / sizeof(PERF_DOMAINS[0]))
+#define PERF_DOMAIN_DEFAULT "pkg"
+// The psys domain spans the platform, not a package, so only read it once
+#define PERF_DOMAIN_PSYS "psys"
+
+typedef struct perf_domain {
+  const char* name;
+  uint64_t config;
+  double scale_uj;
+} perf_domain;
+
+typedef struct perf_group {
+  int cpu;
+  unsigned int n_events;
+  // index into the state's domains array for each event in the group
+  unsigned int domain_idx[PERF_DOMAINS_MAX];
+  int fds[PERF_DOMAINS_MAX];
+} perf_group;
+
+typedef struct energymon_perf {
+  unsigned int n_domains;
+  perf_domain domains[PERF_DOMAINS_MAX];
+  size_t n_channels;
+  unsigned int n_groups;
+  perf_group groups[];
+} energymon_perf;
+
+static long perf_event_open(struct perf_event_attr* attr, pid_t pid, int cpu, int group_fd, unsigned long flags) {
+  return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+/**
+ * Read a small sysfs file into a null-terminated buffer, stripping trailing whitespace.
+ * Returns 0 on success, -1 on failure (errno is set).
+ */
+static int read_sysfs_str(const char* path, char* buf, size_t len) {
+  ssize_t ret;
+  int err_save;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  ret = read(fd, buf, len - 1);
+  err_save = errno;
+  close(fd);
+  if (ret < 0) {
+    errno = err_save;
+    return -1;
+  }
+  while (ret > 0 && (buf[ret - 1] == '\n' || buf[ret - 1] == ' ')) {
+    ret--;
+  }
+  buf[ret] = '\0';
+  return 0;
+}
+
+static int perf_get_pmu_type(uint32_t* type) {
+  char buf[32];
+  char* end;
+  if (read_sysfs_str(PERF_POWER_DIR"/type", buf, sizeof(buf))) {
+    if (errno == ENOENT) {
+      fprintf(stderr, "energymon_init_perf: No perf power PMU found: "PERF_POWER_DIR"\n");
+      errno = ENODEV;
+    } else {
+      perror(PERF_POWER_DIR"/type");
+    }
+    return -1;
+  }
+  errno = 0;
+  *type = (uint32_t) strtoul(buf, &end, 10);
+  if (errno || end == buf) {
+    fprintf(stderr, "energymon_init_perf: Failed to parse PMU type: %s\n", buf);
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Returns 1 if the domain's event exists, 0 if not, or -1 on failure (errno is set).
+ */
+static int perf_domain_init(perf_domain* d, const char* name) {
+  char path[128];
+  char buf[64];
+  const char* cfg;
+  char* end;
+  double scale;
+  d->name = name;
+  // event config, e.g., "event=0x02"
+  snprintf(path, sizeof(path), PERF_POWER_DIR"/events/"PERF_EVENT_PREFIX"%s", name);
+  if (read_sysfs_str(path, buf, sizeof(buf))) {
+    if (errno == ENOENT) {
+      return 0;
+    }
+    perror(path);
+    return -1;
+  }
+  if ((cfg = strstr(buf, "event=")) == NULL) {
+    fprintf(stderr, "energymon_init_perf: Unexpected event format in %s: %s\n", path, buf);
+    errno = EINVAL;
+    return -1;
+  }
+  errno = 0;
+  d->config = strtoull(cfg + sizeof("event=") - 1, &end, 0);
+  if (errno || end == cfg + sizeof("event=") - 1) {
+    fprintf(stderr, "energymon_init_perf: Failed to parse event config in %s: %s\n", path, buf);
+    errno = EINVAL;
+    return -1;
+  }
+  // unit must be Joules, otherwise we don't know how to interpret the scale
+  snprintf(path, sizeof(path), PERF_POWER_DIR"/events/"PERF_EVENT_PREFIX"%s.unit", name);
+  if (read_sysfs_str(path, buf, sizeof(buf))) {
+    perror(path);
+    return -1;
+  }
+  if (strcmp(buf, PERF_EVENT_UNIT)) {
+    fprintf(stderr, "energymon_init_perf: Unsupported unit in %s: %s\n", path, buf);
+    errno = ENOTSUP;
+    return -1;
+  }
+  // scale converts counts to Joules
+  snprintf(path, sizeof(path), PERF_POWER_DIR"/events/"PERF_EVENT_PREFIX"%s.scale", name);
+  if (read_sysfs_str(path, buf, sizeof(buf))) {
+    perror(path);
+    return -1;
+  }
+  errno = 0;
+  scale = strtod(buf, &end);
+  if (errno || end == buf || scale <= 0) {
+    fprintf(stderr, "energymon_init_perf: Failed to parse scale in %s: %s\n", path, buf);
+    errno = EINVAL;
+    return -1;
+  }
+  d->scale_uj = scale * 1000000.0;
+  return 1;
+}
+
+static int perf_find_domain(const char* name) {
+  unsigned int i;
+  if (!strncmp(name, PERF_EVENT_PREFIX, sizeof(PERF_EVENT_PREFIX) - 1)) {
+    name += sizeof(PERF_EVENT_PREFIX) - 1;
+  }
+  for (i = 0; i < PERF_DOMAINS_MAX; i++) {
+    if (!strcmp(name, PERF_DOMAINS[i])) {
+      return (int) i;
+    }
+  }
+  return -1;
+}
+
+static int perf_domains_init(energymon_perf* state) {
+  char* tmp;
+  char* tok;
+  char* saveptr;
+  int idx;
+  unsigned int i;
+  int rc;
+  int requested[PERF_DOMAINS_MAX] = { 0 };
+  const char* env_domains = getenv(ENERGYMON_PERF_DOMAINS);
+  if (env_domains == NULL) {
+    env_domains = PERF_DOMAIN_DEFAULT;
+  }
+  if ((tmp = strdup(env_domains)) == NULL) {
+    return -1;
+  }
+  for (tok = strtok_r(tmp, ENERGYMON_PERF_DOMAINS_DELIMS, &saveptr); tok;
+       tok = strtok_r(NULL, ENERGYMON_PERF_DOMAINS_DELIMS, &saveptr)) {
+    if ((idx = perf_find_domain(tok)) < 0) {
+      fprintf(stderr, "energymon_init_perf: Unknown domain: %s\n", tok);
+      free(tmp);
+      errno = EINVAL;
+      return -1;
+    }
+    requested[idx] = 1;
+  }
+  free(tmp);
+  // keep a consistent domain order regardless of how they were specified
+  for (state->n_domains = 0, i = 0; i < PERF_DOMAINS_MAX; i++) {
+    if (!requested[i]) {
+      continue;
+    }
+    if ((rc = perf_domain_init(&state->domains[state->n_domains], PERF_DOMAINS[i])) < 0) {
+      return -1;
+    }
+    if (rc == 0) {
+      fprintf(stderr, "energymon_init_perf: Domain not supported: "PERF_EVENT_PREFIX"%s\n", PERF_DOMAINS[i]);
+      errno = ENODEV;
+      return -1;
+    }
+    state->n_domains++;
+  }
+  if (state->n_domains == 0) {
+    fprintf(stderr, "energymon_init_perf: No domains specified: "ENERGYMON_PERF_DOMAINS"=%s\n", env_domains);
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * The PMU's cpumask lists one CPU per package (or die), e.g., "0,24" or "0-1".
+ * Returns the number of CPUs, or 0 on failure (errno is set).
+ */
+static unsigned int perf_get_cpus(uint64_t* mask) {
+  char buf[4096];
+  ssize_t len;
+  int count;
+  int fd = open(PERF_POWER_DIR"/cpumask", O_RDONLY);
+  if (fd < 0) {
+    perror(PERF_POWER_DIR"/cpumask");
+    return 0;
+  }
+  len = read(fd, buf, sizeof(buf));
+  close(fd);
+  if (len < 0) {
+    perror(PERF_POWER_DIR"/cpumask");
+    return 0;
+  }
+  if ((count = energymon_topology_parse_cpulist(buf, (size_t) len, mask)) < 0) {
+    fprintf(stderr, "energymon_init_perf: Failed to parse "PERF_POWER_DIR"/cpumask: %.*s\n", (int) len, buf);
+    errno = EINVAL;
+    return 0;
+  }
+  if (count == 0) {
+    errno = ENODEV;
+  }
+  return (unsigned int) count;
+}
+
+static int perf_groups_close(energymon_perf* state) {
+  int err_save = 0;
+  unsigned int g;
+  unsigned int e;
+  for (g = 0; g < state->n_groups; g++) {
+    // close siblings before the group leader
+    for (e = state->groups[g].n_events; e > 0; e--) {
+      if (state->groups[g].fds[e - 1] >= 0 && close(state->groups[g].fds[e - 1])) {
+        err_save = err_save ? err_save : errno;
+      }
+      state->groups[g].fds[e - 1] = -1;
+    }
+  }
+  errno = err_save;
+  return errno ? -1 : 0;
+}
+
+static int perf_groups_open(energymon_perf* state, uint32_t type) {
+  struct perf_event_attr attr;
+  perf_group* grp;
+  unsigned int g;
+  unsigned int d;
+  unsigned int n;
+  int group_fd;
+  int fd;
+  for (g = 0; g < state->n_groups; g++) {
+    grp = &state->groups[g];
+    for (d = 0; d < state->n_domains; d++) {
+      if (g > 0 && !strcmp(state->domains[d].name, PERF_DOMAIN_PSYS)) {
+        continue;
+      }
+      memset(&attr, 0, sizeof(attr));
+      attr.type = type;
+      attr.size = sizeof(attr);
+      attr.config = state->domains[d].config;
+      attr.read_format = PERF_FORMAT_GROUP;
+      group_fd = grp->n_events == 0 ? -1 : grp->fds[0];
+      if ((fd = (int) perf_event_open(&attr, -1, grp->cpu, group_fd, 0)) < 0) {
+        fprintf(stderr, "energymon_init_perf: perf_event_open: cpu %d: "PERF_EVENT_PREFIX"%s: %s\n",
+                grp->cpu, state->domains[d].name, strerror(errno));
+        return -1;
+      }
+      grp->domain_idx[grp->n_events] = d;
+      grp->fds[grp->n_events] = fd;
+      grp->n_events++;
+      state->n_channels++;
+    }
+  }
+  // drop groups without events, e.g., if psys is the only domain, so reads and channel lookups never see them
+  for (g = 0, n = 0; g < state->n_groups; g++) {
+    if (state->groups[g].n_events > 0) {
+      state->groups[n++] = state->groups[g];
+    }
+  }
+  state->n_groups = n;
+  return 0;
+}
+
+int energymon_init_perf(energymon* em) {
+  if (em == NULL || em->state != NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  uint32_t type;
+  uint64_t cpus[ENERGYMON_TOPOLOGY_CPU_WORDS];
+  unsigned int n_cpus;
+  unsigned int cpu;
+  unsigned int i;
+  unsigned int e;
+  int err_save;
+  if (perf_get_pmu_type(&type)) {
+    return -1;
+  }
+  if ((n_cpus = perf_get_cpus(cpus)) == 0) {
+    return -1;
+  }
+
+  energymon_perf* state = calloc(1, sizeof(energymon_perf) + n_cpus * sizeof(perf_group));
+  if (state == NULL) {
+    return -1;
+  }
+  state->n_groups = n_cpus;
+  for (i = 0, cpu = 0; cpu < ENERGYMON_TOPOLOGY_MAX_CPUS; cpu++) {
+    if ((cpus[cpu / 64] >> (cpu % 64)) & 1) {
+      state->groups[i].cpu = (int) cpu;
+      // fd 0 is valid, so unopened fds are -1
+      for (e = 0; e < PERF_DOMAINS_MAX; e++) {
+        state->groups[i].fds[e] = -1;
+      }
+      i++;
+    }
+  }
+
+  if (perf_domains_init(state) || perf_groups_open(state, type)) {
+    err_save = errno;
+    perf_groups_close(state);
+    free(state);
+    errno = err_save;
+    return -1;
+  }
+
+  em->state = state;
+  return 0;
+}
+
+uint64_t energymon_read_channels_perf(const energymon* em, uint64_t* energy_uj, size_t n) {
+  if (em == NULL || em->state == NULL || (energy_uj == NULL && n > 0)) {
+    errno = EINVAL;
+    return 0;
+  }
+  // PERF_FORMAT_GROUP: { u64 nr; u64 values[nr]; }
+  uint64_t buf[1 + PERF_DOMAINS_MAX];
+  uint64_t uj;
+  uint64_t total = 0;
+  size_t ch = 0;
+  unsigned int g;
+  unsigned int e;
+  ssize_t len;
+  const energymon_perf* state = (energymon_perf*) em->state;
+  for (g = 0; g < state->n_groups; g++) {
+    const perf_group* grp = &state->groups[g];
+    len = read(grp->fds[0], buf, (1 + grp->n_events) * sizeof(uint64_t));
+    if (len != (ssize_t) ((1 + grp->n_events) * sizeof(uint64_t)) || buf[0] != grp->n_events) {
+      if (len >= 0) {
+        errno = EIO;
+      }
+      return 0;
+    }
+    for (e = 0; e < grp->n_events; e++, ch++) {
+      uj = (uint64_t) ((double) buf[1 + e] * state->domains[grp->domain_idx[e]].scale_uj);
+      if (ch < n) {
+        energy_uj[ch] = uj;
+      }
+      total += uj;
+    }
+  }
+  errno = 0;
+  return total;
+}
+
+uint64_t energymon_read_total_perf(const energymon* em) {
+  return energymon_read_channels_perf(em, NULL, 0);
+}
+
+int energymon_finish_perf(energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  int ret = perf_groups_close((energymon_perf*) em->state);
+  free(em->state);
+  em->state = NULL;
+  return ret;
+}
+
+char* energymon_get_source_perf(char* buffer, size_t n) {
+  return energymon_strencpy(buffer, "RAPL via perf_event power PMU", n);
+}
+
+uint64_t energymon_get_interval_perf(const energymon* em) {
+  if (em == NULL) {
+    // we don't need to access em, but it's still a programming error
+    errno = EINVAL;
+    return 0;
+  }
+  return 1000;
+}
+
+uint64_t energymon_get_precision_perf(const energymon* em) {
+  if (em == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  // the kernel rescales counts, so the scale doesn't reflect the hardware's energy units
+  return 0;
+}
+
+int energymon_is_exclusive_perf(void) {
+  return 0;
+}
+
+size_t energymon_get_channel_count_perf(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  return ((energymon_perf*) em->state)->n_channels;
+}
+
+/**
+ * Find the group and event index for a channel.
+ * Returns the group, or NULL if the channel is out of range.
+ */
+static const perf_group* perf_find_channel(const energymon_perf* state, size_t channel, unsigned int* event) {
+  unsigned int g;
+  for (g = 0; g < state->n_groups; g++) {
+    if (channel < state->groups[g].n_events) {
+      *event = (unsigned int) channel;
+      return &state->groups[g];
+    }
+    channel -= state->groups[g].n_events;
+  }
+  return NULL;
+}
+
+char* energymon_get_channel_name_perf(const energymon* em, size_t channel, char* buffer, size_t n) {
+  if (em == NULL || em->state == NULL || buffer == NULL || n == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  const energymon_perf* state = (energymon_perf*) em->state;
+  unsigned int e;
+  const perf_group* grp = perf_find_channel(state, channel, &e);
+  if (grp == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+  snprintf(buffer, n, "cpu-%d:"PERF_EVENT_PREFIX"%s", grp->cpu, state->domains[grp->domain_idx[e]].name);
+  return buffer;
+}
+
+int energymon_get_channel_topology_perf(const energymon* em, size_t channel, energymon_topology* topo) {
+  if (em == NULL || em->state == NULL || topo == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  const energymon_perf* state = (energymon_perf*) em->state;
+  unsigned int e;
+  const perf_group* grp = perf_find_channel(state, channel, &e);
+  if (grp == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (!strcmp(state->domains[grp->domain_idx[e]].name, PERF_DOMAIN_PSYS)) {
+    return energymon_topology_get_package(ENERGYMON_TOPOLOGY_SYSFS_ROOT, -1, -1, topo);
+  }
+  return energymon_topology_get_cpu(ENERGYMON_TOPOLOGY_SYSFS_ROOT, (unsigned int) grp->cpu, topo);
+}
+
+int energymon_get_perf(energymon* em) {
+  if (em == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  em->finit = &energymon_init_perf;
+  em->fread = &energymon_read_total_perf;
+  em->ffinish = &energymon_finish_perf;
+  em->fsource = &energymon_get_source_perf;
+  em->finterval = &energymon_get_interval_perf;
+  em->fprecision = &energymon_get_precision_perf;
+  em->fexclusive = &energymon_is_exclusive_perf;
+  em->state = NULL;
+  return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * Read energy from Intel/AMD RAPL via the Linux perf_event "power" PMU.
+ *
+ * One perf event group is opened per package, so that a single read returns
+ * all configured domains for that package.
+ *
+ * By default, only the "pkg" domain is read. To configure other domains, set
+ * the ENERGYMON_PERF_DOMAINS environment variable with a comma-delimited list
+ * of domain names (with or without the "energy-" prefix), e.g.:
+ *   export ENERGYMON_PERF_DOMAINS=pkg,ram
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_PERF_H_
+#define _ENERGYMON_PERF_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "energymon.h"
+#include "energymon-topology.h"
+
+/* Environment variable for specifying the domains (perf events) to use */
+#define ENERGYMON_PERF_DOMAINS "ENERGYMON_PERF_DOMAINS"
+#define ENERGYMON_PERF_DOMAINS_DELIMS ", :;|"
+
+int energymon_init_perf(energymon* em);
+
+uint64_t energymon_read_total_perf(const energymon* em);
+
+int energymon_finish_perf(energymon* em);
+
+char* energymon_get_source_perf(char* buffer, size_t n);
+
+uint64_t energymon_get_interval_perf(const energymon* em);
+
+uint64_t energymon_get_precision_perf(const energymon* em);
+
+int energymon_is_exclusive_perf(void);
+
+int energymon_get_perf(energymon* em);
+
+/**
+ * Get the number of channels, i.e., (package, domain) pairs.
+ *
+ * @param em
+ *  an initialized energymon
+ * @return the channel count, or 0 on failure (errno is set)
+ */
+size_t energymon_get_channel_count_perf(const energymon* em);
+
+/**
+ * Get a human-readable name for a channel, e.g., "cpu-0:energy-pkg", where the
+ * CPU is the one used to read the package.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_perf)
+ * @param buffer
+ *  the destination buffer, which will be null-terminated
+ * @param n
+ *  the buffer size
+ * @return pointer to buffer, or NULL on failure (errno is set)
+ */
+char* energymon_get_channel_name_perf(const energymon* em, size_t channel, char* buffer, size_t n);
+
+/**
+ * Get the total energy and the per-channel energy in microjoules from a single read pass.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param energy_uj
+ *  array to store per-channel energy values, may be NULL if n is 0
+ * @param n
+ *  the array length - values are written for at most n channels
+ * @return total energy (in uJ), or 0 on failure (errno is set)
+ */
+uint64_t energymon_read_channels_perf(const energymon* em, uint64_t* energy_uj, size_t n);
+
+/**
+ * Get the topology of the CPUs covered by a channel.
+ * Package domains cover all CPUs in the package (and die), while "psys" covers all online CPUs.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_perf)
+ * @param topo
+ *  the topology to populate
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_get_channel_topology_perf(const energymon* em, size_t channel, energymon_topology* topo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
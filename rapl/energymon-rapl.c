@@ -16,6 +16,8 @@
 #include <unistd.h>
 #include "energymon.h"
 #include "energymon-rapl.h"
+#include "energymon-topology.h"
+#include "energymon-topology-util.h"
 #include "energymon-util.h"
 
 #ifdef ENERGYMON_DEFAULT
@@ -30,8 +32,13 @@ int energymon_get_default(energymon* em) {
 #define RAPL_MAX_ENERGY_FILE "max_energy_range_uj"
 #define RAPL_NAME_FILE "name"
 #define RAPL_PREFIX "intel-rapl:"
+#define RAPL_ZONE_NAME_MAX 32
+#define RAPL_ZONE_PSYS "psys"
 
 typedef struct rapl_zone {
+  // e.g., "package-0" or "package-0-die-1"
+  char name[RAPL_ZONE_NAME_MAX];
+  unsigned int zone;
   uint64_t max_energy_range_uj;
   uint64_t energy_last;
   unsigned int energy_overflow_count;
@@ -114,14 +121,15 @@ static inline uint64_t rapl_read_max_energy(unsigned int zone) {
   int err_save;
   char buf[96];
   char data[30];
+  ssize_t len;
   int fd;
   snprintf(buf, sizeof(buf), RAPL_BASE_DIR"/intel-rapl:%x/%s",
            zone, RAPL_MAX_ENERGY_FILE);
   errno = 0;
   fd = open(buf, O_RDONLY);
   if (fd > 0) {
-    if (pread(fd, data, sizeof(data), 0) > 0) {
-      ret = strtoull(data, NULL, 0);
+    if ((len = pread(fd, data, sizeof(data), 0)) > 0) {
+      energymon_strntou64(data, (size_t) len, &ret);
     }
     err_save = errno;
     if (close(fd)) {
@@ -147,8 +155,35 @@ static inline int rapl_cleanup(const energymon_rapl* state, int errno_orig) {
   return errno ? -1 : 0;
 }
 
+static inline int rapl_zone_read_name(rapl_zone* z) {
+  char buf[96];
+  ssize_t len;
+  int fd;
+  snprintf(buf, sizeof(buf), RAPL_BASE_DIR"/intel-rapl:%x/%s",
+           z->zone, RAPL_NAME_FILE);
+  if ((fd = open(buf, O_RDONLY)) < 0) {
+    perror(buf);
+    return -1;
+  }
+  len = pread(fd, z->name, sizeof(z->name) - 1, 0);
+  close(fd);
+  if (len < 0) {
+    perror(buf);
+    return -1;
+  }
+  while (len > 0 && z->name[len - 1] == '\n') {
+    len--;
+  }
+  z->name[len] = '\0';
+  return 0;
+}
+
 static inline int rapl_zone_init(rapl_zone* z, unsigned int zone) {
   char buf[96];
+  z->zone = zone;
+  if (rapl_zone_read_name(z)) {
+    return -1;
+  }
   snprintf(buf, sizeof(buf), RAPL_BASE_DIR"/intel-rapl:%x/%s",
            zone, RAPL_ENERGY_FILE);
   z->energy_fd = open(buf, O_RDONLY);
@@ -237,11 +272,12 @@ int energymon_init_rapl(energymon* em) {
 static inline uint64_t rapl_zone_read(rapl_zone* z) {
   uint64_t val = 0;
   char buf[30];
+  ssize_t len;
   errno = 0;
-  if (pread(z->energy_fd, buf, sizeof(buf), 0) > 0) {
-    val = strtoull(buf, NULL, 0);
+  if ((len = pread(z->energy_fd, buf, sizeof(buf), 0)) > 0) {
+    energymon_strntou64(buf, (size_t) len, &val);
   }
-  if (errno) { // from pread or strtoull
+  if (errno) { // from pread or energymon_strntou64
     return 0;
   }
   // attempt to detect overflow of counter
@@ -256,7 +292,7 @@ static inline uint64_t rapl_zone_read(rapl_zone* z) {
 /**
  * Returns 0 on error (check errno), otherwise the total energy across zones.
  */
-static inline uint64_t rapl_read_total_energy_uj(energymon_rapl* em) {
+static inline uint64_t rapl_read_total_energy_uj(energymon_rapl* em, uint64_t* energy_uj, size_t n) {
   uint64_t val = 0;
   uint64_t total = 0;
   unsigned int i;
@@ -265,18 +301,25 @@ static inline uint64_t rapl_read_total_energy_uj(energymon_rapl* em) {
     if (val == 0 && errno) {
       return 0;
     }
+    if (i < n) {
+      energy_uj[i] = val;
+    }
     total += val;
   }
   return total;
 }
 
-uint64_t energymon_read_total_rapl(const energymon* em) {
-  if (em == NULL || em->state == NULL) {
+uint64_t energymon_read_channels_rapl(const energymon* em, uint64_t* energy_uj, size_t n) {
+  if (em == NULL || em->state == NULL || (energy_uj == NULL && n > 0)) {
     errno = EINVAL;
     return 0;
   }
   errno = 0;
-  return rapl_read_total_energy_uj(em->state);
+  return rapl_read_total_energy_uj(em->state, energy_uj, n);
+}
+
+uint64_t energymon_read_total_rapl(const energymon* em) {
+  return energymon_read_channels_rapl(em, NULL, 0);
 }
 
 int energymon_finish_rapl(energymon* em) {
@@ -316,6 +359,47 @@ int energymon_is_exclusive_rapl(void) {
   return 0;
 }
 
+size_t energymon_get_channel_count_rapl(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  return ((energymon_rapl*) em->state)->count;
+}
+
+char* energymon_get_channel_name_rapl(const energymon* em, size_t channel, char* buffer, size_t n) {
+  if (em == NULL || em->state == NULL || buffer == NULL || n == 0 ||
+      channel >= ((energymon_rapl*) em->state)->count) {
+    errno = EINVAL;
+    return NULL;
+  }
+  const energymon_rapl* state = (energymon_rapl*) em->state;
+  snprintf(buffer, n, RAPL_PREFIX"%x:%s", state->zones[channel].zone, state->zones[channel].name);
+  return buffer;
+}
+
+int energymon_get_channel_topology_rapl(const energymon* em, size_t channel, energymon_topology* topo) {
+  if (em == NULL || em->state == NULL || topo == NULL ||
+      channel >= ((energymon_rapl*) em->state)->count) {
+    errno = EINVAL;
+    return -1;
+  }
+  const energymon_rapl* state = (energymon_rapl*) em->state;
+  int package_id;
+  int die_id = -1;
+  // the psys zone spans the platform, not a package
+  if (!strcmp(state->zones[channel].name, RAPL_ZONE_PSYS)) {
+    return energymon_topology_get_package(ENERGYMON_TOPOLOGY_SYSFS_ROOT, -1, -1, topo);
+  }
+  // "package-N" on single-die parts, "package-N-die-M" otherwise
+  if (sscanf(state->zones[channel].name, "package-%d-die-%d", &package_id, &die_id) < 1) {
+    fprintf(stderr, "energymon_get_channel_topology_rapl: Unexpected zone name: %s\n", state->zones[channel].name);
+    errno = ENODEV;
+    return -1;
+  }
+  return energymon_topology_get_package(ENERGYMON_TOPOLOGY_SYSFS_ROOT, package_id, die_id, topo);
+}
+
 int energymon_get_rapl(energymon* em) {
   if (em == NULL) {
     errno = EINVAL;
@@ -14,6 +14,7 @@ extern "C" {
 #include <inttypes.h>
 #include <stddef.h>
 #include "energymon.h"
+#include "energymon-topology.h"
 
 int energymon_init_rapl(energymon* em);
 
@@ -31,6 +32,57 @@ int energymon_is_exclusive_rapl(void);
 
 int energymon_get_rapl(energymon* em);
 
+/**
+ * Get the number of channels, i.e., package zones.
+ *
+ * @param em
+ *  an initialized energymon
+ * @return the channel count, or 0 on failure (errno is set)
+ */
+size_t energymon_get_channel_count_rapl(const energymon* em);
+
+/**
+ * Get a human-readable name for a channel, e.g., "intel-rapl:0:package-0".
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_rapl)
+ * @param buffer
+ *  the destination buffer, which will be null-terminated
+ * @param n
+ *  the buffer size
+ * @return pointer to buffer, or NULL on failure (errno is set)
+ */
+char* energymon_get_channel_name_rapl(const energymon* em, size_t channel, char* buffer, size_t n);
+
+/**
+ * Get the total energy and the per-channel energy in microjoules from a single read pass.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param energy_uj
+ *  array to store per-channel energy values, may be NULL if n is 0
+ * @param n
+ *  the array length - values are written for at most n channels
+ * @return total energy (in uJ), or 0 on failure (errno is set)
+ */
+uint64_t energymon_read_channels_rapl(const energymon* em, uint64_t* energy_uj, size_t n);
+
+/**
+ * Get the topology of the CPUs covered by a channel, derived from the zone's package (and die) name.
+ * The "psys" zone covers all online CPUs, and isn't package-scoped.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_rapl)
+ * @param topo
+ *  the topology to populate
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_get_channel_topology_rapl(const energymon* em, size_t channel, energymon_topology* topo);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,35 +22,96 @@ int energymon_get_default(energymon* em) {
 }
 #endif
 
+typedef struct raplcap_msr_zone_name {
+  const char* name;
+  raplcap_zone zone;
+} raplcap_msr_zone_name;
+
+static const raplcap_msr_zone_name RAPLCAP_MSR_ZONE_NAMES[] = {
+  { "PACKAGE", RAPLCAP_ZONE_PACKAGE },
+  { "CORE", RAPLCAP_ZONE_CORE },
+  { "UNCORE", RAPLCAP_ZONE_UNCORE },
+  { "DRAM", RAPLCAP_ZONE_DRAM },
+  { "PSYS", RAPLCAP_ZONE_PSYS },
+  { "PLATFORM", RAPLCAP_ZONE_PSYS },
+};
+#define RAPLCAP_MSR_ZONE_NAMES_LEN (sizeof(RAPLCAP_MSR_ZONE_NAMES) / sizeof(RAPLCAP_MSR_ZONE_NAMES[0]))
+// the number of distinct zones
+#define RAPLCAP_MSR_ZONES_MAX 5
+
+typedef struct raplcap_msr_zone_info {
+  // exact running total of raw counts, accumulated from the 32-bit counter
+  uint64_t raw_total;
+  uint32_t raw_last;
+  // Joules per raw count
+  double units;
+  // converts raw counts to uJ
+  energymon_fixed_mul to_uj;
+} raplcap_msr_zone_info;
+
 typedef struct raplcap_msr_info {
-  double j_last;
-  double j_max;
-  uint32_t n_overflow;
+  // indexed the same as the state's zones
+  raplcap_msr_zone_info zones[RAPLCAP_MSR_ZONES_MAX];
   int is_active;
 } raplcap_msr_info;
 
 typedef struct energymon_raplcap_msr {
   raplcap rc;
-  raplcap_zone zone;
+  raplcap_zone zones[RAPLCAP_MSR_ZONES_MAX];
+  uint32_t n_zones;
+  uint32_t n_active;
   uint32_t n_pkg;
-  uint32_t n_die;
   uint32_t n_msrs;
+  // prefix sums of die counts: package pkg's instances are in range [pkg_first[pkg], pkg_first[pkg + 1])
+  uint32_t* pkg_first;
   raplcap_msr_info msrs[];
 } energymon_raplcap_msr;
 
-static int get_raplcap_zone(raplcap_zone* zone, const char* env_zone) {
-  if (env_zone == NULL || !strcmp(env_zone, "PACKAGE")) {
-    *zone = RAPLCAP_ZONE_PACKAGE;
-  } else if (!strcmp(env_zone, "CORE")) {
-    *zone = RAPLCAP_ZONE_CORE;
-  } else if (!strcmp(env_zone, "UNCORE")) {
-    *zone = RAPLCAP_ZONE_UNCORE;
-  } else if (!strcmp(env_zone, "DRAM")) {
-    *zone = RAPLCAP_ZONE_DRAM;
-  } else if (!strcmp(env_zone, "PSYS") || !strcmp(env_zone, "PLATFORM")) {
-    *zone = RAPLCAP_ZONE_PSYS;
-  } else {
-    fprintf(stderr, "energymon_init_raplcap_msr: Unknown zone: '%s'\n", env_zone);
+static const char* get_raplcap_zone_name(raplcap_zone zone) {
+  size_t i;
+  for (i = 0; i < RAPLCAP_MSR_ZONE_NAMES_LEN && RAPLCAP_MSR_ZONE_NAMES[i].zone != zone; i++);
+  return i < RAPLCAP_MSR_ZONE_NAMES_LEN ? RAPLCAP_MSR_ZONE_NAMES[i].name : "UNKNOWN";
+}
+
+/**
+ * Parse a comma-delimited list of zones.
+ * Zones are always ordered the same way, regardless of the order or repetition in the list.
+ */
+static int get_raplcap_zones(energymon_raplcap_msr* state, const char* env_zone) {
+  int requested[RAPLCAP_MSR_ZONES_MAX] = { 0 };
+  char* tmp;
+  char* tok;
+  char* saveptr;
+  size_t i;
+  if (env_zone == NULL) {
+    state->zones[0] = RAPLCAP_ZONE_PACKAGE;
+    state->n_zones = 1;
+    return 0;
+  }
+  if ((tmp = strdup(env_zone)) == NULL) {
+    perror("energymon_init_raplcap_msr: strdup");
+    return -1;
+  }
+  tok = strtok_r(tmp, ",", &saveptr);
+  while (tok != NULL) {
+    for (i = 0; i < RAPLCAP_MSR_ZONE_NAMES_LEN && strcmp(tok, RAPLCAP_MSR_ZONE_NAMES[i].name); i++);
+    if (i == RAPLCAP_MSR_ZONE_NAMES_LEN) {
+      fprintf(stderr, "energymon_init_raplcap_msr: Unknown zone: '%s'\n", tok);
+      free(tmp);
+      errno = EINVAL;
+      return -1;
+    }
+    requested[RAPLCAP_MSR_ZONE_NAMES[i].zone] = 1;
+    tok = strtok_r(NULL, ",", &saveptr);
+  }
+  free(tmp);
+  for (state->n_zones = 0, i = 0; i < RAPLCAP_MSR_ZONES_MAX; i++) {
+    if (requested[i]) {
+      state->zones[state->n_zones++] = (raplcap_zone) i;
+    }
+  }
+  if (state->n_zones == 0) {
+    fprintf(stderr, "energymon_init_raplcap_msr: No zones in env var: "ENERGYMON_RAPLCAP_MSR_ZONE"=%s\n", env_zone);
     errno = EINVAL;
     return -1;
   }
@@ -105,82 +166,84 @@ int energymon_init_raplcap_msr(energymon* em) {
     return -1;
   }
 
+  raplcap_msr_zone_info* zi;
   int err_save;
   int supp;
   uint32_t i;
+  uint32_t z;
   uint32_t n_pkg;
   uint32_t n_die;
   uint32_t n_msrs;
-  uint32_t max_die;
   uint32_t pkg;
   uint32_t die;
   if ((n_pkg = raplcap_get_num_packages(NULL)) == 0) {
     perror("raplcap_get_num_packages");
     return -1;
   }
-  // currently only support systems with homogeneous package/die configurations
-  for (pkg = 0; pkg < n_pkg; pkg++) {
+  // packages may have different numbers of die, so index instances with prefix sums
+  uint32_t* pkg_first = malloc((n_pkg + 1) * sizeof(uint32_t));
+  if (pkg_first == NULL) {
+    return -1;
+  }
+  for (pkg_first[0] = 0, pkg = 0; pkg < n_pkg; pkg++) {
     if ((n_die = raplcap_get_num_die(NULL, pkg)) == 0) {
       perror("raplcap_get_num_die");
+      free(pkg_first);
       return -1;
     }
-    if (pkg == 0) {
-      max_die = n_die;
-    } else if (max_die != n_die) {
-      fprintf(stderr, "energymon_init_raplcap_msr: no support for heterogeneous package/die\n");
-      errno = ENOSYS;
-      return -1;
-    }
+    pkg_first[pkg + 1] = pkg_first[pkg] + n_die;
   }
-  n_msrs = n_pkg * n_die;
+  n_msrs = pkg_first[n_pkg];
 
   energymon_raplcap_msr* state = calloc(1, sizeof(energymon_raplcap_msr) + (n_msrs * sizeof(raplcap_msr_info)));
   if (state == NULL) {
+    free(pkg_first);
     return -1;
   }
   state->n_msrs = n_msrs;
   state->n_pkg = n_pkg;
-  state->n_die = n_die;
-
-  if (get_active_instances(state->msrs, state->n_msrs)) {
-    free(state);
-    return -1;
-  }
+  state->pkg_first = pkg_first;
 
-  const char* env_zone = getenv(ENERGYMON_RAPLCAP_MSR_ZONE);
-  if (get_raplcap_zone(&state->zone, env_zone)) {
+  if (get_active_instances(state->msrs, state->n_msrs) ||
+      get_raplcap_zones(state, getenv(ENERGYMON_RAPLCAP_MSR_ZONE))) {
+    free(state->pkg_first);
     free(state);
     return -1;
   }
 
   if (raplcap_init(&state->rc)) {
     perror("raplcap_init");
+    free(state->pkg_first);
     free(state);
     return -1;
   }
 
   for (pkg = 0; pkg < state->n_pkg; pkg++) {
-    for (die = 0; die < state->n_die; die++) {
-      i = pkg * die + die;
+    for (i = state->pkg_first[pkg], die = 0; i < state->pkg_first[pkg + 1]; i++, die++) {
       if (!state->msrs[i].is_active) {
         continue;
       }
-      // first check if zone is supported
-      supp = raplcap_pd_is_zone_supported(&state->rc, pkg, die, state->zone);
-      if (supp < 0) {
-        perror("raplcap_pd_is_zone_supported");
-        goto fail;
-      }
-      if (supp == 0) {
-        fprintf(stderr, "energymon_init_raplcap_msr: Unsupported zone: %s\n", env_zone == NULL ? "PACKAGE" : env_zone);
-        errno = EINVAL;
-        goto fail;
-      }
-      // Note: max energy is specified in a different MSR than the zone's energy counter,
-      // so this call might still work for unsupported zones (which is why we have to check for support first)
-      if ((state->msrs[i].j_max = raplcap_pd_get_energy_counter_max(&state->rc, pkg, die, state->zone)) < 0) {
-        perror("raplcap_pd_get_energy_counter_max");
-        goto fail;
+      state->n_active++;
+      for (z = 0; z < state->n_zones; z++) {
+        // first check if zone is supported
+        supp = raplcap_pd_is_zone_supported(&state->rc, pkg, die, state->zones[z]);
+        if (supp < 0) {
+          perror("raplcap_pd_is_zone_supported");
+          goto fail;
+        }
+        if (supp == 0) {
+          fprintf(stderr, "energymon_init_raplcap_msr: Unsupported zone: %s\n", get_raplcap_zone_name(state->zones[z]));
+          errno = EINVAL;
+          goto fail;
+        }
+        // Note: energy units are specified in a different MSR than the zone's energy counter,
+        // so this call might still work for unsupported zones (which is why we have to check for support first)
+        zi = &state->msrs[i].zones[z];
+        if ((zi->units = raplcap_msr_pd_get_energy_units(&state->rc, pkg, die, state->zones[z])) <= 0 ||
+            energymon_fixed_mul_init(&zi->to_uj, zi->units * 1000000.0)) {
+          perror("raplcap_msr_pd_get_energy_units");
+          goto fail;
+        }
       }
     }
   }
@@ -193,40 +256,56 @@ fail:
   if (raplcap_destroy(&state->rc)) {
     perror("raplcap_destroy");
   }
+  free(state->pkg_first);
   free(state);
   errno = err_save;
   return -1;
 }
 
-uint64_t energymon_read_total_raplcap_msr(const energymon* em) {
-  if (em == NULL || em->state == NULL) {
+uint64_t energymon_read_channels_raplcap_msr(const energymon* em, uint64_t* energy_uj, size_t n) {
+  if (em == NULL || em->state == NULL || (energy_uj == NULL && n > 0)) {
     errno = EINVAL;
     return 0;
   }
+  raplcap_msr_zone_info* zi;
   uint32_t pkg;
   uint32_t die;
   uint32_t i;
+  uint32_t z;
+  uint32_t raw;
+  size_t ch = 0;
   double j;
+  uint64_t uj;
   uint64_t total = 0;
   energymon_raplcap_msr* state = (energymon_raplcap_msr*) em->state;
   for (errno = 0, pkg = 0; pkg < state->n_pkg && !errno; pkg++) {
-    for (die = 0; die < state->n_die && !errno; die++) {
-      i = pkg * die + die;
+    for (i = state->pkg_first[pkg], die = 0; i < state->pkg_first[pkg + 1] && !errno; i++, die++) {
       if (!state->msrs[i].is_active) {
         continue;
       }
-      if ((j = raplcap_pd_get_energy_counter(&state->rc, pkg, die, state->zone)) >= 0) {
-        if (j < state->msrs[i].j_last) {
-          state->msrs[i].n_overflow++;
+      // all of an instance's zones are read back-to-back through the same raplcap context
+      for (z = 0; z < state->n_zones && !errno; z++, ch++) {
+        if ((j = raplcap_pd_get_energy_counter(&state->rc, pkg, die, state->zones[z])) >= 0) {
+          zi = &state->msrs[i].zones[z];
+          // recover the raw 32-bit counter value - units are a power of 2, so the division is exact
+          raw = (uint32_t) (uint64_t) (j / zi->units + 0.5);
+          energymon_accumulate_u32(&zi->raw_total, &zi->raw_last, raw);
+          uj = energymon_fixed_mul_apply(zi->raw_total, &zi->to_uj);
+          if (ch < n) {
+            energy_uj[ch] = uj;
+          }
+          total += uj;
         }
-        state->msrs[i].j_last = j;
-        total += (uint64_t) ((j + state->msrs[i].n_overflow * state->msrs[i].j_max) * 1000000.0);
       }
     }
   }
   return errno ? 0 : total;
 }
 
+uint64_t energymon_read_total_raplcap_msr(const energymon* em) {
+  return energymon_read_channels_raplcap_msr(em, NULL, 0);
+}
+
 int energymon_finish_raplcap_msr(energymon* em) {
   if (em == NULL || em->state == NULL) {
     errno = EINVAL;
@@ -237,6 +316,7 @@ int energymon_finish_raplcap_msr(energymon* em) {
   if ((ret = raplcap_destroy(&state->rc))) {
     perror("raplcap_destroy");
   }
+  free(state->pkg_first);
   free(em->state);
   em->state = NULL;
   return ret;
@@ -261,28 +341,61 @@ uint64_t energymon_get_precision_raplcap_msr(const energymon* em) {
     return 0;
   }
   energymon_raplcap_msr* state = em->state;
-  double j;
   double max = 0;
+  uint32_t i;
+  uint32_t z;
+  for (i = 0; i < state->n_msrs; i++) {
+    if (!state->msrs[i].is_active) {
+      continue;
+    }
+    for (z = 0; z < state->n_zones; z++) {
+      // precision limited by the largest units (DRAM units may differ from the other zones)
+      if (state->msrs[i].zones[z].units > max) {
+        max = state->msrs[i].zones[z].units;
+      }
+    }
+  }
+  return (uint64_t) (max * 1000000);
+}
+
+int energymon_is_exclusive_raplcap_msr(void) {
+  return 0;
+}
+
+size_t energymon_get_channel_count_raplcap_msr(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  const energymon_raplcap_msr* state = (energymon_raplcap_msr*) em->state;
+  return (size_t) state->n_active * state->n_zones;
+}
+
+char* energymon_get_channel_name_raplcap_msr(const energymon* em, size_t channel, char* buffer, size_t n) {
+  if (em == NULL || em->state == NULL || buffer == NULL || n == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  const energymon_raplcap_msr* state = (energymon_raplcap_msr*) em->state;
+  size_t ch = 0;
   uint32_t pkg;
   uint32_t die;
   uint32_t i;
   for (pkg = 0; pkg < state->n_pkg; pkg++) {
-    for (die = 0; die < state->n_die; die++) {
-      i = pkg * die + die;
+    for (i = state->pkg_first[pkg], die = 0; i < state->pkg_first[pkg + 1]; i++, die++) {
       if (!state->msrs[i].is_active) {
         continue;
       }
-      // precision limited by the largest units (they should all be the same though)
-      if ((j = raplcap_msr_pd_get_energy_units(&state->rc, pkg, die, state->zone)) > max) {
-        max = j;
+      if (channel < ch + state->n_zones) {
+        snprintf(buffer, n, "package-%"PRIu32"-die-%"PRIu32":%s", pkg, die,
+                 get_raplcap_zone_name(state->zones[channel - ch]));
+        return buffer;
       }
+      ch += state->n_zones;
     }
   }
-  return (uint64_t) (max * 1000000);
-}
-
-int energymon_is_exclusive_raplcap_msr(void) {
-  return 0;
+  errno = EINVAL;
+  return NULL;
 }
 
 int energymon_get_raplcap_msr(energymon* em) {
@@ -1,17 +1,22 @@
 /**
  * Read energy from Intel RAPL using the raplcap-msr library.
  *
- * To specify which RAPL zone to use, set the environment variable ENERGYMON_RAPLCAP_MSR_ZONE to one of:
+ * To specify which RAPL zones to use, set the environment variable ENERGYMON_RAPLCAP_MSR_ZONE to a comma-delimited
+ * list of:
  *   "PACKAGE" (default)
  *   "CORE"
  *   "UNCORE"
  *   "DRAM"
  *   "PSYS" or "PLATFORM"
+ * e.g., to read package and DRAM energy in the same pass:
+ *   export ENERGYMON_RAPLCAP_MSR_ZONE=PACKAGE,DRAM
  *
  * By default, all RAPL instances are read. To configure for only specific instances, set the
  * ENERGYMON_RAPLCAP_MSR_INSTANCES environment variable with a comma-delimited list of IDs, e.g., on a quad-socket
  * system, to use only instances (sockets) 0 and 2 (and ignore 1 and 3):
  *   export ENERGYMON_RAPLCAP_MSR_INSTANCES=0,2
+ * Instance IDs are ordered by package, then by die, and packages may have different numbers of die, e.g., with one
+ * die in package 0 and two die in package 1, instance 1 is package 1 die 0, and instance 2 is package 1 die 1.
  *
  * @author Connor Imes
  * @date 2018-05-19
@@ -27,7 +32,7 @@ extern "C" {
 #include <stddef.h>
 #include "energymon.h"
 
-/* Environment variable for specifying the zone to use */
+/* Environment variable for specifying the zones to use */
 #define ENERGYMON_RAPLCAP_MSR_ZONE "ENERGYMON_RAPLCAP_MSR_ZONE"
 /* Environment variable for specifying the RAPL instances (e.g., sockets) to use */
 #define ENERGYMON_RAPLCAP_MSR_INSTANCES "ENERGYMON_RAPLCAP_MSR_INSTANCES"
@@ -48,6 +53,44 @@ int energymon_is_exclusive_raplcap_msr(void);
 
 int energymon_get_raplcap_msr(energymon* em);
 
+/**
+ * Get the number of channels, one for each zone of each active RAPL instance.
+ *
+ * @param em
+ *  an initialized energymon
+ * @return the channel count, or 0 on failure (errno is set)
+ */
+size_t energymon_get_channel_count_raplcap_msr(const energymon* em);
+
+/**
+ * Get a human-readable name for a channel, e.g., "package-0-die-0:DRAM".
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_raplcap_msr)
+ * @param buffer
+ *  the destination buffer, which will be null-terminated
+ * @param n
+ *  the buffer size
+ * @return pointer to buffer, or NULL on failure (errno is set)
+ */
+char* energymon_get_channel_name_raplcap_msr(const energymon* em, size_t channel, char* buffer, size_t n);
+
+/**
+ * Get the total energy and the per-channel energy in microjoules from a single read pass.
+ * Channels are ordered by instance, then by zone.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param energy_uj
+ *  array to store per-channel energy values, may be NULL if n is 0
+ * @param n
+ *  the array length - values are written for at most n channels
+ * @return total energy (in uJ), or 0 on failure (errno is set)
+ */
+uint64_t energymon_read_channels_raplcap_msr(const energymon* em, uint64_t* energy_uj, size_t n);
+
 #ifdef __cplusplus
 }
 #endif
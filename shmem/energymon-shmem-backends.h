@@ -0,0 +1,39 @@
+/**
+ * Table of energymon implementations hosted by a shared memory provider, defined at compile time.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_SHMEM_BACKENDS_H_
+#define _ENERGYMON_SHMEM_BACKENDS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "energymon.h"
+
+#pragma GCC visibility push(hidden)
+
+typedef struct energymon_shmem_backend {
+  // the implementation's short name, e.g., "rapl"
+  const char* name;
+  int (*get)(energymon* em);
+  // the channel functions are NULL if the implementation doesn't expose channels
+  size_t (*get_channel_count)(const energymon* em);
+  char* (*get_channel_name)(const energymon* em, size_t channel, char* buffer, size_t n);
+  uint64_t (*read_channels)(const energymon* em, uint64_t* energy_uj, size_t n);
+} energymon_shmem_backend;
+
+extern const energymon_shmem_backend energymon_shmem_backends[];
+extern const size_t energymon_shmem_backends_len;
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
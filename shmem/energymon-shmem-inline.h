@@ -0,0 +1,194 @@
+/**
+ * Inline fast path for reading energy from shared memory.
+ *
+ * An energymon_shmem_view points directly at the data of the channel used by an initialized shmem energymon, so
+ * reads compile down to a few loads instead of calls through the energymon function pointers.
+ * Views are only valid until the energymon is finished.
+ * Views don't follow the consumer to a restarted provider: they keep returning the old provider's last value, so get a
+ * new view when energymon_get_generation_shmem changes.
+ * Like the consumer, a new view's energy continues from where the old provider left off.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_SHMEM_INLINE_H_
+#define _ENERGYMON_SHMEM_INLINE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+#include <inttypes.h>
+#include <sched.h>
+#include "energymon.h"
+#include "energymon-shmem.h"
+
+typedef struct energymon_shmem_view {
+  // the sequence lock protecting the data, or NULL for v1 shared memory
+  const uint32_t* seq;
+  const uint64_t* energy_uj;
+  // NULL for v1 shared memory
+  const uint64_t* update_time_ns;
+  // the power over the provider's last update interval and its sequence lock, or NULL if the provider doesn't
+  // publish power (see ENERGYMON_SHMEM_FLAG_POWER)
+  const uint32_t* power_seq;
+  const uint64_t* power_uw;
+  // added to energy_uj so that it never decreases across provider restarts, as for energymon_read_total_shmem
+  uint64_t offset_uj;
+} energymon_shmem_view;
+
+/*
+ * 64-bit atomic loads need libatomic where they aren't lock-free (e.g., ARM before ARMv7), so load 32-bit halves there
+ * instead - the sequence lock catches torn values.
+ */
+#if !defined(__GCC_ATOMIC_LLONG_LOCK_FREE) || __GCC_ATOMIC_LLONG_LOCK_FREE != 2
+typedef uint32_t __attribute__((may_alias)) energymon_shmem_view_u32;
+#endif
+
+static inline uint64_t energymon_shmem_view_load(const uint64_t* p) {
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+  const energymon_shmem_view_u32* h = (const energymon_shmem_view_u32*) (const void*) p;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return (uint64_t) __atomic_load_n(&h[0], __ATOMIC_RELAXED) << 32 | __atomic_load_n(&h[1], __ATOMIC_RELAXED);
+#else
+  return (uint64_t) __atomic_load_n(&h[1], __ATOMIC_RELAXED) << 32 | __atomic_load_n(&h[0], __ATOMIC_RELAXED);
+#endif
+#endif
+}
+
+/**
+ * Load v1 energy, which has no sequence lock, until two loads agree so that a torn value isn't returned.
+ */
+static inline uint64_t energymon_shmem_view_load_v1(const uint64_t* p) {
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+  uint64_t val = energymon_shmem_view_load(p);
+  uint64_t prev;
+  do {
+    prev = val;
+    val = energymon_shmem_view_load(p);
+  } while (val != prev);
+  return val;
+#endif
+}
+
+// how many times view reads check for an update to finish before giving up - the provider only holds the sequence
+// lock for nanoseconds, so this is only reached if it was descheduled for a long time or died during an update
+#define ENERGYMON_SHMEM_VIEW_SPIN_MAX (1 << 20)
+
+/**
+ * Begin a read of data protected by a sequence lock (see energymon-shmem.h), giving up if an update doesn't finish.
+ *
+ * @return 0 on success, -1 if an update is still in progress (errno is set to EAGAIN)
+ */
+static inline int energymon_shmem_view_begin(const uint32_t* seqp, uint32_t* seq) {
+  uint32_t spins;
+  for (spins = 0; (*seq = __atomic_load_n(seqp, __ATOMIC_ACQUIRE)) & 1; spins++) {
+    if (spins == ENERGYMON_SHMEM_VIEW_SPIN_MAX) {
+      errno = EAGAIN;
+      return -1;
+    }
+    if ((spins & 1023) == 1023) {
+      sched_yield();
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+  return 0;
+}
+
+/**
+ * Get a view of the channel used by the energymon interface (see ENERGYMON_SHMEM_CHANNEL).
+ *
+ * @param em
+ *  an initialized energymon
+ * @param view
+ *  the view to initialize
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_get_view_shmem(const energymon* em, energymon_shmem_view* view);
+
+/**
+ * Get the energy in microjoules - equivalent to energymon_read_total_shmem until the provider restarts.
+ * Energy may be 0 before the provider's first update, so clear errno first to tell that apart from a failure.
+ *
+ * @param view
+ *  a view from energymon_get_view_shmem
+ * @return the energy in microjoules, or 0 on failure (errno is set to EAGAIN if the provider didn't finish an update
+ *  in time, e.g., because it died during one - energymon_read_total_shmem follows its successor)
+ */
+static inline uint64_t energymon_read_view_shmem(const energymon_shmem_view* view) {
+  uint64_t energy_uj;
+  uint32_t seq;
+  if (view->seq == NULL) {
+    return energymon_shmem_view_load_v1(view->energy_uj) + view->offset_uj;
+  }
+  // see the sequence lock protocol in energymon-shmem.h
+  do {
+    if (energymon_shmem_view_begin(view->seq, &seq)) {
+      return 0;
+    }
+    energy_uj = energymon_shmem_view_load(view->energy_uj);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(view->seq, __ATOMIC_RELAXED) != seq);
+  return energy_uj + view->offset_uj;
+}
+
+/**
+ * Get the energy in microjoules and the time of the provider's last update, consistent with each other.
+ *
+ * @param view
+ *  a view from energymon_get_view_shmem
+ * @param update_time_ns
+ *  the provider's CLOCK_MONOTONIC time in nanoseconds of the last update (0 for v1 shared memory or on failure)
+ * @return the energy in microjoules, or 0 on failure (errno is set, as for energymon_read_view_shmem)
+ */
+static inline uint64_t energymon_read_view_time_shmem(const energymon_shmem_view* view, uint64_t* update_time_ns) {
+  uint64_t energy_uj;
+  uint32_t seq;
+  if (view->seq == NULL) {
+    *update_time_ns = 0;
+    return energymon_shmem_view_load_v1(view->energy_uj) + view->offset_uj;
+  }
+  do {
+    if (energymon_shmem_view_begin(view->seq, &seq)) {
+      *update_time_ns = 0;
+      return 0;
+    }
+    energy_uj = energymon_shmem_view_load(view->energy_uj);
+    *update_time_ns = energymon_shmem_view_load(view->update_time_ns);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(view->seq, __ATOMIC_RELAXED) != seq);
+  return energy_uj + view->offset_uj;
+}
+
+/**
+ * Get the power in microwatts over the provider's last update interval, as computed by the provider.
+ *
+ * @param view
+ *  a view from energymon_get_view_shmem, whose power_uw must not be NULL
+ * @return the power in microwatts, or 0 on failure (errno is set, as for energymon_read_view_shmem)
+ */
+static inline uint64_t energymon_read_view_power_shmem(const energymon_shmem_view* view) {
+  uint64_t power_uw;
+  uint32_t seq;
+  do {
+    if (energymon_shmem_view_begin(view->power_seq, &seq)) {
+      return 0;
+    }
+    power_uw = energymon_shmem_view_load(view->power_uw);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(view->power_seq, __ATOMIC_RELAXED) != seq);
+  return power_uw;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
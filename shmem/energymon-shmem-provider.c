@@ -6,35 +6,127 @@
  */
 #define _GNU_SOURCE
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <math.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
+#include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <time.h>
+#include <unistd.h>
 #include "energymon.h"
-#include "energymon-get.h"
+#include "energymon-futex.h"
+#include "energymon-seqlock.h"
 #include "energymon-shmem.h"
+#include "energymon-shmem-backends.h"
+#include "energymon-time-util.h"
+#include "energymon-util.h"
 
 #ifndef ENERGYMON_UTIL_PREFIX
 #error Must set ENERGYMON_UTIL_PREFIX
 #endif
 
+// the previous update and running power statistics of a channel
+typedef struct channel_stats {
+  uint64_t last_uj;
+  uint64_t last_ns;
+  int updated;
+  int has_power;
+  uint64_t min_power_uw;
+  uint64_t max_power_uw;
+  double ewma_power_uw[ENERGYMON_SHMEM_EWMA_MAX];
+} channel_stats;
+
+typedef struct shmem_source {
+  const energymon_shmem_backend* backend;
+  energymon em;
+  int initialized;
+  // 0 until initialized, unless overridden on the command line
+  uint64_t interval_us;
+  uint64_t next_ns;
+  // polls skipped because the previous one ran a full interval or more late
+  uint64_t missed;
+  // the source's total, followed by its implementation's channels (if any)
+  energymon_shmem_channel* channels;
+  // each channel's sample ring, if enabled
+  energymon_shmem_ring_slot* rings;
+  size_t n_channels;
+  uint64_t* channel_uj;
+  // added to each channel's energy to continue from a previous provider's totals
+  uint64_t* offset_uj;
+  channel_stats* stats;
+} shmem_source;
+
+// a channel's total from a previous provider
+typedef struct saved_channel {
+  char name[ENERGYMON_SHMEM_CHANNEL_NAME_LEN];
+  uint64_t energy_uj;
+} saved_channel;
+
 static volatile int running = 1;
-static energymon_shmem* ems;
+static energymon_shmem_v2* ems;
+static shmem_source* sources = NULL;
+static size_t n_sources = 0;
+static size_t shm_size = 0;
+static size_t shm_n_channels = 0;
+static uint32_t ring_len = 0;
 static const char* key_dir = NULL;
 static int key_proj_id = -1;
-static int shm_id;
+static int shm_id = -1;
+// POSIX transports
+static const char* shm_name = NULL;
+static const char* socket_path = NULL;
+static size_t map_len = 0;
+static int mem_fd = -1;
+static int listen_fd = -1;
+// consumers connected to the socket, which hold the connection open while attached
+static int* clients = NULL;
+static size_t n_clients = 0;
+// poll interval when no consumers are attached, or 0 to always use the implementations' intervals
+static uint64_t idle_interval_us = 0;
+// whether any consumers are attached - futex waiters are only woken if so
+static int attached = 1;
+// continuity with previous providers
+static const char* state_path = NULL;
+static uint32_t generation = 1;
+static saved_channel* saved = NULL;
+static size_t n_saved = 0;
+// time constants of the EWMA power published for each channel
+static uint64_t ewma_window_us[ENERGYMON_SHMEM_EWMA_MAX];
+static size_t n_ewma = 0;
+
+#define RING_LEN_MAX (1 << 20)
+#define STATE_SAVE_INTERVAL_NS 10000000000ULL
+#define EWMA_WINDOW_US_DEFAULT 1000000
+// RAPL's 32-bit energy counters can wrap in about a minute at high power, and implementations only catch a wrap if
+// they're read at least once in between
+#define IDLE_INTERVAL_MAX_US 10000000
+// how often to check if all consumers have detached
+#define DETACH_CHECK_INTERVAL_NS 1000000000ULL
 
-static const char short_options[] = "hd:i:";
+static const char short_options[] = "hb:lI:S:e:d:i:n:r:s:";
 static const struct option long_options[] = {
   {"help",      no_argument,       NULL, 'h'},
+  {"backend",   required_argument, NULL, 'b'},
+  {"list",      no_argument,       NULL, 'l'},
+  {"idle-interval", required_argument, NULL, 'I'},
+  {"state",     required_argument, NULL, 'S'},
+  {"ewma",      required_argument, NULL, 'e'},
   {"dir",       required_argument, NULL, 'd'},
   {"id",        required_argument, NULL, 'i'},
+  {"name",      required_argument, NULL, 'n'},
+  {"ring",      required_argument, NULL, 'r'},
+  {"socket",    required_argument, NULL, 's'},
   {0, 0, 0, 0}
 };
 
@@ -44,18 +136,50 @@ static void print_usage(int exit_code) {
           "Usage: "ENERGYMON_UTIL_PREFIX"-shmem-provider [OPTION]...\n\n"
           "Provide EnergyMon readings over shared memory, e.g., for use by\n"
           "libenergymon-shmem.\n\n"
-          "Both the provider and the consumer must agree on the path and id used to create\n"
-          "the IPC shared memory key, as required by ftok(3).\n\n"
+          "By default, System V shared memory is used. Both the provider and the consumer\n"
+          "must agree on the path and id used to create the IPC shared memory key, as\n"
+          "required by ftok(3).\n\n"
           "If the consumer is libenergymon-shmem, the shared memory provider must be\n"
           "running before the energymon context is initialized. To specify path and id\n"
           "values for libenergymon-shmem, set the ENERGYMON_SHMEM_DIR and\n"
-          "ENERGYMON_SHMEM_ID environment variables, respectively.\n\n"
+          "ENERGYMON_SHMEM_ID environment variables, respectively. To use the POSIX\n"
+          "transports instead, set ENERGYMON_SHMEM_NAME or ENERGYMON_SHMEM_SOCKET to the\n"
+          "same NAME or PATH given to the provider.\n\n"
+          "Each backend's total energy, and each of its channels if it has any, is\n"
+          "published as a channel in the shared memory. The first backend is also used\n"
+          "for the energymon interface, unless the consumer sets ENERGYMON_SHMEM_CHANNEL.\n"
+          "Each channel also has its power over the last interval, moving averages, and\n"
+          "minimum and maximum, so consumers don't need to compute power themselves.\n\n"
+          "Consumers attach to a restarted provider automatically, and energy values\n"
+          "continue from the previous provider's totals.\n\n"
           "Options:\n"
           "  -h, --help               Print this message and exit\n"
+          "  -b, --backend=NAME[:US]  Host the named EnergyMon implementation, optionally\n"
+          "                           with a polling interval in microseconds (default\n"
+          "                           = the implementation's interval)\n"
+          "                           May be repeated; required if more than one is built\n"
+          "  -l, --list               Print the available backends and exit\n"
+          "  -I, --idle-interval=US   Poll every US microseconds while no consumers are\n"
+          "                           attached, at most %d to catch energy counter\n"
+          "                           overflows (not supported with --name)\n"
+          "  -S, --state=PATH         Save the provider's totals to PATH periodically and\n"
+          "                           on exit, and continue from them when restarted\n"
+          "  -e, --ewma=US            Publish an exponentially weighted moving average of\n"
+          "                           each channel's power with a US microsecond time\n"
+          "                           constant (default = %d)\n"
+          "                           May be repeated, at most %d times\n"
           "  -d, --dir=PATH           The shared memory path (default = \"%s\")\n"
           "  -i, --id=ID              The shared memory identifier (default = %d)\n"
-          "                           ID must be in range [1, 255]\n",
-          ENERGYMON_SHMEM_DIR_DEFAULT, ENERGYMON_SHMEM_ID_DEFAULT);
+          "                           ID must be in range [1, 255]\n"
+          "  -n, --name=NAME          Use a POSIX shared memory object, e.g., \"/energymon\",\n"
+          "                           instead of System V shared memory\n"
+          "  -r, --ring=N             Publish a ring of the last N samples for each channel\n"
+          "                           N is rounded up to a power of 2, at most %d\n"
+          "  -s, --socket=PATH        Share an anonymous memory file with consumers that\n"
+          "                           connect to a Unix domain socket at PATH, instead of\n"
+          "                           using System V shared memory\n",
+          IDLE_INTERVAL_MAX_US, EWMA_WINDOW_US_DEFAULT, ENERGYMON_SHMEM_EWMA_MAX,
+          ENERGYMON_SHMEM_DIR_DEFAULT, ENERGYMON_SHMEM_ID_DEFAULT, RING_LEN_MAX);
   exit(exit_code);
 }
 
@@ -65,6 +189,70 @@ static void enforce_key_proj_id(void) {
   }
 }
 
+static void print_backends(void) {
+  size_t i;
+  for (i = 0; i < energymon_shmem_backends_len; i++) {
+    printf("%s\n", energymon_shmem_backends[i].name);
+  }
+  exit(0);
+}
+
+static void add_source(const char* arg) {
+  const char* interval = strchr(arg, ':');
+  size_t len = interval == NULL ? strlen(arg) : (size_t) (interval - arg);
+  size_t i;
+  size_t j;
+  for (i = 0; i < energymon_shmem_backends_len; i++) {
+    if (strlen(energymon_shmem_backends[i].name) == len && !strncmp(energymon_shmem_backends[i].name, arg, len)) {
+      break;
+    }
+  }
+  if (i == energymon_shmem_backends_len) {
+    fprintf(stderr, "Unknown backend: %.*s\n", (int) len, arg);
+    print_usage(EINVAL);
+  }
+  for (j = 0; j < n_sources; j++) {
+    if (sources[j].backend == &energymon_shmem_backends[i]) {
+      fprintf(stderr, "Duplicate backend: %s\n", energymon_shmem_backends[i].name);
+      print_usage(EINVAL);
+    }
+  }
+  sources[n_sources].backend = &energymon_shmem_backends[i];
+  if (interval != NULL && (sources[n_sources].interval_us = strtoull(interval + 1, NULL, 0)) == 0) {
+    fprintf(stderr, "Interval must be > 0: %s\n", arg);
+    print_usage(EINVAL);
+  }
+  n_sources++;
+}
+
+static void set_ring_len(const char* arg) {
+  unsigned long n = strtoul(arg, NULL, 0);
+  if (n == 0 || n > RING_LEN_MAX) {
+    fprintf(stderr, "Ring length must be in range [1, %d]: %s\n", RING_LEN_MAX, arg);
+    print_usage(EINVAL);
+  }
+  for (ring_len = 1; ring_len < n; ring_len <<= 1);
+}
+
+static void set_idle_interval(const char* arg) {
+  if ((idle_interval_us = strtoull(arg, NULL, 0)) > IDLE_INTERVAL_MAX_US) {
+    fprintf(stderr, "Idle interval is too long to catch energy counter overflows, using %d: %s\n",
+            IDLE_INTERVAL_MAX_US, arg);
+    idle_interval_us = IDLE_INTERVAL_MAX_US;
+  }
+}
+
+static void add_ewma(const char* arg) {
+  if (n_ewma == ENERGYMON_SHMEM_EWMA_MAX) {
+    fprintf(stderr, "At most %d moving averages are supported\n", ENERGYMON_SHMEM_EWMA_MAX);
+    print_usage(EINVAL);
+  }
+  if ((ewma_window_us[n_ewma++] = strtoull(arg, NULL, 0)) == 0) {
+    fprintf(stderr, "Moving average time constant must be > 0: %s\n", arg);
+    print_usage(EINVAL);
+  }
+}
+
 static void parse_args(int argc, char** argv) {
   const char* key_proj_id_env;
   int c;
@@ -73,6 +261,21 @@ static void parse_args(int argc, char** argv) {
       case 'h':
         print_usage(0);
         break;
+      case 'b':
+        add_source(optarg);
+        break;
+      case 'l':
+        print_backends();
+        break;
+      case 'I':
+        set_idle_interval(optarg);
+        break;
+      case 'S':
+        state_path = optarg;
+        break;
+      case 'e':
+        add_ewma(optarg);
+        break;
       case 'd':
         key_dir = optarg;
         break;
@@ -80,12 +283,40 @@ static void parse_args(int argc, char** argv) {
         key_proj_id = atoi(optarg);
         enforce_key_proj_id();
         break;
+      case 'n':
+        shm_name = optarg;
+        break;
+      case 'r':
+        set_ring_len(optarg);
+        break;
+      case 's':
+        socket_path = optarg;
+        break;
       case '?':
       default:
         print_usage(EINVAL);
         break;
     }
   }
+  if (shm_name != NULL && socket_path != NULL) {
+    fprintf(stderr, "Options --name and --socket are mutually exclusive\n");
+    print_usage(EINVAL);
+  }
+  if (shm_name != NULL && idle_interval_us > 0) {
+    // there's no way to know if consumers have the object mapped
+    fprintf(stderr, "Option --idle-interval is not supported with --name\n");
+    print_usage(EINVAL);
+  }
+  if (n_ewma == 0) {
+    ewma_window_us[n_ewma++] = EWMA_WINDOW_US_DEFAULT;
+  }
+  if (n_sources == 0) {
+    if (energymon_shmem_backends_len != 1) {
+      fprintf(stderr, "Must specify at least one backend\n");
+      print_usage(EINVAL);
+    }
+    sources[n_sources++].backend = &energymon_shmem_backends[0];
+  }
   if (key_dir == NULL) {
     key_dir = getenv(ENERGYMON_SHMEM_DIR);
     if (key_dir == NULL) {
@@ -110,9 +341,6 @@ static void shandle(int sig) {
 #ifdef SIGQUIT
     case SIGQUIT:
 #endif
-#ifdef SIGKILL
-    case SIGKILL:
-#endif
 #ifdef SIGHUP
     case SIGHUP:
 #endif
@@ -122,77 +350,838 @@ static void shandle(int sig) {
   }
 }
 
+static int register_signals(void) {
+  static const int sigs[] = {
+    SIGTERM,
+    SIGINT,
+#ifdef SIGQUIT
+    SIGQUIT,
+#endif
+#ifdef SIGHUP
+    SIGHUP,
+#endif
+  };
+  struct sigaction sa;
+  size_t i;
+  memset(&sa, 0, sizeof(sa));
+  // no SA_RESTART, so blocking calls are interrupted and the main loop exits promptly
+  sa.sa_handler = shandle;
+  sigemptyset(&sa.sa_mask);
+  for (i = 0; i < sizeof(sigs) / sizeof(sigs[0]); i++) {
+    if (sigaction(sigs[i], &sa, NULL)) {
+      perror("sigaction");
+      return -1;
+    }
+  }
+  // consumers may disconnect before we send them the memory file
+  signal(SIGPIPE, SIG_IGN);
+  return 0;
+}
+
+/**
+ * Load the totals and generation saved by a previous provider, if any.
+ */
+static int load_state(void) {
+  char line[128];
+  saved_channel* tmp;
+  unsigned long long energy_uj;
+  unsigned int gen;
+  int pos;
+  FILE* f = fopen(state_path, "r");
+  if (f == NULL) {
+    if (errno == ENOENT) {
+      // nothing saved yet
+      return 0;
+    }
+    perror(state_path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    pos = 0;
+    if (sscanf(line, "generation %u", &gen) == 1) {
+      generation = (uint32_t) gen + 1;
+    } else if (sscanf(line, "energy_uj %llu %n", &energy_uj, &pos) == 1 && pos > 0 && line[pos] != '\0') {
+      if ((tmp = realloc(saved, (n_saved + 1) * sizeof(saved_channel))) == NULL) {
+        perror("realloc");
+        fclose(f);
+        return -1;
+      }
+      saved = tmp;
+      energymon_strencpy(saved[n_saved].name, line + pos, sizeof(saved[n_saved].name));
+      saved[n_saved++].energy_uj = (uint64_t) energy_uj;
+    }
+  }
+  fclose(f);
+  return 0;
+}
+
+/**
+ * Save the generation and the totals last published in each channel, replacing the file atomically.
+ */
+static void save_state(void) {
+  const energymon_shmem_channel* ch = (const energymon_shmem_channel*) (ems + 1);
+  size_t len = strlen(state_path) + sizeof(".tmp");
+  char* tmp_path;
+  FILE* f;
+  size_t i;
+  if ((tmp_path = malloc(len)) == NULL) {
+    perror("malloc");
+    return;
+  }
+  snprintf(tmp_path, len, "%s.tmp", state_path);
+  if ((f = fopen(tmp_path, "w")) == NULL) {
+    perror(tmp_path);
+    free(tmp_path);
+    return;
+  }
+  fprintf(f, "generation %"PRIu32"\n", generation);
+  for (i = 0; i < shm_n_channels; i++) {
+    fprintf(f, "energy_uj %"PRIu64" %s\n", energymon_seqlock_load(&ch[i].energy_uj), ch[i].name);
+  }
+  if (fclose(f) || rename(tmp_path, state_path)) {
+    perror(state_path);
+  }
+  free(tmp_path);
+}
+
+/**
+ * Mark shared memory as retired and wake any consumers waiting for updates, so they attach to our successor.
+ */
+static void retire(energymon_shmem_v2* e) {
+  energymon_shmem_channel* ch = (energymon_shmem_channel*) (e + 1);
+  uint32_t i;
+  __atomic_fetch_or(&e->flags, ENERGYMON_SHMEM_FLAG_RETIRED, __ATOMIC_RELEASE);
+  energymon_futex_bump(&e->futex);
+  for (i = 0; i < e->n_channels; i++, ch = (energymon_shmem_channel*) ((char*) ch + e->channel_size)) {
+    energymon_futex_bump(&ch->futex);
+  }
+}
+
+/**
+ * Take over shared memory left behind by a provider that exited without removing it, e.g., because it crashed.
+ * Its totals are newer than any it saved, so we continue from them.
+ */
+static int take_over(energymon_shmem_v2* old, size_t size) {
+  const energymon_shmem_channel* ch = (const energymon_shmem_channel*) (old + 1);
+  uint32_t i;
+  if (size < sizeof(energymon_shmem_v2) || __atomic_load_n(&old->magic, __ATOMIC_ACQUIRE) != ENERGYMON_SHMEM_MAGIC ||
+      old->abi_version != ENERGYMON_SHMEM_ABI_VERSION ||
+      (old->n_channels > 0 && old->channel_size < offsetof(energymon_shmem_channel, ewma_power_uw)) ||
+      (size - sizeof(energymon_shmem_v2)) / (old->channel_size ? old->channel_size : 1) < old->n_channels) {
+    fprintf(stderr, "Shared memory exists, but wasn't created by a compatible provider\n");
+    errno = EEXIST;
+    return -1;
+  }
+  // EPERM means the process exists, but belongs to another user
+  if (!(__atomic_load_n(&old->flags, __ATOMIC_ACQUIRE) & ENERGYMON_SHMEM_FLAG_RETIRED) &&
+      (kill((pid_t) old->pid, 0) == 0 || errno != ESRCH)) {
+    fprintf(stderr, "Shared memory is in use by another provider: %"PRId32"\n", old->pid);
+    errno = EEXIST;
+    return -1;
+  }
+  free(saved);
+  n_saved = 0;
+  if (old->n_channels > 0 && (saved = calloc(old->n_channels, sizeof(saved_channel))) == NULL) {
+    perror("calloc");
+    return -1;
+  }
+  for (i = 0; i < old->n_channels; i++, ch = (const energymon_shmem_channel*) ((const char*) ch + old->channel_size)) {
+    energymon_strencpy(saved[i].name, ch->name, sizeof(saved[i].name));
+    saved[i].energy_uj = energymon_seqlock_load(&ch->energy_uj);
+  }
+  n_saved = old->n_channels;
+  if (old->generation >= generation) {
+    generation = old->generation + 1;
+  }
+  retire(old);
+  return 0;
+}
+
 static int cleanup_shmem(void) {
-  // detach shared memory
-  if (shmdt(ems)) {
-    perror("shmdt");
-    return -errno;
+  int ret = 0;
+  if (map_len == 0) {
+    // detach shared memory
+    if (ems != NULL && shmdt(ems)) {
+      perror("shmdt");
+      ret = -errno;
+    }
+    // destroy shared memory
+    if (shm_id >= 0 && shmctl(shm_id, IPC_RMID, NULL)) {
+      perror("shmctl");
+      ret = -errno;
+    }
+    return ret;
   }
-  // destroy shared memory
-  if (shmctl(shm_id, IPC_RMID, NULL)) {
-    perror("shmctl");
-    return -errno;
+  if (ems != NULL && munmap(ems, map_len)) {
+    perror("munmap");
+    ret = -errno;
+  }
+  if (mem_fd >= 0) {
+    close(mem_fd);
+  }
+  if (shm_name != NULL && shm_unlink(shm_name)) {
+    perror("shm_unlink");
+    ret = -errno;
+  }
+  while (n_clients > 0) {
+    close(clients[--n_clients]);
+  }
+  free(clients);
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    if (unlink(socket_path)) {
+      perror("unlink");
+      ret = -errno;
+    }
+  }
+  return ret;
+}
+
+static int create_sysv(void) {
+  key_t mem_key = ftok(key_dir, key_proj_id);
+  struct shmid_ds ds;
+  void* old;
+  int old_id;
+  int ret;
+  while ((shm_id = shmget(mem_key, shm_size, 0644 | IPC_CREAT | IPC_EXCL)) < 0) {
+    if (errno != EEXIST || (old_id = shmget(mem_key, 0, 0)) < 0 || shmctl(old_id, IPC_STAT, &ds) ||
+        (old = shmat(old_id, NULL, 0)) == (void*) -1) {
+      perror("shmget");
+      return -1;
+    }
+    ret = take_over(old, ds.shm_segsz);
+    shmdt(old);
+    if (ret) {
+      return -1;
+    }
+    // consumers that are still attached keep the memory until they reattach
+    if (shmctl(old_id, IPC_RMID, NULL)) {
+      perror("shmctl");
+      return -1;
+    }
+  }
+  ems = (energymon_shmem_v2*) shmat(shm_id, NULL, 0);
+  if (ems == (energymon_shmem_v2*) -1) {
+    perror("shmat");
+    ems = NULL;
+    return -1;
   }
   return 0;
 }
 
-int main(int argc, char** argv) {
-  energymon em;
+/**
+ * Whether a socket was left behind by a provider that exited without removing it, i.e., nobody is listening.
+ */
+static int is_stale_socket(const struct sockaddr_un* addr) {
+  int stale = 0;
+  int fd;
+  if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) >= 0) {
+    stale = connect(fd, (const struct sockaddr*) addr, sizeof(*addr)) && errno == ECONNREFUSED;
+    close(fd);
+  }
+  errno = EADDRINUSE;
+  return stale;
+}
+
+static int listen_socket(void) {
+  struct sockaddr_un addr;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", socket_path);
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  if ((listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+    perror("socket");
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+  while (bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr))) {
+    if (errno == EADDRINUSE && is_stale_socket(&addr) && unlink(socket_path) == 0) {
+      continue;
+    }
+    perror("bind");
+    close(listen_fd);
+    listen_fd = -1;
+    return -1;
+  }
+  if (listen(listen_fd, SOMAXCONN)) {
+    perror("listen");
+    return -1;
+  }
+  return 0;
+}
+
+static int take_over_name(void) {
+  struct stat st;
+  void* old;
+  int ret;
+  int fd;
+  if ((fd = shm_open(shm_name, O_RDWR | O_CLOEXEC, 0)) < 0) {
+    return -1;
+  }
+  if (fstat(fd, &st) || st.st_size == 0 ||
+      (old = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    close(fd);
+    errno = EEXIST;
+    return -1;
+  }
+  close(fd);
+  ret = take_over(old, (size_t) st.st_size);
+  munmap(old, (size_t) st.st_size);
+  return ret || shm_unlink(shm_name);
+}
+
+static int create_posix(void) {
+  // the mapping is page-granular anyway
+  long page_size = sysconf(_SC_PAGESIZE);
+  map_len = page_size > 0 ? (shm_size + (size_t) page_size - 1) / (size_t) page_size * (size_t) page_size : shm_size;
+  if (socket_path != NULL) {
+#ifdef __linux__
+    if ((mem_fd = memfd_create(ENERGYMON_UTIL_PREFIX"-shmem", MFD_CLOEXEC | MFD_ALLOW_SEALING)) < 0) {
+      perror("memfd_create");
+      return -1;
+    }
+#else
+    fprintf(stderr, "Option --socket is only supported on Linux\n");
+    errno = ENOSYS;
+    return -1;
+#endif
+  } else {
+    while ((mem_fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644)) < 0) {
+      if (errno != EEXIST || take_over_name()) {
+        perror("shm_open");
+        // don't unlink another provider's object
+        shm_name = NULL;
+        return -1;
+      }
+    }
+  }
+  if (ftruncate(mem_fd, (off_t) map_len)) {
+    perror("ftruncate");
+    return -1;
+  }
+  ems = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+  if (ems == MAP_FAILED) {
+    perror("mmap");
+    ems = NULL;
+    return -1;
+  }
+#ifdef __linux__
+  if (socket_path != NULL) {
+    // consumers must not be able to resize the file (which would SIGBUS us) or write to it
+    if (fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+#ifdef F_SEAL_FUTURE_WRITE
+              F_SEAL_FUTURE_WRITE |
+#endif
+              F_SEAL_SEAL)) {
+      perror("fcntl:F_ADD_SEALS");
+      return -1;
+    }
+    return listen_socket();
+  }
+#endif
+  return 0;
+}
+
+static int send_fd(int client_fd) {
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  char data = 0;
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+  iov.iov_base = &data;
+  iov.iov_len = sizeof(data);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &mem_fd, sizeof(int));
+  if (sendmsg(client_fd, &msg, MSG_NOSIGNAL) < 0) {
+    perror("sendmsg");
+    return -1;
+  }
+  return 0;
+}
+
+static void accept_clients(void) {
+  int* tmp;
+  int client_fd;
+  while ((client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC)) >= 0) {
+    if (send_fd(client_fd) || (tmp = realloc(clients, (n_clients + 1) * sizeof(int))) == NULL) {
+      close(client_fd);
+      continue;
+    }
+    clients = tmp;
+    clients[n_clients++] = client_fd;
+  }
+}
+
+/**
+ * Whether a readable consumer connection was closed - consumers never send anything, so data, EOF, or an error (e.g.,
+ * ECONNRESET if the consumer exited with unread data) all mean it's gone.
+ */
+static int is_disconnected(int fd) {
+  char c;
+  return recv(fd, &c, sizeof(c), MSG_DONTWAIT) != -1 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+/**
+ * Wait until the deadline, handing out the memory file to any consumers that connect in the meantime.
+ * Returns early if a consumer connects or disconnects.
+ */
+static void wait_socket(uint64_t deadline_ns) {
+  struct pollfd* pfds;
   struct timespec ts;
-  key_t mem_key;
+  uint64_t now_ns;
+  size_t n_pfds;
+  size_t i;
+  if ((now_ns = energymon_gettime_ns()) >= deadline_ns) {
+    return;
+  }
+  if ((pfds = malloc((n_clients + 1) * sizeof(struct pollfd))) == NULL) {
+    energymon_sleep_until_ns(deadline_ns, &running);
+    return;
+  }
+  pfds[0].fd = listen_fd;
+  pfds[0].events = POLLIN;
+  for (i = 0; i < n_clients; i++) {
+    pfds[i + 1].fd = clients[i];
+    pfds[i + 1].events = POLLIN;
+  }
+  n_pfds = n_clients + 1;
+  ts.tv_sec = (time_t) ((deadline_ns - now_ns) / 1000000000);
+  ts.tv_nsec = (long) ((deadline_ns - now_ns) % 1000000000);
+  if (ppoll(pfds, n_pfds, &ts, NULL) > 0) {
+    // remove disconnected consumers in reverse to keep indexes valid
+    for (i = n_pfds - 1; i > 0; i--) {
+      if (pfds[i].revents && is_disconnected(clients[i - 1])) {
+        close(clients[i - 1]);
+        clients[i - 1] = clients[--n_clients];
+      }
+    }
+    if (pfds[0].revents) {
+      accept_clients();
+    }
+  }
+  free(pfds);
+}
 
-  // register the signal handler
-  signal(SIGINT, shandle);
+/**
+ * Wait until the deadline, or until a consumer attaches.
+ */
+static void wait_until(uint64_t deadline_ns) {
+  uint64_t now_ns;
+  if (listen_fd >= 0) {
+    wait_socket(deadline_ns);
+  } else if ((now_ns = energymon_gettime_ns()) < deadline_ns) {
+    // consumers wake attach_futex after attaching
+    if (energymon_futex_wait(&ems->attach_futex, 0, deadline_ns - now_ns) && errno == ENOSYS) {
+      energymon_sleep_until_ns(deadline_ns, &running);
+    }
+  }
+}
 
-  parse_args(argc, argv);
+/**
+ * Whether any consumers are attached (assume so if we can't tell).
+ */
+static int consumers_attached(void) {
+  struct shmid_ds ds;
+  if (listen_fd >= 0) {
+    return n_clients > 0;
+  }
+  if (shm_id >= 0) {
+    // we're attached too
+    return shmctl(shm_id, IPC_STAT, &ds) || ds.shm_nattch > 1;
+  }
+  return 1;
+}
 
-  // get the shared memory
-  mem_key = ftok(key_dir, key_proj_id);
-  shm_id = shmget(mem_key, sizeof(energymon_shmem), 0644 | IPC_CREAT | IPC_EXCL);
-  if (shm_id < 0) {
-    perror("shmget");
-    return -errno;
+/**
+ * Increment a futex, but only wake waiters if consumers are attached.
+ * Consumers map the memory read-only, so they can't tell us if they're waiting - but they can't wait while detached.
+ */
+static void bump_futex(uint32_t* futex) {
+  if (attached) {
+    energymon_futex_bump(futex);
+  } else {
+    __atomic_add_fetch(futex, 1, __ATOMIC_RELEASE);
   }
-  ems = (energymon_shmem*) shmat(shm_id, NULL, 0);
-  if (ems == (energymon_shmem*) -1) {
-    perror("shmat");
-    cleanup_shmem();
+}
+
+/**
+ * Wake waiters on all futexes without modifying them.
+ */
+static void wake_all(void) {
+  const energymon_shmem_channel* ch = (const energymon_shmem_channel*) (ems + 1);
+  uint32_t i;
+  energymon_futex_wake(&ems->futex);
+  for (i = 0; i < ems->n_channels; i++, ch++) {
+    energymon_futex_wake(&ch->futex);
+  }
+}
+
+static void publish(uint32_t* seq, uint32_t* futex, uint64_t* energy_uj_dest, uint64_t* update_time_ns_dest,
+                    uint64_t energy_uj, uint64_t now_ns) {
+  // the seq field is the seqlock's only member
+  energymon_seqlock* sl = (energymon_seqlock*) seq;
+  energymon_seqlock_write_begin(sl);
+  energymon_seqlock_store(energy_uj_dest, energy_uj);
+  energymon_seqlock_store(update_time_ns_dest, now_ns);
+  energymon_seqlock_write_end(sl);
+  bump_futex(futex);
+}
+
+static void push_sample(energymon_shmem_channel* ch, energymon_shmem_ring_slot* ring, uint64_t energy_uj,
+                        uint64_t now_ns) {
+  // only we write ring_head, so a relaxed load of our own last store is fine
+  uint64_t seq = __atomic_load_n(&ch->ring_head, __ATOMIC_RELAXED) + 1;
+  energymon_shmem_ring_slot* slot = &ring[seq & (ring_len - 1)];
+  // invalidate the slot, ordered before the data stores
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  energymon_seqlock_store(&slot->time_ns, now_ns);
+  energymon_seqlock_store(&slot->energy_uj, energy_uj);
+  __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+  __atomic_store_n(&ch->ring_head, seq, __ATOMIC_RELEASE);
+}
+
+/**
+ * Update a channel's power statistics from its previous update.
+ * Returns non-zero if there's a new power value.
+ */
+static int update_stats(channel_stats* st, uint64_t energy_uj, uint64_t now_ns, uint64_t* power_uw) {
+  double power;
+  double alpha;
+  size_t i;
+  int ret = 0;
+  // energy can decrease if an implementation's counter is reset, and two polls can share a clock tick
+  if (st->updated && energy_uj >= st->last_uj && now_ns > st->last_ns) {
+    power = (double) (energy_uj - st->last_uj) * 1000000000.0 / (double) (now_ns - st->last_ns);
+    *power_uw = (uint64_t) power;
+    for (i = 0; i < n_ewma; i++) {
+      if (!st->has_power) {
+        st->ewma_power_uw[i] = power;
+      } else {
+        // weight by elapsed time, since polls may be skipped or back off while idle
+        alpha = 1.0 - exp(-(double) (now_ns - st->last_ns) / ((double) ewma_window_us[i] * 1000.0));
+        st->ewma_power_uw[i] += alpha * (power - st->ewma_power_uw[i]);
+      }
+    }
+    if (!st->has_power || *power_uw < st->min_power_uw) {
+      st->min_power_uw = *power_uw;
+    }
+    if (!st->has_power || *power_uw > st->max_power_uw) {
+      st->max_power_uw = *power_uw;
+    }
+    st->has_power = 1;
+    ret = 1;
+  }
+  st->last_uj = energy_uj;
+  st->last_ns = now_ns;
+  st->updated = 1;
+  return ret;
+}
+
+static void publish_channel(shmem_source* src, size_t channel, uint64_t energy_uj, uint64_t now_ns) {
+  energymon_shmem_channel* ch = &src->channels[channel];
+  channel_stats* st = &src->stats[channel];
+  // the seq field is the seqlock's only member
+  energymon_seqlock* sl = (energymon_seqlock*) &ch->seq;
+  uint64_t power_uw;
+  int has_power = update_stats(st, energy_uj, now_ns, &power_uw);
+  size_t i;
+  // update the ring first so that consumers woken by the futex see the new sample
+  if (src->rings != NULL) {
+    push_sample(ch, &src->rings[channel * ring_len], energy_uj, now_ns);
+  }
+  energymon_seqlock_write_begin(sl);
+  energymon_seqlock_store(&ch->energy_uj, energy_uj);
+  energymon_seqlock_store(&ch->update_time_ns, now_ns);
+  if (has_power) {
+    energymon_seqlock_store(&ch->power_uw, power_uw);
+    energymon_seqlock_store(&ch->min_power_uw, st->min_power_uw);
+    energymon_seqlock_store(&ch->max_power_uw, st->max_power_uw);
+    for (i = 0; i < n_ewma; i++) {
+      energymon_seqlock_store(&ch->ewma_power_uw[i], (uint64_t) st->ewma_power_uw[i]);
+    }
+  }
+  energymon_seqlock_write_end(sl);
+  bump_futex(&ch->futex);
+}
+
+/**
+ * Read all of a source's channels in a single pass and publish each one.
+ */
+static void poll_source(shmem_source* src) {
+  uint64_t energy_uj;
+  uint64_t now_ns;
+  size_t i;
+  if (src->n_channels > 1) {
+    energy_uj = src->backend->read_channels(&src->em, src->channel_uj, src->n_channels - 1);
+  } else {
+    energy_uj = src->em.fread(&src->em);
+  }
+  now_ns = energymon_gettime_ns();
+  energy_uj += src->offset_uj[0];
+  publish_channel(src, 0, energy_uj, now_ns);
+  for (i = 1; i < src->n_channels; i++) {
+    publish_channel(src, i, src->channel_uj[i - 1] + src->offset_uj[i], now_ns);
+  }
+  if (src == &sources[0]) {
+    publish(&ems->seq, &ems->futex, &ems->energy_uj, &ems->update_time_ns, energy_uj, now_ns);
+  }
+}
+
+static int init_source(shmem_source* src) {
+  if (src->backend->get(&src->em)) {
+    perror(src->backend->name);
+    return -1;
+  }
+  if (src->em.finit(&src->em)) {
+    fprintf(stderr, "%s: ", src->backend->name);
+    perror("energymon:finit");
+    return -1;
+  }
+  src->initialized = 1;
+  if (src->interval_us == 0) {
+    src->interval_us = src->em.finterval(&src->em);
+  }
+  // channel 0 is the total
+  src->n_channels = 1;
+  if (src->backend->get_channel_count != NULL) {
+    src->n_channels += src->backend->get_channel_count(&src->em);
+    if (src->n_channels > 1 && (src->channel_uj = calloc(src->n_channels - 1, sizeof(uint64_t))) == NULL) {
+      perror("calloc");
+      return -1;
+    }
+  }
+  if ((src->offset_uj = calloc(src->n_channels, sizeof(uint64_t))) == NULL ||
+      (src->stats = calloc(src->n_channels, sizeof(channel_stats))) == NULL) {
+    perror("calloc");
+    return -1;
+  }
+  return 0;
+}
+
+static void finish_sources(void) {
+  size_t i;
+  for (i = 0; i < n_sources; i++) {
+    if (sources[i].missed) {
+      fprintf(stderr, "%s: missed %"PRIu64" polls, the interval may be too short\n", sources[i].backend->name,
+              sources[i].missed);
+    }
+    if (sources[i].initialized && sources[i].em.ffinish(&sources[i].em)) {
+      fprintf(stderr, "%s: ", sources[i].backend->name);
+      perror("energymon:ffinish");
+    }
+    free(sources[i].channel_uj);
+    free(sources[i].offset_uj);
+    free(sources[i].stats);
+  }
+  free(sources);
+  free(saved);
+}
+
+static void init_channels(void) {
+  energymon_shmem_channel* ch = (energymon_shmem_channel*) (ems + 1);
+  energymon_shmem_ring_slot* ring = (energymon_shmem_ring_slot*) (ch + shm_n_channels);
+  uint64_t precision_uj;
+  shmem_source* src;
+  size_t len;
+  size_t i;
+  size_t j;
+  size_t k;
+  for (i = 0; i < n_sources; i++) {
+    src = &sources[i];
+    src->channels = ch;
+    if (ring_len > 0) {
+      src->rings = ring;
+      ring += src->n_channels * ring_len;
+    }
+    precision_uj = src->em.fprecision(&src->em);
+    for (j = 0; j < src->n_channels; j++, ch++) {
+      ch->interval_us = src->interval_us;
+      ch->precision_uj = precision_uj;
+      for (k = 0; k < n_ewma; k++) {
+        ch->ewma_window_us[k] = ewma_window_us[k];
+      }
+      // "<backend>" for the total, "<backend>:<channel>" otherwise - long names are truncated
+      len = strlen(src->backend->name);
+      energymon_strencpy(ch->name, src->backend->name, sizeof(ch->name));
+      if (j > 0 && len + 1 < sizeof(ch->name)) {
+        ch->name[len++] = ':';
+        if (src->backend->get_channel_name(&src->em, j - 1, ch->name + len, sizeof(ch->name) - len) == NULL) {
+          snprintf(ch->name + len, sizeof(ch->name) - len, "%zu", j - 1);
+        }
+      }
+      energymon_seqlock_init((energymon_seqlock*) &ch->seq);
+      // continue from a previous provider's total
+      for (k = 0; k < n_saved; k++) {
+        if (!strncmp(saved[k].name, ch->name, sizeof(ch->name))) {
+          src->offset_uj[j] = saved[k].energy_uj;
+          break;
+        }
+      }
+    }
+    ems->n_channels += (uint32_t) src->n_channels;
+  }
+  ems->channel_size = sizeof(energymon_shmem_channel);
+  ems->ring_len = ring_len;
+  ems->ring_slot_size = ring_len > 0 ? sizeof(energymon_shmem_ring_slot) : 0;
+}
+
+static uint64_t get_interval_ns(const shmem_source* src) {
+  if (!attached && idle_interval_us > src->interval_us) {
+    return idle_interval_us * 1000;
+  }
+  return src->interval_us * 1000;
+}
+
+static void set_attached(uint64_t now_ns) {
+  size_t i;
+  if (idle_interval_us > 0) {
+    // ramp up immediately so the new consumer gets fresh data
+    for (i = 0; i < n_sources; i++) {
+      sources[i].next_ns = now_ns;
+    }
+  }
+  attached = 1;
+}
+
+/**
+ * Poll each source on its own interval until stopped, backing off while no consumers are attached.
+ */
+static void run(void) {
+  uint64_t now_ns = energymon_gettime_ns();
+  uint64_t save_ns = now_ns + STATE_SAVE_INTERVAL_NS;
+  uint64_t detach_check_ns = now_ns + DETACH_CHECK_INTERVAL_NS;
+  uint64_t deadline_ns;
+  uint64_t interval_ns;
+  uint64_t skip;
+  size_t i;
+  int polled;
+  attached = consumers_attached();
+  for (i = 0; i < n_sources; i++) {
+    sources[i].next_ns = now_ns + get_interval_ns(&sources[i]);
+  }
+  while (running) {
+    for (deadline_ns = UINT64_MAX, i = 0; i < n_sources; i++) {
+      if (sources[i].next_ns < deadline_ns) {
+        deadline_ns = sources[i].next_ns;
+      }
+    }
+    wait_until(deadline_ns);
+    now_ns = energymon_gettime_ns();
+    if (!attached && consumers_attached()) {
+      set_attached(now_ns);
+    } else if (attached && now_ns >= detach_check_ns) {
+      // waking futexes with no waiters is harmless, so we only need to notice a detach eventually
+      attached = consumers_attached();
+      detach_check_ns = now_ns + DETACH_CHECK_INTERVAL_NS;
+    }
+    for (polled = 0, i = 0; running && i < n_sources; i++) {
+      if (sources[i].next_ns > now_ns) {
+        continue;
+      }
+      poll_source(&sources[i]);
+      polled = 1;
+      // keep a fixed cadence (absolute deadlines don't drift), but skip missed polls rather than catching up
+      interval_ns = get_interval_ns(&sources[i]);
+      if (now_ns >= sources[i].next_ns + interval_ns) {
+        skip = (now_ns - sources[i].next_ns) / interval_ns;
+        sources[i].missed += skip;
+        sources[i].next_ns += skip * interval_ns;
+      }
+      sources[i].next_ns += interval_ns;
+    }
+    // a consumer that attached since we checked may have started waiting before we published without waking it
+    if (polled && !attached && consumers_attached()) {
+      set_attached(now_ns);
+      wake_all();
+    }
+    if (state_path != NULL && now_ns >= save_ns) {
+      save_state();
+      save_ns = now_ns + STATE_SAVE_INTERVAL_NS;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t i;
+
+  // register the signal handlers
+  if (register_signals()) {
     return -errno;
   }
 
-  // get the energy monitor
-  if (energymon_get(&em)) {
-    cleanup_shmem();
+  if ((sources = calloc(energymon_shmem_backends_len, sizeof(shmem_source))) == NULL) {
+    perror("calloc");
+    return -errno;
+  }
+  parse_args(argc, argv);
+  if (state_path != NULL && load_state()) {
+    finish_sources();
     return -errno;
   }
 
-  // initialize the energy monitor
-  if (em.finit(&em)) {
-    perror("energymon:finit");
+  // initialize the energy monitors, which determines the size of the channel table
+  for (i = 0; i < n_sources; i++) {
+    if (init_source(&sources[i])) {
+      finish_sources();
+      return -errno;
+    }
+    shm_n_channels += sources[i].n_channels;
+  }
+  shm_size = sizeof(energymon_shmem_v2) + shm_n_channels * sizeof(energymon_shmem_channel) +
+             shm_n_channels * ring_len * sizeof(energymon_shmem_ring_slot);
+
+  // get the shared memory
+  if (shm_name != NULL || socket_path != NULL ? create_posix() : create_sysv()) {
     cleanup_shmem();
+    finish_sources();
     return -errno;
   }
-  
-  // store the interval in shared memory
-  ems->interval_us = em.finterval(&em);
-  ts.tv_sec = (time_t) (ems->interval_us / (uint64_t) 1000000);
-  ts.tv_nsec = (long) ((ems->interval_us % (uint64_t) 1000000) * (uint64_t) 1000);
 
-  // store the precision in shared memory
-  ems->precision_uj = em.fprecision(&em);
+  // store the header in shared memory - the magic number is stored last to mark it as complete
+  ems->abi_version = ENERGYMON_SHMEM_ABI_VERSION;
+  ems->pid = (int32_t) getpid();
+  ems->generation = generation;
+  ems->flags = ENERGYMON_SHMEM_FLAG_POWER;
+#ifdef __linux__
+  ems->flags |= ENERGYMON_SHMEM_FLAG_FUTEX | ENERGYMON_SHMEM_FLAG_ATTACH_WAKE;
+#endif
+  ems->interval_us = sources[0].interval_us;
+  energymon_seqlock_init((energymon_seqlock*) &ems->seq);
+  init_channels();
+  ems->precision_uj = sources[0].channels[0].precision_uj;
+  for (i = 0; i < n_sources; i++) {
+    poll_source(&sources[i]);
+  }
+  __atomic_store_n(&ems->magic, ENERGYMON_SHMEM_MAGIC, __ATOMIC_RELEASE);
+
+  run();
 
-  while (running) {
-    // update the energy in shared memory
-    ems->energy_uj = em.fread(&em);
-    nanosleep(&ts, NULL);
+  // save the final totals before telling consumers to attach to our successor
+  if (state_path != NULL) {
+    save_state();
   }
+  retire(ems);
 
   errno = 0;
   // cleanup
-  if (em.ffinish(&em)) {
-    perror("energymon:ffinish");
-  }
-
+  finish_sources();
   cleanup_shmem();
 
   return errno;
@@ -7,12 +7,26 @@
 
 #define _GNU_SOURCE
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/ipc.h>
+#include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include "energymon.h"
+#include "energymon-futex.h"
+#include "energymon-seqlock.h"
 #include "energymon-shmem.h"
+#include "energymon-shmem-inline.h"
+#include "energymon-time-util.h"
 #include "energymon-util.h"
 
 #ifdef ENERGYMON_DEFAULT
@@ -22,18 +36,147 @@ int energymon_get_default(energymon* em) {
 }
 #endif
 
-int energymon_init_shmem(energymon* em) {
-  if (em == NULL || em->state != NULL) {
-    errno = EINVAL;
+// an attachment to one provider's shared memory, which is replaced if the provider restarts
+typedef struct energymon_shmem_attachment {
+  union {
+    energymon_shmem* v1;
+    energymon_shmem_v2* v2;
+  } mem;
+  int version;
+  // length of the mmap'd region, or 0 if attached with shmat
+  size_t map_len;
+  // the connection to the provider, held open so it knows we're attached, or -1
+  int sock;
+  // the channel used for the energymon interface, or NULL to use the v2 data (which mirrors the first channel)
+  const energymon_shmem_channel* selected;
+  size_t selected_index;
+  // the sample ring for the selected (or first) channel, or NULL if there isn't one
+  const char* ring;
+  // added to the provider's values so that energy never decreases across provider restarts
+  uint64_t offset_uj;
+  // per-channel offsets, or NULL if all are 0
+  uint64_t* channel_offset_uj;
+  // identifies the shared memory (the System V ID or the file's inode), to tell a successor from the memory that a
+  // crashed provider left behind
+  uint64_t mem_id;
+  // replaced attachments, which are kept until finish since other threads (and views) may still be reading from them
+  struct energymon_shmem_attachment* prev;
+} energymon_shmem_attachment;
+
+typedef struct energymon_shmem_state {
+  // the current attachment, loaded and stored atomically
+  energymon_shmem_attachment* att;
+  // the channel requested with ENERGYMON_SHMEM_CHANNEL, or NULL
+  char* channel;
+  // only accessed when looking for a successor - see find_successor
+  uint64_t next_attach_ns;
+  int reattaching;
+} energymon_shmem_state;
+
+/**
+ * Each thread's view of its last read, so that detecting a crashed provider doesn't write to memory shared with other
+ * threads - see check_provider.
+ */
+typedef struct energymon_shmem_probe {
+  const energymon_shmem_attachment* att;
+  uint64_t update_time_ns;
+  uint64_t unchanged_reads;
+} energymon_shmem_probe;
+
+static __thread energymon_shmem_probe probe;
+
+// don't suspect the provider until its data is this much older than its interval
+#define STALE_NS 1000000000ULL
+// check for staleness at least this often while the data isn't changing (must be a power of 2)
+#define PROBE_READS_MAX 1024
+// how often to look for a successor to a provider that has exited
+#define REATTACH_INTERVAL_NS 100000000ULL
+
+// channels without the power fields end before the EWMAs
+#define CHANNEL_MIN_SIZE offsetof(energymon_shmem_channel, ewma_power_uw)
+
+static const energymon_shmem_channel* get_channel(const energymon_shmem_v2* ems, size_t channel) {
+  return (const energymon_shmem_channel*) ((const char*) (ems + 1) + channel * ems->channel_size);
+}
+
+// messages are suppressed while looking for a restarted provider, which may not have finished initializing
+#define LOG(verbose, ...) do { if (verbose) { fprintf(stderr, __VA_ARGS__); } } while (0)
+
+static int check_v2(const energymon_shmem_v2* ems, size_t size, int verbose) {
+  // the provider stores the magic number last
+  uint64_t magic = __atomic_load_n(&ems->magic, __ATOMIC_ACQUIRE);
+  if (magic == 0) {
+    LOG(verbose, "energymon_init_shmem: Provider has not finished initializing shared memory\n");
+    errno = EAGAIN;
+    return -1;
+  }
+  if (magic != ENERGYMON_SHMEM_MAGIC) {
+    LOG(verbose, "energymon_init_shmem: Bad magic number in shared memory: 0x%016"PRIx64"\n", magic);
+    errno = EPROTO;
+    return -1;
+  }
+  if (ems->abi_version != ENERGYMON_SHMEM_ABI_VERSION) {
+    LOG(verbose, "energymon_init_shmem: Unsupported shared memory ABI version: %"PRIu32"\n", ems->abi_version);
+    errno = EPROTO;
+    return -1;
+  }
+  // channels may grow in later versions, but must fit in the shared memory
+  if ((ems->n_channels > 0 && ems->channel_size < CHANNEL_MIN_SIZE) ||
+      ((ems->flags & ENERGYMON_SHMEM_FLAG_POWER) && ems->channel_size < sizeof(energymon_shmem_channel)) ||
+      (size - sizeof(energymon_shmem_v2)) / (ems->channel_size ? ems->channel_size : 1) < ems->n_channels) {
+    LOG(verbose, "energymon_init_shmem: Channel table doesn't fit in shared memory: %"PRIu32" x %"PRIu32"\n",
+        ems->n_channels, ems->channel_size);
+    errno = EPROTO;
     return -1;
   }
+  if (ems->ring_len > 0) {
+    size -= sizeof(energymon_shmem_v2) + (size_t) ems->n_channels * ems->channel_size;
+    if ((ems->ring_len & (ems->ring_len - 1)) || ems->ring_slot_size < sizeof(energymon_shmem_ring_slot) ||
+        size / ems->ring_slot_size / ems->ring_len < ems->n_channels) {
+      LOG(verbose, "energymon_init_shmem: Sample rings don't fit in shared memory: %"PRIu32" x %"PRIu32"\n",
+          ems->ring_len, ems->ring_slot_size);
+      errno = EPROTO;
+      return -1;
+    }
+  }
+  return 0;
+}
 
+static const char* get_ring(const energymon_shmem_v2* ems, size_t channel) {
+  if (ems->ring_len == 0 || channel >= ems->n_channels) {
+    return NULL;
+  }
+  return (const char*) get_channel(ems, ems->n_channels) + channel * ems->ring_len * ems->ring_slot_size;
+}
+
+static int select_channel(energymon_shmem_attachment* att, const char* name, int verbose) {
+  const energymon_shmem_channel* ch;
+  uint32_t i;
+  if (att->version == 1) {
+    LOG(verbose, "energymon_init_shmem: Channels are not supported by v1 shared memory\n");
+    errno = ENOTSUP;
+    return -1;
+  }
+  for (i = 0; i < att->mem.v2->n_channels; i++) {
+    ch = get_channel(att->mem.v2, i);
+    if (!strncmp(ch->name, name, sizeof(ch->name))) {
+      att->selected = ch;
+      att->selected_index = i;
+      return 0;
+    }
+  }
+  LOG(verbose, "energymon_init_shmem: No such channel: %s\n", name);
+  errno = ENOENT;
+  return -1;
+}
+
+static void* attach_sysv(size_t* size, uint64_t* mem_id) {
   const char* key_dir;
   int key_proj_id = ENERGYMON_SHMEM_ID_DEFAULT;
   const char* key_proj_id_env;
   key_t mem_key;
   int shm_id;
-  energymon_shmem* ems;
+  struct shmid_ds ds;
 
   // get desired configuration from environment
   key_dir = getenv(ENERGYMON_SHMEM_DIR);
@@ -50,24 +193,449 @@ int energymon_init_shmem(energymon* em) {
   shm_id = shmget(mem_key, sizeof(energymon_shmem), 0444);
   if (shm_id < 0) {
     // among other reasons, fails if nobody is providing this shared memory
+    return NULL;
+  }
+  // the segment size identifies the layout version
+  if (shmctl(shm_id, IPC_STAT, &ds)) {
+    return NULL;
+  }
+  *size = ds.shm_segsz;
+  *mem_id = (uint64_t) shm_id;
+  return shmat(shm_id, NULL, SHM_RDONLY);
+}
+
+/**
+ * Receive a file descriptor from the provider over a Unix domain socket.
+ * On success, the connected socket is returned in sock_out.
+ */
+static int recv_fd(const char* path, int* sock_out) {
+  struct sockaddr_un addr;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  char data;
+  ssize_t n;
+  int err_save;
+  int fd = -1;
+  int sock;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
     return -1;
   }
-  ems = (energymon_shmem*) shmat(shm_id, NULL, SHM_RDONLY);
-  if (ems == (energymon_shmem*) -1) {
+  if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
     return -1;
   }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if (connect(sock, (struct sockaddr*) &addr, sizeof(addr)) == 0) {
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &data;
+    iov.iov_len = sizeof(data);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) > 0) {
+      cmsg = CMSG_FIRSTHDR(&msg);
+      if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+          cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+      } else {
+        errno = EPROTO;
+      }
+    } else if (n == 0) {
+      // provider closed the connection without sending anything
+      errno = ECONNRESET;
+    }
+  }
+  if (fd >= 0) {
+    *sock_out = sock;
+    return fd;
+  }
+  err_save = errno;
+  close(sock);
+  errno = err_save;
+  return fd;
+}
 
-  em->state = ems;
+static void* map_fd(int fd, size_t* size, uint64_t* mem_id) {
+  struct stat st;
+  void* mem = NULL;
+  int err_save;
+  if (fstat(fd, &st) == 0) {
+    *size = (size_t) st.st_size;
+    *mem_id = (uint64_t) st.st_ino;
+    if (*size < sizeof(energymon_shmem_v2)) {
+      // only the v2 layout is supported by the POSIX transports
+      fprintf(stderr, "energymon_init_shmem: Shared memory too small: %zu\n", *size);
+      errno = EPROTO;
+    } else if ((mem = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+      mem = NULL;
+    }
+  }
+  err_save = errno;
+  close(fd);
+  errno = err_save;
+  return mem;
+}
+
+static int detach(energymon_shmem_attachment* att) {
+  int ret;
+  if (att->map_len) {
+    ret = munmap(att->mem.v1, att->map_len);
+  } else {
+    ret = shmdt(att->mem.v1);
+  }
+  if (att->sock >= 0) {
+    close(att->sock);
+  }
+  free(att->channel_offset_uj);
+  return ret;
+}
+
+/**
+ * Attach to the provider's shared memory using the transport selected by the environment.
+ */
+static int attach(energymon_shmem_attachment* att, const char* channel, int verbose) {
+  const char* socket_path = getenv(ENERGYMON_SHMEM_SOCKET);
+  const char* name = getenv(ENERGYMON_SHMEM_NAME);
+  size_t size = 0;
+  int err_save;
+  int fd;
+  void* ems;
+
+  att->sock = -1;
+  if (socket_path != NULL || name != NULL) {
+    fd = socket_path != NULL ? recv_fd(socket_path, &att->sock) : shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0 || (ems = map_fd(fd, &size, &att->mem_id)) == NULL) {
+      err_save = errno;
+      if (att->sock >= 0) {
+        close(att->sock);
+      }
+      errno = err_save;
+      return -1;
+    }
+    att->map_len = size;
+  } else {
+    ems = attach_sysv(&size, &att->mem_id);
+    if (ems == NULL || ems == (void*) -1) {
+      return -1;
+    }
+  }
+  if (size == sizeof(energymon_shmem) && att->map_len == 0) {
+    att->mem.v1 = ems;
+    att->version = 1;
+  } else if (size >= sizeof(energymon_shmem_v2)) {
+    att->mem.v2 = ems;
+    att->version = 2;
+  } else {
+    LOG(verbose, "energymon_init_shmem: Unrecognized shared memory size: %zu\n", size);
+    errno = EPROTO;
+  }
+  if (att->version == 0 || (att->version == 2 && check_v2(att->mem.v2, size, verbose)) ||
+      (channel != NULL && select_channel(att, channel, verbose))) {
+    err_save = errno;
+    att->mem.v1 = ems;
+    detach(att);
+    errno = err_save;
+    return -1;
+  }
+
+  if (att->version == 2) {
+    att->ring = get_ring(att->mem.v2, att->selected_index);
+    // an idle provider may be polling slowly
+    if (att->mem.v2->flags & ENERGYMON_SHMEM_FLAG_ATTACH_WAKE) {
+      energymon_futex_wake(&att->mem.v2->attach_futex);
+    }
+  }
   return 0;
 }
 
+int energymon_init_shmem(energymon* em) {
+  if (em == NULL || em->state != NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  const char* channel = getenv(ENERGYMON_SHMEM_CHANNEL);
+  energymon_shmem_state* state;
+
+  if ((state = calloc(1, sizeof(energymon_shmem_state))) == NULL) {
+    return -1;
+  }
+  if ((channel != NULL && (state->channel = strdup(channel)) == NULL) ||
+      (state->att = calloc(1, sizeof(energymon_shmem_attachment))) == NULL ||
+      attach(state->att, channel, 1)) {
+    free(state->att);
+    free(state->channel);
+    free(state);
+    return -1;
+  }
+  em->state = state;
+  return 0;
+}
+
+static energymon_shmem_attachment* get_attachment(const energymon_shmem_state* state) {
+  return __atomic_load_n(&state->att, __ATOMIC_ACQUIRE);
+}
+
+static int is_retired(const energymon_shmem_v2* ems) {
+  return (__atomic_load_n(&ems->flags, __ATOMIC_ACQUIRE) & ENERGYMON_SHMEM_FLAG_RETIRED) != 0;
+}
+
+/**
+ * Returns -1 if the provider didn't finish an update in time, e.g., because it died during one, in which case the data
+ * is still loaded, but may be inconsistent.
+ */
+static int read_data(const uint32_t* seqp, const uint64_t* energy_ujp, const uint64_t* update_time_nsp,
+                     uint64_t* energy_uj, uint64_t* update_time_ns) {
+  // the seq field is the seqlock's only member
+  const energymon_seqlock* sl = (const energymon_seqlock*) seqp;
+  uint32_t seq;
+  int ret;
+  do {
+    ret = energymon_seqlock_try_read_begin(sl, &seq);
+    *energy_uj = energymon_seqlock_load(energy_ujp);
+    *update_time_ns = energymon_seqlock_load(update_time_nsp);
+  } while (ret == 0 && energymon_seqlock_read_retry(sl, seq));
+  return ret;
+}
+
+static int read_channel(const energymon_shmem_attachment* att, size_t channel, uint64_t* energy_uj,
+                        uint64_t* update_time_ns) {
+  const energymon_shmem_channel* ch = get_channel(att->mem.v2, channel);
+  int ret = read_data(&ch->seq, &ch->energy_uj, &ch->update_time_ns, energy_uj, update_time_ns);
+  *energy_uj += att->channel_offset_uj != NULL ? att->channel_offset_uj[channel] : 0;
+  return ret;
+}
+
+static int read_selected(const energymon_shmem_attachment* att, uint64_t* energy_uj, uint64_t* update_time_ns) {
+  const energymon_shmem_channel* ch = att->selected;
+  int ret;
+  if (ch == NULL) {
+    ret = read_data(&att->mem.v2->seq, &att->mem.v2->energy_uj, &att->mem.v2->update_time_ns, energy_uj,
+                    update_time_ns);
+  } else {
+    ret = read_data(&ch->seq, &ch->energy_uj, &ch->update_time_ns, energy_uj, update_time_ns);
+  }
+  *energy_uj += att->offset_uj;
+  return ret;
+}
+
+/**
+ * The channel with the power fields for the energymon interface, or NULL if the provider doesn't publish power.
+ */
+static const energymon_shmem_channel* get_power_channel(const energymon_shmem_attachment* att) {
+  if (att->version == 1 || !(att->mem.v2->flags & ENERGYMON_SHMEM_FLAG_POWER) || att->mem.v2->n_channels == 0) {
+    return NULL;
+  }
+  // the v2 data mirrors the first channel
+  return att->selected != NULL ? att->selected : get_channel(att->mem.v2, 0);
+}
+
+/**
+ * Attach to the successor of a provider that has exited or been replaced.
+ * Offsets are carried over by channel name, so that energy values continue from where the old provider left off, even
+ * if the successor didn't persist its predecessor's totals.
+ */
+static int reattach(energymon_shmem_state* state, energymon_shmem_attachment* old) {
+  energymon_shmem_attachment* att;
+  const energymon_shmem_channel* ch;
+  uint64_t update_time_ns;
+  uint64_t old_uj;
+  uint64_t new_uj;
+  uint32_t i;
+  uint32_t j;
+  if ((att = calloc(1, sizeof(energymon_shmem_attachment))) == NULL) {
+    return -1;
+  }
+  // the old provider's shared memory is still there if it crashed (or is hung) and nothing has replaced it yet
+  if (attach(att, state->channel, 0)) {
+    free(att);
+    return -1;
+  }
+  if (att->version != 2 || att->mem_id == old->mem_id || is_retired(att->mem.v2) ||
+      (att->mem.v2->n_channels > 0 &&
+       (att->channel_offset_uj = calloc(att->mem.v2->n_channels, sizeof(uint64_t))) == NULL)) {
+    detach(att);
+    free(att);
+    return -1;
+  }
+  for (i = 0; i < att->mem.v2->n_channels; i++) {
+    ch = get_channel(att->mem.v2, i);
+    for (j = 0; j < old->mem.v2->n_channels; j++) {
+      if (!strncmp(ch->name, get_channel(old->mem.v2, j)->name, sizeof(ch->name))) {
+        read_channel(old, j, &old_uj, &update_time_ns);
+        read_channel(att, i, &new_uj, &update_time_ns);
+        att->channel_offset_uj[i] = old_uj > new_uj ? old_uj - new_uj : 0;
+        break;
+      }
+    }
+  }
+  // if the old provider died during an update, its values may be inconsistent, but that's the best there is
+  read_selected(old, &old_uj, &update_time_ns);
+  read_selected(att, &new_uj, &update_time_ns);
+  att->offset_uj = old_uj > new_uj ? old_uj - new_uj : 0;
+  att->prev = old;
+  __atomic_store_n(&state->att, att, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * Whether a provider that hasn't retired has stopped updating, e.g., because it crashed.
+ */
+static int is_orphaned(const energymon_shmem_attachment* att, uint64_t update_time_ns) {
+  uint64_t interval_us = att->selected != NULL ? att->selected->interval_us : att->mem.v2->interval_us;
+  struct pollfd pfd;
+  if (energymon_gettime_ns() < update_time_ns + STALE_NS + 2 * interval_us * 1000) {
+    return 0;
+  }
+  if (att->sock < 0) {
+    // a hung provider looks the same, but reattaching only succeeds once something else has replaced its memory
+    return 1;
+  }
+  // the provider never sends anything after the memory file, so readable means it closed the connection - don't
+  // reconnect to a provider that's merely hung, which would block waiting for a new memory file
+  pfd.fd = att->sock;
+  pfd.events = POLLIN;
+  return poll(&pfd, 1, 0) > 0;
+}
+
+/**
+ * Look for the successor of a provider that has retired or stopped updating.
+ * Returns the current attachment, which is only different from att if the consumer reattached.
+ */
+static const energymon_shmem_attachment* find_successor(const energymon_shmem_state* cstate,
+                                                        const energymon_shmem_attachment* att) {
+  // nothing here is on the read path, so concurrent readers only contend for these fields while orphaned
+  energymon_shmem_state* state = (energymon_shmem_state*) cstate;
+  energymon_shmem_attachment* cur;
+  uint64_t now_ns;
+  // another thread may have already reattached
+  if ((cur = get_attachment(state)) != att) {
+    return cur;
+  }
+  // look for a successor periodically, and only in one thread at a time
+  now_ns = energymon_gettime_ns();
+  if (now_ns < __atomic_load_n(&state->next_attach_ns, __ATOMIC_RELAXED) ||
+      __atomic_exchange_n(&state->reattaching, 1, __ATOMIC_ACQUIRE)) {
+    return att;
+  }
+  __atomic_store_n(&state->next_attach_ns, now_ns + REATTACH_INTERVAL_NS, __ATOMIC_RELAXED);
+  // only one thread reattaches at a time, so nobody else modifies the chain of replaced attachments
+  if (get_attachment(state) == cur) {
+    reattach(state, cur);
+  }
+  __atomic_store_n(&state->reattaching, 0, __ATOMIC_RELEASE);
+  return get_attachment(state);
+}
+
+/**
+ * Check that the provider is still alive after a read, and look for its successor if it isn't.
+ * Returns the attachment to read from, which is only different from att if the consumer reattached.
+ *
+ * A provider that exits cleanly (or is replaced) sets ENERGYMON_SHMEM_FLAG_RETIRED, which is the only shared memory
+ * that reads check.
+ * A crashed provider just stops updating, so each thread counts its consecutive reads without an update, and checks
+ * if the data is stale at exponentially increasing counts (and at least every PROBE_READS_MAX reads), so fast readers
+ * rarely pay for a clock read.
+ * The count starts over whenever a thread switches between energymon instances, so a thread that alternates between
+ * them only detects a crash when the provider's successor retires the crashed provider's memory.
+ */
+static const energymon_shmem_attachment* check_provider(const energymon_shmem_state* state,
+                                                        const energymon_shmem_attachment* att,
+                                                        uint64_t update_time_ns) {
+  uint64_t n;
+  if (is_retired(att->mem.v2)) {
+    return find_successor(state, att);
+  }
+  if (probe.att != att || probe.update_time_ns != update_time_ns) {
+    probe.att = att;
+    probe.update_time_ns = update_time_ns;
+    probe.unchanged_reads = 0;
+    return att;
+  }
+  n = ++probe.unchanged_reads;
+  if (((n & (n - 1)) && (n & (PROBE_READS_MAX - 1))) || !is_orphaned(att, update_time_ns)) {
+    return att;
+  }
+  return find_successor(state, att);
+}
+
+/**
+ * Read the selected data from the current (v2) provider, and follow the provider if it has restarted.
+ * Returns the attachment that was read, or NULL if the provider didn't finish an update in time (errno is EAGAIN),
+ * e.g., because it died during one and no successor has replaced its memory yet.
+ */
+static const energymon_shmem_attachment* read_current(const energymon_shmem_state* state, uint64_t* energy_uj,
+                                                      uint64_t* update_time_ns) {
+  const energymon_shmem_attachment* att = get_attachment(state);
+  const energymon_shmem_attachment* cur;
+  if (read_selected(att, energy_uj, update_time_ns)) {
+    // a successor has to replace the memory of a provider that died during an update
+    if ((cur = find_successor(state, att)) == att) {
+      errno = EAGAIN;
+      return NULL;
+    }
+  } else if ((cur = check_provider(state, att, *update_time_ns)) == att) {
+    return att;
+  }
+  if (read_selected(cur, energy_uj, update_time_ns)) {
+    errno = EAGAIN;
+    return NULL;
+  }
+  return cur;
+}
+
 uint64_t energymon_read_total_shmem(const energymon* em) {
   if (em == NULL || em->state == NULL) {
     errno = EINVAL;
     return 0;
   }
+  uint64_t update_time_ns;
+  uint64_t energy_uj;
+  const energymon_shmem_state* state = (energymon_shmem_state*) em->state;
+  const energymon_shmem_attachment* att = get_attachment(state);
+  errno = 0;
+  if (att->version == 1) {
+    return att->mem.v1->energy_uj;
+  }
+  if (read_current(state, &energy_uj, &update_time_ns) == NULL) {
+    return 0;
+  }
   errno = 0;
-  return ((energymon_shmem*) em->state)->energy_uj;
+  return energy_uj;
+}
+
+int energymon_get_view_shmem(const energymon* em, energymon_shmem_view* view) {
+  if (em == NULL || em->state == NULL || view == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  energymon_shmem_attachment* att = get_attachment((energymon_shmem_state*) em->state);
+  const energymon_shmem_channel* ch = get_power_channel(att);
+  view->power_uw = ch != NULL ? &ch->power_uw : NULL;
+  view->power_seq = ch != NULL ? &ch->seq : NULL;
+  view->offset_uj = att->offset_uj;
+  if (att->version == 1) {
+    view->seq = NULL;
+    view->energy_uj = (const uint64_t*) &att->mem.v1->energy_uj;
+    view->update_time_ns = NULL;
+  } else if (att->selected == NULL) {
+    view->seq = &att->mem.v2->seq;
+    view->energy_uj = &att->mem.v2->energy_uj;
+    view->update_time_ns = &att->mem.v2->update_time_ns;
+  } else {
+    view->seq = &att->selected->seq;
+    view->energy_uj = &att->selected->energy_uj;
+    view->update_time_ns = &att->selected->update_time_ns;
+  }
+  return 0;
 }
 
 int energymon_finish_shmem(energymon* em) {
@@ -75,10 +643,21 @@ int energymon_finish_shmem(energymon* em) {
     errno = EINVAL;
     return -1;
   }
-  energymon_shmem* state = (energymon_shmem*) em->state;
+  energymon_shmem_state* state = (energymon_shmem_state*) em->state;
+  energymon_shmem_attachment* att = state->att;
+  energymon_shmem_attachment* prev;
+  int ret = 0;
   em->state = NULL;
   // detach from shared memory
-  return shmdt(state);
+  while (att != NULL) {
+    prev = att->prev;
+    ret |= detach(att);
+    free(att);
+    att = prev;
+  }
+  free(state->channel);
+  free(state);
+  return ret;
 }
 
 char* energymon_get_source_shmem(char* buffer, size_t n) {
@@ -90,7 +669,11 @@ uint64_t energymon_get_interval_shmem(const energymon* em) {
     errno = EINVAL;
     return 0;
   }
-  return ((energymon_shmem*) em->state)->interval_us;
+  const energymon_shmem_attachment* att = get_attachment((energymon_shmem_state*) em->state);
+  if (att->version == 1) {
+    return att->mem.v1->interval_us;
+  }
+  return att->selected != NULL ? att->selected->interval_us : att->mem.v2->interval_us;
 }
 
 uint64_t energymon_get_precision_shmem(const energymon* em) {
@@ -98,13 +681,212 @@ uint64_t energymon_get_precision_shmem(const energymon* em) {
     errno = EINVAL;
     return 0;
   }
-  return ((energymon_shmem*) em->state)->precision_uj;
+  const energymon_shmem_attachment* att = get_attachment((energymon_shmem_state*) em->state);
+  if (att->version == 1) {
+    return att->mem.v1->precision_uj;
+  }
+  return att->selected != NULL ? att->selected->precision_uj : att->mem.v2->precision_uj;
 }
 
 int energymon_is_exclusive_shmem(void) {
   return 0;
 }
 
+uint64_t energymon_get_update_time_shmem(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  uint64_t update_time_ns;
+  uint64_t energy_uj;
+  const energymon_shmem_state* state = (energymon_shmem_state*) em->state;
+  const energymon_shmem_attachment* att = get_attachment(state);
+  if (att->version == 1) {
+    errno = ENOTSUP;
+    return 0;
+  }
+  if ((att = read_current(state, &energy_uj, &update_time_ns)) == NULL) {
+    return 0;
+  }
+  // only a provider that exits cleanly says so - staleness is left to the caller, who knows how old is too old
+  if (is_retired(att->mem.v2)) {
+    errno = ESRCH;
+    return 0;
+  }
+  errno = 0;
+  return update_time_ns;
+}
+
+int energymon_read_power_shmem(const energymon* em, energymon_shmem_power* power) {
+  if (em == NULL || em->state == NULL || power == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  const energymon_shmem_state* state = (energymon_shmem_state*) em->state;
+  const energymon_shmem_attachment* att = get_attachment(state);
+  const energymon_shmem_channel* ch;
+  const energymon_seqlock* sl;
+  uint64_t energy_uj;
+  uint32_t seq;
+  size_t i;
+  if ((ch = get_power_channel(att)) != NULL) {
+    if ((att = read_current(state, &energy_uj, &power->update_time_ns)) == NULL) {
+      return -1;
+    }
+    ch = get_power_channel(att);
+  }
+  if (ch == NULL) {
+    errno = ENOTSUP;
+    return -1;
+  }
+  // the seq field is the seqlock's only member
+  sl = (const energymon_seqlock*) &ch->seq;
+  do {
+    if (energymon_seqlock_try_read_begin(sl, &seq)) {
+      errno = EAGAIN;
+      return -1;
+    }
+    power->power_uw = energymon_seqlock_load(&ch->power_uw);
+    power->min_power_uw = energymon_seqlock_load(&ch->min_power_uw);
+    power->max_power_uw = energymon_seqlock_load(&ch->max_power_uw);
+    for (i = 0; i < ENERGYMON_SHMEM_EWMA_MAX; i++) {
+      power->ewma_power_uw[i] = energymon_seqlock_load(&ch->ewma_power_uw[i]);
+    }
+    power->update_time_ns = energymon_seqlock_load(&ch->update_time_ns);
+  } while (energymon_seqlock_read_retry(sl, seq));
+  for (i = 0; i < ENERGYMON_SHMEM_EWMA_MAX; i++) {
+    power->ewma_window_us[i] = ch->ewma_window_us[i];
+  }
+  errno = 0;
+  return 0;
+}
+
+uint32_t energymon_get_generation_shmem(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  const energymon_shmem_attachment* att = get_attachment((energymon_shmem_state*) em->state);
+  if (att->version == 1) {
+    errno = ENOTSUP;
+    return 0;
+  }
+  errno = 0;
+  return att->mem.v2->generation;
+}
+
+uint64_t energymon_wait_shmem(const energymon* em, uint64_t last_update_ns, uint64_t timeout_us) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  const energymon_shmem_state* state = (energymon_shmem_state*) em->state;
+  const energymon_shmem_attachment* att = get_attachment(state);
+  const int ignore_interrupt = 0;
+  const uint32_t* futex;
+  uint64_t update_time_ns;
+  uint64_t energy_uj;
+  uint64_t deadline_ns;
+  uint64_t wait_ns;
+  uint64_t now_ns;
+  uint32_t val;
+  int stuck;
+  if (att->version == 1 || !(att->mem.v2->flags & ENERGYMON_SHMEM_FLAG_FUTEX)) {
+    errno = ENOTSUP;
+    return 0;
+  }
+  deadline_ns = energymon_gettime_ns() + timeout_us * 1000;
+  while (1) {
+    att = get_attachment(state);
+    futex = att->selected != NULL ? &att->selected->futex : &att->mem.v2->futex;
+    // load the futex before the data - if an update lands in between, the futex no longer matches and we don't block
+    val = __atomic_load_n(futex, __ATOMIC_ACQUIRE);
+    // a provider that died during an update never finishes it
+    stuck = read_selected(att, &energy_uj, &update_time_ns);
+    if (!stuck && update_time_ns > last_update_ns) {
+      errno = 0;
+      return update_time_ns;
+    }
+    if ((now_ns = energymon_gettime_ns()) >= deadline_ns) {
+      errno = ETIMEDOUT;
+      return 0;
+    }
+    if ((stuck || is_retired(att->mem.v2) || is_orphaned(att, update_time_ns)) && find_successor(state, att) != att) {
+      continue;
+    }
+    // a provider that crashed never wakes us, so wait in slices to look for its successor
+    wait_ns = deadline_ns - now_ns < REATTACH_INTERVAL_NS ? deadline_ns - now_ns : REATTACH_INTERVAL_NS;
+    if (is_retired(att->mem.v2)) {
+      // the provider wakes waiters when it retires - wait for its successor instead
+      if (energymon_sleep_until_ns(now_ns + wait_ns, &ignore_interrupt)) {
+        return 0;
+      }
+    } else if (energymon_futex_wait(futex, val, wait_ns) && errno != ETIMEDOUT) {
+      if (errno == ENOSYS) {
+        errno = ENOTSUP;
+      }
+      return 0;
+    }
+  }
+}
+
+size_t energymon_get_channel_count_shmem(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  const energymon_shmem_attachment* att = get_attachment((energymon_shmem_state*) em->state);
+  if (att->version == 1) {
+    errno = ENOTSUP;
+    return 0;
+  }
+  return att->mem.v2->n_channels;
+}
+
+char* energymon_get_channel_name_shmem(const energymon* em, size_t channel, char* buffer, size_t n) {
+  if (em == NULL || em->state == NULL || buffer == NULL || n == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  const energymon_shmem_attachment* att = get_attachment((energymon_shmem_state*) em->state);
+  const energymon_shmem_channel* ch;
+  if (att->version == 1 || channel >= att->mem.v2->n_channels) {
+    errno = EINVAL;
+    return NULL;
+  }
+  ch = get_channel(att->mem.v2, channel);
+  // don't trust the provider to have null-terminated the name
+  return energymon_strencpy(buffer, ch->name, n < sizeof(ch->name) ? n : sizeof(ch->name));
+}
+
+uint64_t energymon_read_channels_shmem(const energymon* em, uint64_t* energy_uj, size_t n) {
+  if (em == NULL || em->state == NULL || (energy_uj == NULL && n > 0)) {
+    errno = EINVAL;
+    return 0;
+  }
+  const energymon_shmem_state* state = (energymon_shmem_state*) em->state;
+  const energymon_shmem_attachment* att = get_attachment(state);
+  uint64_t update_time_ns;
+  uint64_t total_uj;
+  size_t i;
+  if (att->version == 1) {
+    errno = ENOTSUP;
+    return 0;
+  }
+  // the channel table may change if the provider restarted, so read it all from the current provider
+  if ((att = read_current(state, &total_uj, &update_time_ns)) == NULL) {
+    return 0;
+  }
+  for (i = 0; i < n && i < att->mem.v2->n_channels; i++) {
+    if (read_channel(att, i, &energy_uj[i], &update_time_ns)) {
+      errno = EAGAIN;
+      return 0;
+    }
+  }
+  errno = 0;
+  return total_uj;
+}
+
 int energymon_get_shmem(energymon* em) {
   if (em == NULL) {
     errno = EINVAL;
@@ -120,3 +902,76 @@ int energymon_get_shmem(energymon* em) {
   em->state = NULL;
   return 0;
 }
+
+static int read_slot(const energymon_shmem_attachment* att, uint64_t seq, energymon_shmem_sample* sample) {
+  const energymon_shmem_v2* ems = att->mem.v2;
+  const energymon_shmem_ring_slot* slot =
+    (const energymon_shmem_ring_slot*) (att->ring + (seq & (ems->ring_len - 1)) * ems->ring_slot_size);
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq) {
+    return -1;
+  }
+  sample->time_ns = energymon_seqlock_load(&slot->time_ns);
+  sample->energy_uj = energymon_seqlock_load(&slot->energy_uj);
+  // order the data loads before the sequence re-check
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+    return -1;
+  }
+  sample->seq = seq;
+  sample->energy_uj += att->offset_uj;
+  return 0;
+}
+
+size_t energymon_read_samples_shmem(const energymon* em, uint64_t since, energymon_shmem_sample* samples, size_t n) {
+  if (em == NULL || em->state == NULL || (samples == NULL && n > 0)) {
+    errno = EINVAL;
+    return 0;
+  }
+  const energymon_shmem_attachment* att = get_attachment((energymon_shmem_state*) em->state);
+  const energymon_shmem_channel* ch;
+  uint64_t head;
+  uint64_t oldest;
+  size_t count = 0;
+  if (att->ring == NULL) {
+    errno = ENOTSUP;
+    return 0;
+  }
+  ch = get_channel(att->mem.v2, att->selected_index);
+  if (since == 0) {
+    since = 1;
+  }
+  while (count < n) {
+    head = __atomic_load_n(&ch->ring_head, __ATOMIC_ACQUIRE);
+    if (since > head) {
+      break;
+    }
+    // skip samples that have been overwritten
+    oldest = head >= att->mem.v2->ring_len ? head - att->mem.v2->ring_len + 1 : 1;
+    if (since < oldest) {
+      since = oldest;
+    }
+    // a slot that doesn't hold the sample has been (or is being) overwritten by a newer one, so the sample is gone -
+    // skip it rather than wait for the next head, which never comes if the provider died while overwriting it
+    if (read_slot(att, since, &samples[count]) == 0) {
+      count++;
+    }
+    since++;
+  }
+  errno = 0;
+  return count;
+}
+
+size_t energymon_read_last_samples_shmem(const energymon* em, energymon_shmem_sample* samples, size_t n) {
+  if (em == NULL || em->state == NULL || (samples == NULL && n > 0)) {
+    errno = EINVAL;
+    return 0;
+  }
+  const energymon_shmem_attachment* att = get_attachment((energymon_shmem_state*) em->state);
+  uint64_t head;
+  if (att->ring == NULL) {
+    errno = ENOTSUP;
+    return 0;
+  }
+  head = __atomic_load_n(&get_channel(att->mem.v2, att->selected_index)->ring_head, __ATOMIC_ACQUIRE);
+  return energymon_read_samples_shmem(em, head >= n ? head - n + 1 : 1, samples, n);
+}
@@ -15,17 +15,172 @@ extern "C" {
 #include <stddef.h>
 #include "energymon.h"
 
+/* Select a channel by name to use for the energymon interface, rather than the first channel */
+#define ENERGYMON_SHMEM_CHANNEL "ENERGYMON_SHMEM_CHANNEL"
+
+/*
+ * By default, the System V shared memory transport is used, with a key created by ftok(3) from the directory and ID
+ * environment variables.
+ * Set ENERGYMON_SHMEM_NAME to instead open a POSIX shared memory object, as created by shm_open(3), e.g.,
+ * "/energymon".
+ * Set ENERGYMON_SHMEM_SOCKET to instead receive an anonymous memory file (memfd) from a provider listening on a Unix
+ * domain socket at the given path.
+ * The POSIX transports only support the v2 layout.
+ */
+#define ENERGYMON_SHMEM_NAME "ENERGYMON_SHMEM_NAME"
+#define ENERGYMON_SHMEM_SOCKET "ENERGYMON_SHMEM_SOCKET"
 #define ENERGYMON_SHMEM_DIR "ENERGYMON_SHMEM_DIR"
 #define ENERGYMON_SHMEM_DIR_DEFAULT "."
 #define ENERGYMON_SHMEM_ID "ENERGYMON_SHMEM_ID"
 #define ENERGYMON_SHMEM_ID_DEFAULT 1
 
+/**
+ * The original (v1) shared memory layout, which is still supported by the consumer.
+ * There's no versioning, consistency protocol, or timestamp, so new providers should use energymon_shmem_v2.
+ */
 typedef struct energymon_shmem {
   volatile uint64_t interval_us;
   volatile uint64_t precision_uj;
   volatile uint64_t energy_uj;
 } energymon_shmem;
 
+/* ASCII "ENRGYMON" when stored in little-endian byte order */
+#define ENERGYMON_SHMEM_MAGIC 0x4E4F4D5947524E45ULL
+#define ENERGYMON_SHMEM_ABI_VERSION 2
+#define ENERGYMON_SHMEM_CACHE_LINE_SIZE 64
+
+/* The maximum channel name length, including the null terminator */
+#define ENERGYMON_SHMEM_CHANNEL_NAME_LEN 48
+/* The maximum number of EWMA power windows per channel */
+#define ENERGYMON_SHMEM_EWMA_MAX 4
+
+/* energymon_shmem_v2 flags */
+/* The provider increments each futex field after every update and wakes waiters if consumers are attached (Linux) */
+#define ENERGYMON_SHMEM_FLAG_FUTEX 0x1
+/* Consumers wake attach_futex after attaching, so that an idle provider resumes polling immediately (Linux only) */
+#define ENERGYMON_SHMEM_FLAG_ATTACH_WAKE 0x2
+/*
+ * Set by a provider that has exited or been replaced, after its final update - consumers attach to its successor.
+ * Providers also set it on shared memory left behind by one that crashed before replacing it.
+ */
+#define ENERGYMON_SHMEM_FLAG_RETIRED 0x4
+/* Channels include the derived power fields, computed by the provider from consecutive updates */
+#define ENERGYMON_SHMEM_FLAG_POWER 0x8
+
+/**
+ * The v2 shared memory layout.
+ * The consumer distinguishes it from v1 by the segment size, then verifies the magic number and ABI version.
+ * It's immediately followed by a table of n_channels energymon_shmem_channel entries, each channel_size bytes.
+ * If ring_len > 0, the channel table is followed by a sample ring for each channel (in the same order), each with
+ * ring_len energymon_shmem_ring_slot entries of ring_slot_size bytes.
+ *
+ * The header is written once by the provider, which stores the magic number last (with release semantics) to mark
+ * the header as complete.
+ * The only later change is ENERGYMON_SHMEM_FLAG_RETIRED, which is set atomically in flags.
+ * The data is written with a sequence lock: the provider increments seq to an odd value, writes the data fields,
+ * then increments seq to an even value (with release semantics).
+ * Readers load seq, then the data fields, then seq again, and retry if seq was odd or changed.
+ * If ENERGYMON_SHMEM_FLAG_FUTEX is set, the provider then increments futex (with release semantics) and wakes any
+ * processes waiting on it with FUTEX_WAIT, so consumers can block until the next update.
+ * Consumers only wait while attached, so the provider skips the wake while it knows that none are (with System V
+ * shared memory or a socket), checking again after the update to wake any consumer that attached in between.
+ * The header and data are on separate cache lines so that reading static fields doesn't contend with updates.
+ */
+typedef struct energymon_shmem_v2 {
+  // header, written once by the provider
+  uint64_t magic;
+  uint32_t abi_version;
+  // the provider's process ID, which a new provider uses to tell if shared memory it finds is still in use
+  // (consumers don't, since it's meaningless in other PID namespaces)
+  int32_t pid;
+  uint64_t interval_us;
+  uint64_t precision_uj;
+  // the channel table that follows this struct
+  uint32_t n_channels;
+  uint32_t channel_size;
+  // ENERGYMON_SHMEM_FLAG_*
+  uint32_t flags;
+  // the sample rings that follow the channel table - ring_len is 0 or a power of 2
+  uint32_t ring_len;
+  uint32_t ring_slot_size;
+  // never modified - the provider waits on it while idle, see ENERGYMON_SHMEM_FLAG_ATTACH_WAKE
+  uint32_t attach_futex;
+  // 1 for the first provider at this location, incremented by each provider that replaces one (0 if not supported)
+  uint32_t generation;
+  uint8_t header_reserved[ENERGYMON_SHMEM_CACHE_LINE_SIZE - 60];
+  // data, protected by seq - mirrors the first channel
+  uint32_t seq;
+  // incremented after each update, see ENERGYMON_SHMEM_FLAG_FUTEX
+  uint32_t futex;
+  uint64_t energy_uj;
+  // CLOCK_MONOTONIC time of the last update
+  uint64_t update_time_ns;
+  uint8_t data_reserved[ENERGYMON_SHMEM_CACHE_LINE_SIZE - 24];
+} energymon_shmem_v2;
+
+/**
+ * A channel in the v2 channel table, e.g., a backend's total energy or one of its domains/rails.
+ * A provider may host multiple energymon implementations and update each one's channels on its own interval.
+ * Each channel's data has its own sequence lock, with the same protocol as energymon_shmem_v2.
+ *
+ * If ENERGYMON_SHMEM_FLAG_POWER is set, the provider also publishes power derived from each pair of consecutive
+ * updates (energy difference over the difference in update times), under the same sequence lock.
+ * Power fields are 0 until the second update.
+ * Providers that don't set the flag may use a shorter channel_size that ends before ewma_power_uw.
+ */
+typedef struct energymon_shmem_channel {
+  // data, protected by seq
+  uint32_t seq;
+  // incremented after each update, see ENERGYMON_SHMEM_FLAG_FUTEX
+  uint32_t futex;
+  uint64_t energy_uj;
+  // CLOCK_MONOTONIC time of the last update
+  uint64_t update_time_ns;
+  // the sequence number of the newest sample in the channel's ring (0 if none), stored with release semantics
+  uint64_t ring_head;
+  // power over the last update interval
+  uint64_t power_uw;
+  // the minimum and maximum of power_uw since the provider started
+  uint64_t min_power_uw;
+  uint64_t max_power_uw;
+  uint8_t data_reserved[ENERGYMON_SHMEM_CACHE_LINE_SIZE - 56];
+  // written once by the provider
+  uint64_t interval_us;
+  uint64_t precision_uj;
+  // null-terminated, e.g., "rapl" for a backend's total, or "rapl:intel-rapl:0:dram" for one of its channels
+  char name[ENERGYMON_SHMEM_CHANNEL_NAME_LEN];
+  // exponentially weighted moving averages of power_uw, protected by seq
+  uint64_t ewma_power_uw[ENERGYMON_SHMEM_EWMA_MAX];
+  // written once by the provider - the time constant of each average, or 0 if unused
+  uint64_t ewma_window_us[ENERGYMON_SHMEM_EWMA_MAX];
+} energymon_shmem_channel;
+
+/**
+ * A slot in a channel's sample ring, written by a single provider and read by any number of consumers without locks.
+ * Samples are numbered from 1 and sample N is stored in slot N % ring_len.
+ * The provider stores 0 to seq, then the data fields, then N to seq (with release semantics), then updates the
+ * channel's ring_head.
+ * Readers load seq, then the data fields, then seq again, and discard the sample if seq wasn't N both times.
+ */
+typedef struct energymon_shmem_ring_slot {
+  uint64_t seq;
+  // CLOCK_MONOTONIC time
+  uint64_t time_ns;
+  uint64_t energy_uj;
+  uint64_t reserved;
+} energymon_shmem_ring_slot;
+
+/**
+ * A sample read from a sample ring.
+ */
+typedef struct energymon_shmem_sample {
+  // the sample's sequence number, starting at 1
+  uint64_t seq;
+  // CLOCK_MONOTONIC time
+  uint64_t time_ns;
+  uint64_t energy_uj;
+} energymon_shmem_sample;
+
 int energymon_init_shmem(energymon* em);
 
 uint64_t energymon_read_total_shmem(const energymon* em);
@@ -42,6 +197,152 @@ int energymon_is_exclusive_shmem(void);
 
 int energymon_get_shmem(energymon* em);
 
+/**
+ * Get the time of the provider's last update.
+ * Compare with the caller's CLOCK_MONOTONIC time to detect stale values - a provider that crashed just stops
+ * updating, so its data is stale once it's more than a few intervals old (see energymon_get_interval_shmem).
+ * Only supported for v2 shared memory, as v1 has no timestamp.
+ *
+ * @param em
+ *  an initialized energymon
+ * @return the provider's CLOCK_MONOTONIC time in nanoseconds of the last update, or 0 on failure (errno is set:
+ *  ESRCH if the provider has retired and no successor has started yet, EAGAIN if the provider didn't finish an update
+ *  in time, e.g., because it died during one, ENOTSUP if the shared memory is v1)
+ */
+uint64_t energymon_get_update_time_shmem(const energymon* em);
+
+/**
+ * Get the generation of the provider that the consumer is currently attached to.
+ * If the provider exits or is replaced, the consumer transparently attaches to its successor on a later read, and
+ * adjusts energy values so they never decrease.
+ * A changed generation means that sample ring sequence numbers have restarted.
+ *
+ * @param em
+ *  an initialized energymon
+ * @return the provider's generation, or 0 on failure (errno is set: ENOTSUP if the shared memory is v1) or if the
+ *  provider doesn't support generations (errno is 0)
+ */
+uint32_t energymon_get_generation_shmem(const energymon* em);
+
+/**
+ * Block until the provider publishes an update newer than last_update_ns, without spinning.
+ * Passing the value returned by energymon_get_update_time_shmem or by a previous call never misses an update, even if
+ * it's published before this function is called.
+ * Updates are for the channel used by the energymon interface (see ENERGYMON_SHMEM_CHANNEL).
+ *
+ * @param em
+ *  an initialized energymon
+ * @param last_update_ns
+ *  the last update time observed by the caller, or 0 to return immediately if data has ever been published
+ * @param timeout_us
+ *  the maximum time to wait, or 0 to check without blocking
+ * @return the new update's CLOCK_MONOTONIC time in nanoseconds, or 0 on failure (errno is set: ETIMEDOUT on timeout,
+ *  EINTR if interrupted by a signal, ENOTSUP if the provider or platform doesn't support waiting)
+ */
+uint64_t energymon_wait_shmem(const energymon* em, uint64_t last_update_ns, uint64_t timeout_us);
+
+/**
+ * Get the number of channels in the shared memory channel table.
+ *
+ * @param em
+ *  an initialized energymon
+ * @return the channel count, or 0 on failure (errno is set: ENOTSUP if the shared memory is v1)
+ */
+size_t energymon_get_channel_count_shmem(const energymon* em);
+
+/**
+ * Get a channel's name, e.g., "rapl:intel-rapl:0:dram".
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_shmem)
+ * @param buffer
+ *  the destination buffer, which will be null-terminated
+ * @param n
+ *  the buffer size
+ * @return pointer to buffer, or NULL on failure (errno is set)
+ */
+char* energymon_get_channel_name_shmem(const energymon* em, size_t channel, char* buffer, size_t n);
+
+/**
+ * Get the energy of the selected channel (as for energymon_read_total_shmem) and of each channel in microjoules.
+ * Each channel is read consistently, but channels may be updated at different times and intervals.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param energy_uj
+ *  array to store per-channel energy values, may be NULL if n is 0
+ * @param n
+ *  the array length - values are written for at most n channels
+ * @return the selected channel's energy (in uJ), or 0 on failure (errno is set: EAGAIN if the provider didn't finish
+ *  an update in time, ENOTSUP if the shared memory is v1)
+ */
+uint64_t energymon_read_channels_shmem(const energymon* em, uint64_t* energy_uj, size_t n);
+
+/**
+ * Power published by the provider for a channel, see ENERGYMON_SHMEM_FLAG_POWER.
+ */
+typedef struct energymon_shmem_power {
+  // power over the provider's last update interval
+  uint64_t power_uw;
+  // the minimum and maximum of power_uw since the provider started
+  uint64_t min_power_uw;
+  uint64_t max_power_uw;
+  // exponentially weighted moving averages of power_uw, with time constants in ewma_window_us (0 if unused)
+  uint64_t ewma_power_uw[ENERGYMON_SHMEM_EWMA_MAX];
+  uint64_t ewma_window_us[ENERGYMON_SHMEM_EWMA_MAX];
+  // CLOCK_MONOTONIC time of the last update
+  uint64_t update_time_ns;
+} energymon_shmem_power;
+
+/**
+ * Read the power that the provider derived for the channel used for the energymon interface, consistently with
+ * its last update.
+ * This avoids computing power from consecutive reads with the consumer's own clock.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param power
+ *  the power
+ * @return 0 on success, -1 on failure (errno is set: EAGAIN if the provider didn't finish an update in time, ENOTSUP
+ *  if the provider doesn't publish power)
+ */
+int energymon_read_power_shmem(const energymon* em, energymon_shmem_power* power);
+
+/**
+ * Read samples from the sample ring of the channel used for the energymon interface, oldest first.
+ * The provider only publishes sample rings if configured to do so.
+ * Samples that have already been overwritten are skipped, which the caller can detect from the first sample's seq.
+ * To read continuously, pass the last returned sample's seq + 1 in the next call.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param since
+ *  the sequence number of the first sample to read (samples are numbered from 1)
+ * @param samples
+ *  array to store samples
+ * @param n
+ *  the array length
+ * @return the number of samples read, or 0 on failure (errno is set: ENOTSUP if there's no sample ring) or if there
+ *  are no new samples (errno is 0)
+ */
+size_t energymon_read_samples_shmem(const energymon* em, uint64_t since, energymon_shmem_sample* samples, size_t n);
+
+/**
+ * Read the most recent samples from the sample ring of the channel used for the energymon interface, oldest first.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param samples
+ *  array to store samples
+ * @param n
+ *  the array length - at most this many of the newest samples are read
+ * @return the number of samples read, or 0 on failure (errno is set: ENOTSUP if there's no sample ring) or if there
+ *  are no samples (errno is 0)
+ */
+size_t energymon_read_last_samples_shmem(const energymon* em, energymon_shmem_sample* samples, size_t n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,6 +21,7 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <time.h>
+#include <unistd.h>
 #include "energymon-default.h"
 #include "../energymon-shmem.h"
 
@@ -45,10 +46,27 @@ static void shandle(int sig) {
   }
 }
 
+static uint64_t gettime_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+}
+
+static void publish(energymon_shmem_v2* ems, uint64_t energy_uj) {
+  // sequence lock: odd while writing, even when done
+  uint32_t seq = __atomic_load_n(&ems->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&ems->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&ems->energy_uj, energy_uj, __ATOMIC_RELAXED);
+  __atomic_store_n(&ems->update_time_ns, gettime_ns(), __ATOMIC_RELAXED);
+  __atomic_store_n(&ems->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
 int main(void) {
   energymon em;
-  energymon_shmem* ems;
+  energymon_shmem_v2* ems;
   struct timespec ts;
+  uint64_t deadline_ns;
   const char* key_proj_id_env;
   const char* key_dir;
   int key_proj_id = ENERGYMON_SHMEM_ID_DEFAULT;
@@ -69,13 +87,13 @@ int main(void) {
 
   // get the shared memory
   mem_key = ftok(key_dir, key_proj_id);
-  shm_id = shmget(mem_key, sizeof(energymon_shmem), 0644 | IPC_CREAT | IPC_EXCL);
+  shm_id = shmget(mem_key, sizeof(energymon_shmem_v2), 0644 | IPC_CREAT | IPC_EXCL);
   if (shm_id < 0) {
     perror("shmget");
     return -errno;
   }
-  ems = (energymon_shmem*) shmat(shm_id, NULL, 0);
-  if (ems == (energymon_shmem*) -1) {
+  ems = (energymon_shmem_v2*) shmat(shm_id, NULL, 0);
+  if (ems == (energymon_shmem_v2*) -1) {
     perror("shmat");
     return -errno;
   }
@@ -92,18 +110,27 @@ int main(void) {
     return -errno;
   }
   
-  // store the interval in shared memory
+  // store the header in shared memory
+  ems->abi_version = ENERGYMON_SHMEM_ABI_VERSION;
+  ems->pid = (int32_t) getpid();
   ems->interval_us = em.finterval(&em);
-  ts.tv_sec = (time_t) (ems->interval_us / (uint64_t) 1000000);
-  ts.tv_nsec = (long) ((ems->interval_us % (uint64_t) 1000000) * (uint64_t) 1000);
-
-  // store the precision in shared memory
   ems->precision_uj = em.fprecision(&em);
+  publish(ems, em.fread(&em));
+  // the magic number is stored last to mark the header as complete
+  __atomic_store_n(&ems->magic, ENERGYMON_SHMEM_MAGIC, __ATOMIC_RELEASE);
 
+  deadline_ns = gettime_ns();
   while (running) {
+    // sleep until an absolute deadline so the update period doesn't drift, but don't try to catch up if we fell behind
+    deadline_ns += ems->interval_us * 1000;
+    if (deadline_ns < gettime_ns()) {
+      deadline_ns = gettime_ns() + ems->interval_us * 1000;
+    }
+    ts.tv_sec = (time_t) (deadline_ns / (uint64_t) 1000000000);
+    ts.tv_nsec = (long) (deadline_ns % (uint64_t) 1000000000);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
     // update the energy in shared memory
-    ems->energy_uj = em.fread(&em);
-    nanosleep(&ts, NULL);
+    publish(ems, em.fread(&em));
   }
 
   errno = 0;
@@ -0,0 +1,619 @@
+/**
+ * Serve EnergyMon readings to energymon-socket clients over a Unix domain socket.
+ * Clients can share any backend this way, including exclusive ones, and it's straightforward to mount a socket into
+ * containers.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "energymon.h"
+#include "energymon-seqlock.h"
+#include "energymon-shmem-backends.h"
+#include "energymon-socket.h"
+#include "energymon-time-util.h"
+
+typedef struct server_client {
+  int fd;
+  // a partially received request
+  energymon_socket_msg req;
+  size_t req_len;
+  int subscribed;
+  uint32_t sub_channel;
+  uint64_t sub_interval_ns;
+  uint64_t sub_next_ns;
+  // whether the client requested the memory file
+  int mapped;
+} server_client;
+
+static volatile int running = 1;
+static const energymon_shmem_backend* backend = NULL;
+static energymon em;
+static int em_initialized = 0;
+static uint64_t interval_us;
+static uint64_t precision_uj;
+// channel 0 is the total, followed by the backend's channels (if any)
+static size_t n_channels;
+static uint64_t* channel_uj = NULL;
+static const char* socket_path = NULL;
+static int listen_fd = -1;
+static server_client* clients = NULL;
+static size_t n_clients = 0;
+// the memory file, created when the first client requests it
+static int mem_fd = -1;
+static energymon_socket_slot* slots = NULL;
+static size_t map_len = 0;
+static uint64_t publish_next_ns = 0;
+
+static const char short_options[] = "hb:ls:";
+static const struct option long_options[] = {
+  {"help",      no_argument,       NULL, 'h'},
+  {"backend",   required_argument, NULL, 'b'},
+  {"list",      no_argument,       NULL, 'l'},
+  {"socket",    required_argument, NULL, 's'},
+  {0, 0, 0, 0}
+};
+
+__attribute__ ((noreturn))
+static void print_usage(int exit_code) {
+  fprintf(exit_code ? stderr : stdout,
+          "Usage: energymon-server [OPTION]...\n\n"
+          "Serve EnergyMon readings over a Unix domain socket, e.g., for use by\n"
+          "libenergymon-socket.\n\n"
+          "Clients can request readings, subscribe to periodic samples, and map a memory\n"
+          "file that the server keeps up to date. The backend's total energy is channel\n"
+          "0, followed by the backend's channels, if it has any.\n\n"
+          "Options:\n"
+          "  -h, --help               Print this message and exit\n"
+          "  -b, --backend=NAME       Serve the named EnergyMon implementation\n"
+          "                           Required if more than one is built\n"
+          "  -l, --list               Print the available backends and exit\n"
+          "  -s, --socket=PATH        The socket path (default = $"ENERGYMON_SOCKET", or\n"
+          "                           \"%s\" if not set)\n",
+          ENERGYMON_SOCKET_DEFAULT);
+  exit(exit_code);
+}
+
+static void print_backends(void) {
+  size_t i;
+  for (i = 0; i < energymon_shmem_backends_len; i++) {
+    printf("%s\n", energymon_shmem_backends[i].name);
+  }
+  exit(0);
+}
+
+static void set_backend(const char* arg) {
+  size_t i;
+  for (i = 0; i < energymon_shmem_backends_len; i++) {
+    if (!strcmp(energymon_shmem_backends[i].name, arg)) {
+      backend = &energymon_shmem_backends[i];
+      return;
+    }
+  }
+  fprintf(stderr, "Unknown backend: %s\n", arg);
+  print_usage(EINVAL);
+}
+
+static void parse_args(int argc, char** argv) {
+  int c;
+  while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+    switch (c) {
+      case 'h':
+        print_usage(0);
+        break;
+      case 'b':
+        set_backend(optarg);
+        break;
+      case 'l':
+        print_backends();
+        break;
+      case 's':
+        socket_path = optarg;
+        break;
+      case '?':
+      default:
+        print_usage(EINVAL);
+        break;
+    }
+  }
+  if (backend == NULL) {
+    if (energymon_shmem_backends_len != 1) {
+      fprintf(stderr, "Must specify a backend\n");
+      print_usage(EINVAL);
+    }
+    backend = &energymon_shmem_backends[0];
+  }
+  if (socket_path == NULL && (socket_path = getenv(ENERGYMON_SOCKET)) == NULL) {
+    socket_path = ENERGYMON_SOCKET_DEFAULT;
+  }
+}
+
+static void shandle(int sig) {
+  switch (sig) {
+    case SIGTERM:
+    case SIGINT:
+#ifdef SIGQUIT
+    case SIGQUIT:
+#endif
+#ifdef SIGHUP
+    case SIGHUP:
+#endif
+      running = 0;
+    default:
+      break;
+  }
+}
+
+static int register_signals(void) {
+  static const int sigs[] = {
+    SIGTERM,
+    SIGINT,
+#ifdef SIGQUIT
+    SIGQUIT,
+#endif
+#ifdef SIGHUP
+    SIGHUP,
+#endif
+  };
+  struct sigaction sa;
+  size_t i;
+  memset(&sa, 0, sizeof(sa));
+  // no SA_RESTART, so blocking calls are interrupted and the main loop exits promptly
+  sa.sa_handler = shandle;
+  sigemptyset(&sa.sa_mask);
+  for (i = 0; i < sizeof(sigs) / sizeof(sigs[0]); i++) {
+    if (sigaction(sigs[i], &sa, NULL)) {
+      perror("sigaction");
+      return -1;
+    }
+  }
+  // clients may disconnect at any time
+  signal(SIGPIPE, SIG_IGN);
+  return 0;
+}
+
+static int init_backend(void) {
+  if (backend->get(&em)) {
+    perror(backend->name);
+    return -1;
+  }
+  if (em.finit(&em)) {
+    fprintf(stderr, "%s: ", backend->name);
+    perror("energymon:finit");
+    return -1;
+  }
+  em_initialized = 1;
+  interval_us = em.finterval(&em);
+  precision_uj = em.fprecision(&em);
+  n_channels = 1;
+  if (backend->get_channel_count != NULL) {
+    n_channels += backend->get_channel_count(&em);
+    if (n_channels > 1 && (channel_uj = calloc(n_channels - 1, sizeof(uint64_t))) == NULL) {
+      perror("calloc");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Read all channels in a single pass.
+ * Returns 0 on success, or an errno value.
+ */
+static int read_channels(uint64_t* total_uj) {
+  errno = 0;
+  if (n_channels > 1) {
+    *total_uj = backend->read_channels(&em, channel_uj, n_channels - 1);
+  } else {
+    *total_uj = em.fread(&em);
+  }
+  return *total_uj == 0 && errno ? errno : 0;
+}
+
+static int read_channel(uint32_t channel, uint64_t* energy_uj) {
+  uint64_t total_uj;
+  int err;
+  if ((err = read_channels(&total_uj)) == 0) {
+    *energy_uj = channel == 0 ? total_uj : channel_uj[channel - 1];
+  }
+  return err;
+}
+
+static int is_stale_socket(const struct sockaddr_un* addr) {
+  int stale = 0;
+  int fd;
+  if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) >= 0) {
+    stale = connect(fd, (const struct sockaddr*) addr, sizeof(*addr)) && errno == ECONNREFUSED;
+    close(fd);
+  }
+  errno = EADDRINUSE;
+  return stale;
+}
+
+static int listen_socket(void) {
+  struct sockaddr_un addr;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", socket_path);
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  if ((listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+    perror("socket");
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+  // a server that didn't exit cleanly leaves its socket behind, which nobody is listening on
+  while (bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr))) {
+    if (errno == EADDRINUSE && is_stale_socket(&addr) && unlink(socket_path) == 0) {
+      continue;
+    }
+    perror("bind");
+    close(listen_fd);
+    listen_fd = -1;
+    return -1;
+  }
+  if (listen(listen_fd, SOMAXCONN)) {
+    perror("listen");
+    return -1;
+  }
+  return 0;
+}
+
+static void publish_slots(uint64_t now_ns) {
+  uint64_t total_uj;
+  energymon_seqlock* sl;
+  size_t i;
+  if (read_channels(&total_uj)) {
+    // keep the last good values
+    return;
+  }
+  for (i = 0; i < n_channels; i++) {
+    sl = (energymon_seqlock*) &slots[i].seq;
+    energymon_seqlock_write_begin(sl);
+    energymon_seqlock_store(&slots[i].energy_uj, i == 0 ? total_uj : channel_uj[i - 1]);
+    energymon_seqlock_store(&slots[i].time_ns, now_ns);
+    energymon_seqlock_write_end(sl);
+  }
+}
+
+static int create_slots(void) {
+#ifdef __linux__
+  long page_size = sysconf(_SC_PAGESIZE);
+  size_t size = n_channels * sizeof(energymon_socket_slot);
+  map_len = page_size > 0 ? (size + (size_t) page_size - 1) / (size_t) page_size * (size_t) page_size : size;
+  if ((mem_fd = memfd_create("energymon-server", MFD_CLOEXEC | MFD_ALLOW_SEALING)) < 0) {
+    perror("memfd_create");
+    return -1;
+  }
+  if (ftruncate(mem_fd, (off_t) map_len)) {
+    perror("ftruncate");
+    close(mem_fd);
+    mem_fd = -1;
+    return -1;
+  }
+  if ((slots = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0)) == MAP_FAILED) {
+    perror("mmap");
+    slots = NULL;
+    close(mem_fd);
+    mem_fd = -1;
+    return -1;
+  }
+  // clients must not be able to resize the file (which would SIGBUS us) or write to it
+  if (fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+#ifdef F_SEAL_FUTURE_WRITE
+            F_SEAL_FUTURE_WRITE |
+#endif
+            F_SEAL_SEAL)) {
+    perror("fcntl:F_ADD_SEALS");
+  }
+  publish_next_ns = energymon_gettime_ns();
+  publish_slots(publish_next_ns);
+  publish_next_ns += interval_us * 1000;
+  return 0;
+#else
+  errno = ENOTSUP;
+  return -1;
+#endif
+}
+
+static void drop_client(server_client* c) {
+  close(c->fd);
+  c->fd = -1;
+}
+
+/**
+ * Send a message, with an optional payload and file descriptor.
+ * Clients that don't keep up are disconnected rather than blocking the server.
+ */
+static void send_client(server_client* c, const energymon_socket_msg* msg, const void* payload, int fd) {
+  struct msghdr mh;
+  struct iovec iov[2];
+  struct cmsghdr* cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  memset(&mh, 0, sizeof(mh));
+  iov[0].iov_base = (void*) msg;
+  iov[0].iov_len = sizeof(*msg);
+  iov[1].iov_base = (void*) payload;
+  iov[1].iov_len = msg->len;
+  mh.msg_iov = iov;
+  mh.msg_iovlen = msg->len > 0 ? 2 : 1;
+  if (fd >= 0) {
+    memset(&control, 0, sizeof(control));
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+  if (sendmsg(c->fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t) (sizeof(*msg) + msg->len)) {
+    drop_client(c);
+  }
+}
+
+static void handle_request(server_client* c, uint64_t now_ns) {
+  const energymon_socket_msg* req = &c->req;
+  energymon_socket_msg resp;
+  char name[ENERGYMON_SOCKET_NAME_LEN];
+  int fd = -1;
+  memset(&resp, 0, sizeof(resp));
+  resp.type = req->type;
+  resp.version = ENERGYMON_SOCKET_PROTOCOL_VERSION;
+  resp.channel = req->channel;
+  if (req->version != ENERGYMON_SOCKET_PROTOCOL_VERSION) {
+    resp.error = EPROTONOSUPPORT;
+    send_client(c, &resp, NULL, -1);
+    return;
+  }
+  switch (req->type) {
+    case ENERGYMON_SOCKET_MSG_INFO:
+      resp.channel = (uint32_t) n_channels;
+      resp.value0 = interval_us;
+      resp.value1 = precision_uj;
+      if (em.fsource(name, sizeof(name)) == NULL) {
+        resp.error = errno;
+      }
+      break;
+    case ENERGYMON_SOCKET_MSG_CHANNEL_NAME:
+      if (req->channel >= n_channels) {
+        resp.error = EINVAL;
+      } else if (req->channel == 0) {
+        snprintf(name, sizeof(name), "%s", backend->name);
+      } else if (backend->get_channel_name(&em, req->channel - 1, name, sizeof(name)) == NULL) {
+        resp.error = errno;
+      }
+      break;
+    case ENERGYMON_SOCKET_MSG_READ:
+      if (req->channel >= n_channels) {
+        resp.error = EINVAL;
+      } else if ((resp.error = read_channel(req->channel, &resp.value0)) == 0) {
+        resp.value1 = energymon_gettime_ns();
+      }
+      break;
+    case ENERGYMON_SOCKET_MSG_SUBSCRIBE:
+      if (req->channel >= n_channels) {
+        resp.error = EINVAL;
+      } else {
+        // the backend doesn't update any faster than its interval
+        resp.value0 = req->value0 > interval_us ? req->value0 : interval_us;
+        c->subscribed = 1;
+        c->sub_channel = req->channel;
+        c->sub_interval_ns = resp.value0 * 1000;
+        c->sub_next_ns = now_ns + c->sub_interval_ns;
+      }
+      break;
+    case ENERGYMON_SOCKET_MSG_MAP:
+      if (mem_fd < 0 && create_slots()) {
+        resp.error = errno;
+      } else {
+        resp.value0 = map_len;
+        c->mapped = 1;
+        fd = mem_fd;
+      }
+      break;
+    default:
+      resp.error = EINVAL;
+      break;
+  }
+  if (!resp.error && (req->type == ENERGYMON_SOCKET_MSG_INFO || req->type == ENERGYMON_SOCKET_MSG_CHANNEL_NAME)) {
+    resp.len = (uint32_t) strlen(name) + 1;
+  }
+  send_client(c, &resp, name, fd);
+}
+
+static void recv_client(server_client* c, uint64_t now_ns) {
+  ssize_t n = recv(c->fd, (char*) &c->req + c->req_len, sizeof(c->req) - c->req_len, MSG_DONTWAIT);
+  if (n <= 0) {
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      drop_client(c);
+    }
+    return;
+  }
+  if ((c->req_len += (size_t) n) == sizeof(c->req)) {
+    c->req_len = 0;
+    handle_request(c, now_ns);
+  }
+}
+
+static void accept_clients(void) {
+  server_client* tmp;
+  int client_fd;
+  while ((client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+    if ((tmp = realloc(clients, (n_clients + 1) * sizeof(server_client))) == NULL) {
+      close(client_fd);
+      continue;
+    }
+    clients = tmp;
+    memset(&clients[n_clients], 0, sizeof(server_client));
+    clients[n_clients++].fd = client_fd;
+  }
+}
+
+static void remove_dropped_clients(void) {
+  size_t i;
+  for (i = n_clients; i > 0; i--) {
+    if (clients[i - 1].fd < 0) {
+      clients[i - 1] = clients[--n_clients];
+    }
+  }
+}
+
+/**
+ * Wait until the deadline, handling any requests and connections in the meantime.
+ */
+static void wait_clients(uint64_t deadline_ns) {
+  struct pollfd* pfds;
+  struct timespec ts;
+  uint64_t now_ns = energymon_gettime_ns();
+  size_t n_pfds = n_clients + 1;
+  size_t i;
+  if ((pfds = malloc(n_pfds * sizeof(struct pollfd))) == NULL) {
+    energymon_sleep_until_ns(deadline_ns, &running);
+    return;
+  }
+  pfds[0].fd = listen_fd;
+  pfds[0].events = POLLIN;
+  for (i = 0; i < n_clients; i++) {
+    pfds[i + 1].fd = clients[i].fd;
+    pfds[i + 1].events = POLLIN;
+  }
+  if (deadline_ns > now_ns) {
+    ts.tv_sec = (time_t) ((deadline_ns - now_ns) / 1000000000);
+    ts.tv_nsec = (long) ((deadline_ns - now_ns) % 1000000000);
+  } else {
+    ts.tv_sec = 0;
+    ts.tv_nsec = 0;
+  }
+  if (ppoll(pfds, n_pfds, deadline_ns == UINT64_MAX ? NULL : &ts, NULL) > 0) {
+    now_ns = energymon_gettime_ns();
+    for (i = 1; i < n_pfds; i++) {
+      if (pfds[i].revents) {
+        recv_client(&clients[i - 1], now_ns);
+      }
+    }
+    remove_dropped_clients();
+    if (pfds[0].revents) {
+      accept_clients();
+    }
+  }
+  free(pfds);
+}
+
+/**
+ * Advance a deadline by one interval on its original schedule, skipping any that were missed.
+ */
+static void advance_deadline(uint64_t* next_ns, uint64_t interval_ns, uint64_t now_ns) {
+  if (now_ns >= *next_ns + interval_ns) {
+    *next_ns += (now_ns - *next_ns) / interval_ns * interval_ns;
+  }
+  *next_ns += interval_ns;
+}
+
+static void run(void) {
+  energymon_socket_msg sample;
+  uint64_t deadline_ns;
+  uint64_t now_ns;
+  size_t i;
+  int mapped;
+  memset(&sample, 0, sizeof(sample));
+  sample.type = ENERGYMON_SOCKET_MSG_SAMPLE;
+  sample.version = ENERGYMON_SOCKET_PROTOCOL_VERSION;
+  while (running) {
+    // only keep the memory file up to date while someone is using it
+    for (mapped = 0, deadline_ns = UINT64_MAX, i = 0; i < n_clients; i++) {
+      mapped |= clients[i].mapped;
+      if (clients[i].subscribed && clients[i].sub_next_ns < deadline_ns) {
+        deadline_ns = clients[i].sub_next_ns;
+      }
+    }
+    if (mapped && publish_next_ns < deadline_ns) {
+      deadline_ns = publish_next_ns;
+    }
+    wait_clients(deadline_ns);
+    now_ns = energymon_gettime_ns();
+    if (mapped && publish_next_ns <= now_ns) {
+      publish_slots(now_ns);
+      advance_deadline(&publish_next_ns, interval_us * 1000, now_ns);
+    }
+    for (i = 0; running && i < n_clients; i++) {
+      if (clients[i].fd < 0 || !clients[i].subscribed || clients[i].sub_next_ns > now_ns) {
+        continue;
+      }
+      sample.channel = clients[i].sub_channel;
+      if ((sample.error = read_channel(sample.channel, &sample.value0)) != 0) {
+        sample.value0 = 0;
+      }
+      sample.value1 = energymon_gettime_ns();
+      send_client(&clients[i], &sample, NULL, -1);
+      advance_deadline(&clients[i].sub_next_ns, clients[i].sub_interval_ns, now_ns);
+    }
+    remove_dropped_clients();
+  }
+}
+
+static int cleanup(void) {
+  int ret = 0;
+  while (n_clients > 0) {
+    close(clients[--n_clients].fd);
+  }
+  free(clients);
+  if (slots != NULL) {
+    munmap(slots, map_len);
+  }
+  if (mem_fd >= 0) {
+    close(mem_fd);
+  }
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    if (unlink(socket_path)) {
+      perror("unlink");
+      ret = -errno;
+    }
+  }
+  if (em_initialized && em.ffinish(&em)) {
+    perror("energymon:ffinish");
+    ret = -errno;
+  }
+  free(channel_uj);
+  return ret;
+}
+
+int main(int argc, char** argv) {
+  // register the signal handlers
+  if (register_signals()) {
+    return -errno;
+  }
+  parse_args(argc, argv);
+
+  if (init_backend() || listen_socket()) {
+    cleanup();
+    return -errno;
+  }
+
+  run();
+
+  errno = 0;
+  return cleanup();
+}
@@ -0,0 +1,466 @@
+/**
+ * Read energy from an energymon-server over a Unix domain socket.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "energymon.h"
+#include "energymon-seqlock.h"
+#include "energymon-socket.h"
+#include "energymon-util.h"
+
+#ifdef ENERGYMON_DEFAULT
+#include "energymon-default.h"
+int energymon_get_default(energymon* em) {
+  return energymon_get_socket(em);
+}
+#endif
+
+typedef struct energymon_socket_state {
+  int fd;
+  // serializes request/response round trips on fd, so reads may come from any thread
+  pthread_mutex_t lock;
+  // the subscription's connection, or -1
+  int sub_fd;
+  size_t n_channels;
+  // the channel used for the energymon interface
+  uint32_t channel;
+  uint64_t interval_us;
+  uint64_t precision_uj;
+  // the server's sample table, or NULL if not mapped
+  const energymon_socket_slot* slots;
+  size_t map_len;
+} energymon_socket_state;
+
+static int connect_server(const char* path) {
+  struct sockaddr_un addr;
+  int err_save;
+  int fd;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if (connect(fd, (struct sockaddr*) &addr, sizeof(addr))) {
+    err_save = errno;
+    close(fd);
+    errno = err_save;
+    return -1;
+  }
+  return fd;
+}
+
+static int send_msg(int fd, uint16_t type, uint32_t channel, uint64_t value0) {
+  energymon_socket_msg msg;
+  ssize_t n;
+  memset(&msg, 0, sizeof(msg));
+  msg.type = type;
+  msg.version = ENERGYMON_SOCKET_PROTOCOL_VERSION;
+  msg.channel = channel;
+  msg.value0 = value0;
+  if ((n = send(fd, &msg, sizeof(msg), MSG_NOSIGNAL)) != (ssize_t) sizeof(msg)) {
+    if (n >= 0) {
+      // a short write leaves the stream unusable
+      errno = EIO;
+    }
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Receive a message, and its file descriptor if fd_out isn't NULL.
+ */
+static int recv_msg(int fd, energymon_socket_msg* msg, int* fd_out) {
+  struct msghdr mh;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  ssize_t n;
+  memset(&mh, 0, sizeof(mh));
+  iov.iov_base = msg;
+  iov.iov_len = sizeof(*msg);
+  mh.msg_iov = &iov;
+  mh.msg_iovlen = 1;
+  if (fd_out != NULL) {
+    *fd_out = -1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+  }
+  if ((n = recvmsg(fd, &mh, MSG_WAITALL | MSG_CMSG_CLOEXEC)) != (ssize_t) sizeof(*msg)) {
+    if (n >= 0) {
+      // server closed the connection
+      errno = ECONNRESET;
+    }
+    return -1;
+  }
+  if (fd_out != NULL && (cmsg = CMSG_FIRSTHDR(&mh)) != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+      cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+    memcpy(fd_out, CMSG_DATA(cmsg), sizeof(int));
+  }
+  if (msg->version != ENERGYMON_SOCKET_PROTOCOL_VERSION) {
+    errno = EPROTO;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Send a request and receive its response, copying any payload into buf (which is always null-terminated).
+ */
+static int request(int fd, uint16_t type, uint32_t channel, uint64_t value0, energymon_socket_msg* resp,
+                   char* buf, size_t n, int* fd_out) {
+  char discard[ENERGYMON_SOCKET_NAME_LEN];
+  if (send_msg(fd, type, channel, value0) || recv_msg(fd, resp, fd_out)) {
+    return -1;
+  }
+  if (resp->type != type) {
+    errno = EPROTO;
+    return -1;
+  }
+  if (resp->len > 0) {
+    if (buf == NULL || n == 0) {
+      buf = discard;
+      n = sizeof(discard);
+    }
+    // names are short, so longer payloads are a protocol error
+    if (resp->len > n || recv(fd, buf, resp->len, MSG_WAITALL) != (ssize_t) resp->len) {
+      errno = EPROTO;
+      return -1;
+    }
+    buf[resp->len - 1] = '\0';
+  } else if (buf != NULL && n > 0) {
+    buf[0] = '\0';
+  }
+  if (resp->error) {
+    errno = resp->error;
+    return -1;
+  }
+  return 0;
+}
+
+static int select_channel(energymon_socket_state* state, const char* name) {
+  energymon_socket_msg resp;
+  char buf[ENERGYMON_SOCKET_NAME_LEN];
+  uint32_t i;
+  for (i = 0; i < state->n_channels; i++) {
+    if (request(state->fd, ENERGYMON_SOCKET_MSG_CHANNEL_NAME, i, 0, &resp, buf, sizeof(buf), NULL)) {
+      return -1;
+    }
+    if (!strcmp(buf, name)) {
+      state->channel = i;
+      return 0;
+    }
+  }
+  errno = ENOENT;
+  return -1;
+}
+
+static int map_slots(energymon_socket_state* state) {
+  energymon_socket_msg resp;
+  void* mem;
+  int err_save;
+  int fd = -1;
+  if (request(state->fd, ENERGYMON_SOCKET_MSG_MAP, 0, 0, &resp, NULL, 0, &fd)) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  if (fd < 0) {
+    errno = EPROTO;
+    return -1;
+  }
+  if (resp.value0 < state->n_channels * sizeof(energymon_socket_slot)) {
+    errno = EPROTO;
+    mem = MAP_FAILED;
+  } else {
+    mem = mmap(NULL, (size_t) resp.value0, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  err_save = errno;
+  close(fd);
+  errno = err_save;
+  if (mem == MAP_FAILED) {
+    return -1;
+  }
+  state->slots = mem;
+  state->map_len = (size_t) resp.value0;
+  return 0;
+}
+
+static void free_state(energymon_socket_state* state) {
+  int err_save = errno;
+  if (state->slots != NULL) {
+    munmap((void*) state->slots, state->map_len);
+  }
+  if (state->sub_fd >= 0) {
+    close(state->sub_fd);
+  }
+  if (state->fd >= 0) {
+    close(state->fd);
+  }
+  pthread_mutex_destroy(&state->lock);
+  free(state);
+  errno = err_save;
+}
+
+int energymon_init_socket(energymon* em) {
+  if (em == NULL || em->state != NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  const char* path = getenv(ENERGYMON_SOCKET);
+  const char* channel = getenv(ENERGYMON_SOCKET_CHANNEL);
+  const char* map = getenv(ENERGYMON_SOCKET_MAP);
+  energymon_socket_state* state;
+  energymon_socket_msg resp;
+
+  if ((state = calloc(1, sizeof(energymon_socket_state))) == NULL) {
+    return -1;
+  }
+  if ((errno = pthread_mutex_init(&state->lock, NULL))) {
+    free(state);
+    return -1;
+  }
+  state->sub_fd = -1;
+  if ((state->fd = connect_server(path == NULL ? ENERGYMON_SOCKET_DEFAULT : path)) < 0 ||
+      request(state->fd, ENERGYMON_SOCKET_MSG_INFO, 0, 0, &resp, NULL, 0, NULL)) {
+    free_state(state);
+    return -1;
+  }
+  state->n_channels = resp.channel;
+  state->interval_us = resp.value0;
+  state->precision_uj = resp.value1;
+  if ((channel != NULL && select_channel(state, channel)) ||
+      (map != NULL && atoi(map) != 0 && map_slots(state))) {
+    free_state(state);
+    return -1;
+  }
+
+  em->state = state;
+  return 0;
+}
+
+static int read_slot(const energymon_socket_slot* slot, uint64_t* energy_uj) {
+  // the seq field is the seqlock's only member
+  const energymon_seqlock* sl = (const energymon_seqlock*) &slot->seq;
+  uint32_t seq;
+  do {
+    if (energymon_seqlock_try_read_begin(sl, &seq)) {
+      return -1;
+    }
+    *energy_uj = energymon_seqlock_load(&slot->energy_uj);
+  } while (energymon_seqlock_read_retry(sl, seq));
+  return 0;
+}
+
+static uint64_t read_channel(energymon_socket_state* state, uint32_t channel) {
+  energymon_socket_msg resp;
+  struct pollfd pfd;
+  uint64_t energy_uj;
+  int ret;
+  if (state->slots != NULL) {
+    if (read_slot(&state->slots[channel], &energy_uj) == 0) {
+      return energy_uj;
+    }
+    // the server didn't finish an update - it's gone if it hung up, otherwise it may just be descheduled
+    pfd.fd = state->fd;
+    pfd.events = 0;
+    errno = poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLHUP) ? ESRCH : EAGAIN;
+    return 0;
+  }
+  pthread_mutex_lock(&state->lock);
+  ret = request(state->fd, ENERGYMON_SOCKET_MSG_READ, channel, 0, &resp, NULL, 0, NULL);
+  pthread_mutex_unlock(&state->lock);
+  return ret ? 0 : resp.value0;
+}
+
+uint64_t energymon_read_total_socket(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  energymon_socket_state* state = (energymon_socket_state*) em->state;
+  errno = 0;
+  return read_channel(state, state->channel);
+}
+
+int energymon_finish_socket(energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  free_state((energymon_socket_state*) em->state);
+  em->state = NULL;
+  return 0;
+}
+
+char* energymon_get_source_socket(char* buffer, size_t n) {
+  return energymon_strencpy(buffer, "Unix Domain Socket", n);
+}
+
+uint64_t energymon_get_interval_socket(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  return ((const energymon_socket_state*) em->state)->interval_us;
+}
+
+uint64_t energymon_get_precision_socket(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  return ((const energymon_socket_state*) em->state)->precision_uj;
+}
+
+int energymon_is_exclusive_socket(void) {
+  return 0;
+}
+
+int energymon_get_socket(energymon* em) {
+  if (em == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  em->finit = &energymon_init_socket;
+  em->fread = &energymon_read_total_socket;
+  em->ffinish = &energymon_finish_socket;
+  em->fsource = &energymon_get_source_socket;
+  em->finterval = &energymon_get_interval_socket;
+  em->fprecision = &energymon_get_precision_socket;
+  em->fexclusive = &energymon_is_exclusive_socket;
+  em->state = NULL;
+  return 0;
+}
+
+size_t energymon_get_channel_count_socket(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  return ((const energymon_socket_state*) em->state)->n_channels;
+}
+
+char* energymon_get_channel_name_socket(const energymon* em, size_t channel, char* buffer, size_t n) {
+  if (em == NULL || em->state == NULL || buffer == NULL || n == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  energymon_socket_state* state = (energymon_socket_state*) em->state;
+  energymon_socket_msg resp;
+  char buf[ENERGYMON_SOCKET_NAME_LEN];
+  int ret;
+  if (channel >= state->n_channels) {
+    errno = EINVAL;
+    return NULL;
+  }
+  pthread_mutex_lock(&state->lock);
+  ret = request(state->fd, ENERGYMON_SOCKET_MSG_CHANNEL_NAME, (uint32_t) channel, 0, &resp, buf, sizeof(buf), NULL);
+  pthread_mutex_unlock(&state->lock);
+  if (ret) {
+    return NULL;
+  }
+  return energymon_strencpy(buffer, buf, n);
+}
+
+uint64_t energymon_read_channels_socket(const energymon* em, uint64_t* energy_uj, size_t n) {
+  if (em == NULL || em->state == NULL || (energy_uj == NULL && n > 0)) {
+    errno = EINVAL;
+    return 0;
+  }
+  energymon_socket_state* state = (energymon_socket_state*) em->state;
+  size_t i;
+  errno = 0;
+  for (i = 0; i < n && i < state->n_channels; i++) {
+    energy_uj[i] = read_channel(state, (uint32_t) i);
+    if (errno) {
+      return 0;
+    }
+  }
+  return read_channel(state, state->channel);
+}
+
+int energymon_subscribe_socket(const energymon* em, uint64_t interval_us) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  energymon_socket_state* state = (energymon_socket_state*) em->state;
+  energymon_socket_msg resp;
+  struct sockaddr_un addr;
+  socklen_t addr_len = sizeof(addr);
+  int fd;
+  // connect to the same server as the request connection
+  if (getpeername(state->fd, (struct sockaddr*) &addr, &addr_len) || (fd = connect_server(addr.sun_path)) < 0) {
+    return -1;
+  }
+  if (request(fd, ENERGYMON_SOCKET_MSG_SUBSCRIBE, state->channel, interval_us, &resp, NULL, 0, NULL)) {
+    close(fd);
+    return -1;
+  }
+  if (state->sub_fd >= 0) {
+    close(state->sub_fd);
+  }
+  state->sub_fd = fd;
+  return 0;
+}
+
+int energymon_recv_sample_socket(const energymon* em, energymon_socket_sample* sample) {
+  if (em == NULL || em->state == NULL || sample == NULL || ((energymon_socket_state*) em->state)->sub_fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  const energymon_socket_state* state = (energymon_socket_state*) em->state;
+  energymon_socket_msg msg;
+  if (recv_msg(state->sub_fd, &msg, NULL)) {
+    return -1;
+  }
+  if (msg.type != ENERGYMON_SOCKET_MSG_SAMPLE) {
+    errno = EPROTO;
+    return -1;
+  }
+  if (msg.error) {
+    errno = msg.error;
+    return -1;
+  }
+  sample->energy_uj = msg.value0;
+  sample->time_ns = msg.value1;
+  return 0;
+}
+
+int energymon_unsubscribe_socket(const energymon* em) {
+  if (em == NULL || em->state == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  energymon_socket_state* state = (energymon_socket_state*) em->state;
+  // the server drops the subscription when the connection closes
+  if (state->sub_fd >= 0) {
+    close(state->sub_fd);
+    state->sub_fd = -1;
+  }
+  return 0;
+}
@@ -0,0 +1,196 @@
+/**
+ * Read energy from an energymon-server over a Unix domain socket.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _ENERGYMON_SOCKET_H_
+#define _ENERGYMON_SOCKET_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "energymon.h"
+
+/* The server's socket path */
+#define ENERGYMON_SOCKET "ENERGYMON_SOCKET"
+#define ENERGYMON_SOCKET_DEFAULT "/tmp/energymon.sock"
+/* Select a channel by name to use for the energymon interface, rather than the backend's total (channel 0) */
+#define ENERGYMON_SOCKET_CHANNEL "ENERGYMON_SOCKET_CHANNEL"
+/*
+ * Set to a non-zero value to map the server's sample table and read it without round trips (Linux only).
+ * Reads then fail with EAGAIN if the server doesn't finish an update in time, or ESRCH if it died during one.
+ */
+#define ENERGYMON_SOCKET_MAP "ENERGYMON_SOCKET_MAP"
+
+/*
+ * Protocol
+ *
+ * Clients send fixed-size energymon_socket_msg requests over a stream socket and the server replies to each one in
+ * order with a message of the same type, in the host's byte order.
+ * A response with a non-zero error field failed, and has no payload or file descriptor.
+ * Some responses are followed by a payload of len bytes, e.g., a null-terminated name.
+ * After a successful SUBSCRIBE, the server also sends SAMPLE messages on the same connection until the client
+ * disconnects.
+ * Clients that don't keep up with their responses or samples are disconnected.
+ */
+#define ENERGYMON_SOCKET_PROTOCOL_VERSION 1
+
+/* The maximum name length, including the null terminator */
+#define ENERGYMON_SOCKET_NAME_LEN 64
+
+/* Request: -. Response: value0 = interval_us, value1 = precision_uj, channel = channel count, payload = source */
+#define ENERGYMON_SOCKET_MSG_INFO 1
+/* Request: channel. Response: payload = the channel's name (channel 0 is the backend's total) */
+#define ENERGYMON_SOCKET_MSG_CHANNEL_NAME 2
+/* Request: channel. Response: value0 = energy_uj, value1 = the server's CLOCK_MONOTONIC time in ns */
+#define ENERGYMON_SOCKET_MSG_READ 3
+/*
+ * Request: channel, value0 = interval_us (0 for the backend's interval, which is also the minimum).
+ * Response: value0 = interval_us
+ */
+#define ENERGYMON_SOCKET_MSG_SUBSCRIBE 4
+/* 5 is reserved */
+/* Sent by the server for subscriptions: channel, value0 = energy_uj, value1 = CLOCK_MONOTONIC time in ns */
+#define ENERGYMON_SOCKET_MSG_SAMPLE 6
+/*
+ * Request: -. Response: value0 = the memory file size, with the file descriptor attached (SCM_RIGHTS).
+ * The file is an array of energymon_socket_slot, one per channel, which the server updates on the backend's interval
+ * while any client that requested it is connected (Linux only).
+ */
+#define ENERGYMON_SOCKET_MSG_MAP 7
+
+typedef struct energymon_socket_msg {
+  // ENERGYMON_SOCKET_MSG_*
+  uint16_t type;
+  // ENERGYMON_SOCKET_PROTOCOL_VERSION
+  uint16_t version;
+  // 0, or an errno value if a request failed
+  int32_t error;
+  uint32_t channel;
+  // length of the payload that follows the message
+  uint32_t len;
+  uint64_t value0;
+  uint64_t value1;
+} energymon_socket_msg;
+
+/**
+ * A channel's data in the server's memory file.
+ * The server writes with a sequence lock: it increments seq to an odd value, writes the data fields, then increments
+ * seq to an even value (with release semantics).
+ * Readers load seq, then the data fields, then seq again, and retry if seq was odd or changed.
+ */
+typedef struct energymon_socket_slot {
+  uint32_t seq;
+  uint32_t reserved0;
+  uint64_t energy_uj;
+  // CLOCK_MONOTONIC time of the last update
+  uint64_t time_ns;
+  uint8_t reserved[40];
+} energymon_socket_slot;
+
+/**
+ * A sample received from a subscription.
+ */
+typedef struct energymon_socket_sample {
+  uint64_t energy_uj;
+  // the server's CLOCK_MONOTONIC time
+  uint64_t time_ns;
+} energymon_socket_sample;
+
+int energymon_init_socket(energymon* em);
+
+uint64_t energymon_read_total_socket(const energymon* em);
+
+int energymon_finish_socket(energymon* em);
+
+char* energymon_get_source_socket(char* buffer, size_t n);
+
+uint64_t energymon_get_interval_socket(const energymon* em);
+
+uint64_t energymon_get_precision_socket(const energymon* em);
+
+int energymon_is_exclusive_socket(void);
+
+int energymon_get_socket(energymon* em);
+
+/**
+ * Get the number of channels the server provides, including the backend's total (channel 0).
+ *
+ * @param em
+ *  an initialized energymon
+ * @return the channel count, or 0 on failure (errno is set)
+ */
+size_t energymon_get_channel_count_socket(const energymon* em);
+
+/**
+ * Get a channel's name.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param channel
+ *  the channel index, in range [0, energymon_get_channel_count_socket)
+ * @param buffer
+ *  the destination buffer, which will be null-terminated
+ * @param n
+ *  the buffer size
+ * @return pointer to buffer, or NULL on failure (errno is set)
+ */
+char* energymon_get_channel_name_socket(const energymon* em, size_t channel, char* buffer, size_t n);
+
+/**
+ * Get the energy of the selected channel (as for energymon_read_total_socket) and of each channel in microjoules.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param energy_uj
+ *  array to store per-channel energy values, may be NULL if n is 0
+ * @param n
+ *  the array length - values are written for at most n channels
+ * @return the selected channel's energy (in uJ), or 0 on failure (errno is set)
+ */
+uint64_t energymon_read_channels_socket(const energymon* em, uint64_t* energy_uj, size_t n);
+
+/**
+ * Subscribe to samples of the channel used for the energymon interface, using a separate connection so that reads
+ * aren't interleaved with samples.
+ * Subscribing again replaces the previous subscription.
+ * Reads are safe to use from any thread, but the subscription functions must not be called concurrently with each
+ * other.
+ *
+ * @param em
+ *  an initialized energymon
+ * @param interval_us
+ *  the sample interval, or 0 for the backend's interval - shorter intervals are rounded up to the backend's
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_subscribe_socket(const energymon* em, uint64_t interval_us);
+
+/**
+ * Block until the next sample from the subscription arrives.
+ *
+ * @param em
+ *  an initialized energymon with a subscription
+ * @param sample
+ *  the sample
+ * @return 0 on success, -1 on failure (errno is set: EINVAL if not subscribed, ECONNRESET if the server disconnected)
+ */
+int energymon_recv_sample_socket(const energymon* em, energymon_socket_sample* sample);
+
+/**
+ * End the subscription, if any, by closing its connection.
+ *
+ * @param em
+ *  an initialized energymon
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int energymon_unsubscribe_socket(const energymon* em);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * Test exact accumulation of wrapping 32-bit energy counters and fixed-point conversion to microjoules.
+ * Simulates a long run with many counter wraps and verifies that there is no drift.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include "energymon-util.h"
+
+#define N_READS 10000000UL
+
+static uint64_t xorshift64(uint64_t* s) {
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+  return *s;
+}
+
+// floor(raw * 10^6 / 2^esu), computed exactly for esu < 32 by splitting raw into 32-bit halves
+static uint64_t expected_uj(uint64_t raw, unsigned int esu) {
+  return (((raw >> 32) * 1000000) << (32 - esu)) + (((raw & UINT32_MAX) * 1000000) >> esu);
+}
+
+static int test_exact_units(void) {
+  energymon_fixed_mul fm;
+  const uint64_t values[] = { 0, 1, 12345, UINT32_MAX, (uint64_t) UINT32_MAX + 1, 0x123456789ABCULL, UINT64_MAX >> 20 };
+  unsigned int esu;
+  size_t i;
+  for (esu = 0; esu < 32; esu++) {
+    if (energymon_fixed_mul_init(&fm, 1000000.0 / (double) ((uint64_t) 1 << esu))) {
+      perror("energymon_fixed_mul_init");
+      return -1;
+    }
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+      // skip values whose result doesn't fit
+      if ((values[i] >> 32) * 1000000 > (UINT64_MAX >> (32 - esu))) {
+        continue;
+      }
+      if (energymon_fixed_mul_apply(values[i], &fm) != expected_uj(values[i], esu)) {
+        fprintf(stderr, "Inexact conversion: esu=%u, raw=%"PRIu64": expected %"PRIu64", got %"PRIu64"\n",
+                esu, values[i], expected_uj(values[i], esu), energymon_fixed_mul_apply(values[i], &fm));
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int test_long_run(unsigned int esu) {
+  energymon_fixed_mul fm;
+  uint64_t seed = 0x2545F4914F6CDD1DULL + esu;
+  uint64_t raw_total = 0;
+  uint32_t raw_last = 0;
+  // the simulated hardware counter and the true total count
+  uint32_t counter = 0;
+  uint64_t true_total = 0;
+  uint64_t step;
+  uint64_t uj = 0;
+  uint64_t n_wraps = 0;
+  // the old approach: double conversion with UINT32_MAX as the wrap size
+  uint64_t n_overflow = 0;
+  uint64_t last = 0;
+  uint64_t uj_double = 0;
+  const double units = 1.0 / (double) ((uint64_t) 1 << esu);
+  unsigned long i;
+  energymon_fixed_mul_init(&fm, units * 1000000.0);
+  for (i = 0; i < N_READS; i++) {
+    // up to just under half the counter range per read
+    step = xorshift64(&seed) % ((uint64_t) 1 << 31);
+    if ((uint64_t) counter + step > UINT32_MAX) {
+      n_wraps++;
+    }
+    counter += (uint32_t) step;
+    true_total += step;
+
+    energymon_accumulate_u32(&raw_total, &raw_last, counter);
+    uj = energymon_fixed_mul_apply(raw_total, &fm);
+    if (raw_total != true_total || uj != expected_uj(true_total, esu)) {
+      fprintf(stderr, "Drift at read %lu: expected %"PRIu64" counts (%"PRIu64" uJ), got %"PRIu64" (%"PRIu64" uJ)\n",
+              i, true_total, expected_uj(true_total, esu), raw_total, uj);
+      return -1;
+    }
+
+    if (counter < last) {
+      n_overflow++;
+    }
+    last = counter;
+    uj_double = (uint64_t) ((double) (counter + n_overflow * (uint64_t) UINT32_MAX) * units * 1000000.0);
+  }
+  printf("esu=%u: %lu reads, %"PRIu64" wraps, %"PRIu64" uJ; previous double conversion error: %"PRId64" uJ\n",
+         esu, N_READS, n_wraps, uj, (int64_t) (uj_double - uj));
+  return 0;
+}
+
+int main(void) {
+  if (test_exact_units() || test_long_run(14) || test_long_run(16)) {
+    return 1;
+  }
+  return 0;
+}
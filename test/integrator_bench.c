@@ -0,0 +1,208 @@
+/**
+ * Benchmark the accuracy of integrating synthetic power traces at different polling intervals, comparing the
+ * rectangle rule that polling implementations used to apply against the trapezoidal rule in energymon-integrator.h,
+ * and the CPU cost of polling at each interval.
+ * Errors are the max error in millijoules of the energy measured over consecutive windows (as an application would
+ * measure a region of code), with the trapezoidal rule's error bound where it applies (totals are truncated to whole
+ * microjoules, which adds up to 1 uJ).
+ * CPU cost is the measured time to read and parse a sysfs-like power file and integrate it, times the polling rate,
+ * and excludes the cost of waking up.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "energymon-integrator.h"
+#include "energymon-time-util.h"
+#include "energymon-util.h"
+
+#define BENCH_ITERATIONS 1000000
+#define TRACE_US 60000000
+#define WINDOW_US 2000000
+#define N_WINDOWS (TRACE_US / WINDOW_US)
+// resolution of the reference integral
+#define EXACT_STEP_US 10
+#define PI 3.14159265358979323846
+
+typedef struct trace {
+  const char* name;
+  // power in watts at time t in seconds
+  double (*power_w)(double t);
+  // max |P''| in W/s^2, or 0 if the trapezoidal rule's error bound doesn't apply (power isn't smooth)
+  double d2_max;
+} trace;
+
+// smoothly varying load
+static double sine_w(double t) {
+  return 6.0 + 4.0 * sin(2.0 * PI * t / 4.3);
+}
+
+// linear ramps, which the trapezoidal rule integrates exactly except where the slope changes
+static double triangle_w(double t) {
+  double phase = fmod(t + 1.3715, 7.0);
+  return phase < 3.5 ? 2.0 + 3.0 * phase : 23.0 - 3.0 * phase;
+}
+
+// bursty load with abrupt steps
+static double burst_w(double t) {
+  return fmod(t + 0.3715, 1.5) < 0.6 ? 15.0 : 3.0;
+}
+
+static const trace TRACES[] = {
+  { "sine", sine_w, 4.0 * (2.0 * PI / 4.3) * (2.0 * PI / 4.3) },
+  { "triangle", triangle_w, 0 },
+  { "burst", burst_w, 0 },
+};
+#define N_TRACES (sizeof(TRACES) / sizeof(TRACES[0]))
+
+static const uint64_t INTERVALS_US[] = { 1000, 10000, 100000, 1000000 };
+#define N_INTERVALS (sizeof(INTERVALS_US) / sizeof(INTERVALS_US[0]))
+
+static uint64_t power_uw(const trace* tr, uint64_t t_us) {
+  return (uint64_t) (tr->power_w((double) t_us / 1000000.0) * 1000000.0 + 0.5);
+}
+
+// cumulative energy at the end of each window
+static void exact_uj(const trace* tr, double* totals) {
+  double total = 0;
+  uint64_t t_us;
+  // midpoint rule at a fine resolution
+  for (t_us = 0; t_us < TRACE_US; t_us += EXACT_STEP_US) {
+    total += tr->power_w((double) (t_us + EXACT_STEP_US / 2) / 1000000.0) * EXACT_STEP_US;
+    if ((t_us + EXACT_STEP_US) % WINDOW_US == 0) {
+      totals[(t_us + EXACT_STEP_US) / WINDOW_US - 1] = total;
+    }
+  }
+}
+
+// the rule polling implementations used: each reading is multiplied by the time since the previous one
+static void rectangle_uj(const trace* tr, uint64_t interval_us, double* totals) {
+  uint64_t uw_us = 0;
+  uint64_t t_us;
+  for (t_us = interval_us; t_us <= TRACE_US; t_us += interval_us) {
+    uw_us += power_uw(tr, t_us) * interval_us;
+    if (t_us % WINDOW_US == 0) {
+      totals[t_us / WINDOW_US - 1] = (double) uw_us / 1000000.0;
+    }
+  }
+}
+
+static void trapezoid_uj(const trace* tr, uint64_t interval_us, double* totals) {
+  energymon_integrator in;
+  uint64_t start_us;
+  uint64_t t_us;
+  if (energymon_integrator_init(&in, 0)) {
+    perror("energymon_integrator_init");
+    exit(1);
+  }
+  // synthetic sample times, relative to the integrator's start
+  start_us = in.sample_us;
+  for (t_us = 0; t_us <= TRACE_US; t_us += interval_us) {
+    energymon_integrator_update(&in, power_uw(tr, t_us), start_us + t_us);
+    if (t_us > 0 && t_us % WINDOW_US == 0) {
+      totals[t_us / WINDOW_US - 1] = (double) energymon_integrator_read(&in);
+    }
+  }
+}
+
+// max error of the energy in each window, in millijoules
+static double max_window_error_mj(const double* exact, const double* totals) {
+  double max_err = 0;
+  double err;
+  size_t i;
+  for (i = 0; i < N_WINDOWS; i++) {
+    err = fabs((totals[i] - (i ? totals[i - 1] : 0)) - (exact[i] - (i ? exact[i - 1] : 0))) / 1000.0;
+    if (err > max_err) {
+      max_err = err;
+    }
+  }
+  return max_err;
+}
+
+// time to read a power file and integrate it, as the poller does
+static double poll_ns(unsigned long iterations) {
+  energymon_integrator in;
+  char path[] = "/tmp/energymon-integrator-bench-XXXXXX";
+  char cdata[24];
+  ssize_t len;
+  uint64_t power;
+  uint64_t sample_us;
+  uint64_t start_ns;
+  uint64_t elapsed_ns;
+  unsigned long i;
+  int fd;
+  if ((fd = mkstemp(path)) < 0) {
+    perror("mkstemp");
+    exit(1);
+  }
+  unlink(path);
+  if (pwrite(fd, "5250000\n", 8, 0) != 8 || energymon_integrator_init(&in, 0)) {
+    perror("energymon-integrator-bench");
+    exit(1);
+  }
+  start_ns = energymon_gettime_ns();
+  for (i = 0; i < iterations; i++) {
+    sample_us = energymon_gettime_us();
+    if ((len = pread(fd, cdata, sizeof(cdata), 0)) <= 0 || !energymon_strntou64(cdata, (size_t) len, &power)) {
+      perror("pread");
+      exit(1);
+    }
+    sample_us += (energymon_gettime_us() - sample_us) / 2;
+    energymon_integrator_update(&in, power, sample_us);
+  }
+  elapsed_ns = energymon_gettime_ns() - start_ns;
+  close(fd);
+  if (energymon_integrator_read(&in) == 0) {
+    fprintf(stderr, "No energy was integrated\n");
+    exit(1);
+  }
+  return (double) elapsed_ns / iterations;
+}
+
+int main(int argc, char** argv) {
+  unsigned long iterations = BENCH_ITERATIONS;
+  double exact[N_WINDOWS];
+  double totals[N_WINDOWS];
+  double cost_ns;
+  double rect_mj;
+  double h;
+  size_t i;
+  size_t j;
+  if (argc > 1) {
+    iterations = strtoul(argv[1], NULL, 0);
+  }
+  if (iterations == 0) {
+    fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+    return EINVAL;
+  }
+
+  cost_ns = poll_ns(iterations);
+  printf("Read and integrate: %.2f ns per poll\n\n", cost_ns);
+  printf("Max error over %d ms windows, in mJ:\n", WINDOW_US / 1000);
+  printf("%-10s %12s %10s %14s %14s %14s\n", "trace", "interval_us", "cpu_%", "rectangle", "trapezoid",
+         "trap_bound");
+  for (i = 0; i < N_TRACES; i++) {
+    exact_uj(&TRACES[i], exact);
+    for (j = 0; j < N_INTERVALS; j++) {
+      h = (double) INTERVALS_US[j] / 1000000.0;
+      rectangle_uj(&TRACES[i], INTERVALS_US[j], totals);
+      rect_mj = max_window_error_mj(exact, totals);
+      trapezoid_uj(&TRACES[i], INTERVALS_US[j], totals);
+      printf("%-10s %12"PRIu64" %10.5f %14.4f %14.4f ", TRACES[i].name, INTERVALS_US[j],
+             100.0 * cost_ns / (double) INTERVALS_US[j] / 1000.0, rect_mj, max_window_error_mj(exact, totals));
+      if (TRACES[i].d2_max > 0) {
+        // M * W * h^2 / 12 for a window of length W, in millijoules
+        printf("%14.4f\n", TRACES[i].d2_max * (WINDOW_US / 1000000.0) * h * h / 12.0 * 1000.0);
+      } else {
+        printf("%14s\n", "-");
+      }
+    }
+  }
+  return 0;
+}
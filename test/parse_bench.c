@@ -0,0 +1,69 @@
+/**
+ * Microbenchmark energymon_strntou64 against strtoull on typical sysfs values.
+ * Results are in nanoseconds per parse.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "energymon-time-util.h"
+#include "energymon-util.h"
+
+#define BENCH_ITERATIONS 10000000
+
+// e.g., RAPL energy_uj, INA3221 power/voltage/current, and INA226 power values
+static const char* const SAMPLES[] = {
+  "262143328850\n",
+  "4328\n",
+  "19152\n",
+  "1075000\n",
+};
+#define N_SAMPLES (sizeof(SAMPLES) / sizeof(SAMPLES[0]))
+
+int main(int argc, char** argv) {
+  unsigned long iterations = BENCH_ITERATIONS;
+  size_t lens[N_SAMPLES];
+  uint64_t start_ns;
+  uint64_t strtoull_ns;
+  uint64_t strntou64_ns;
+  uint64_t val;
+  uint64_t sink = 0;
+  unsigned long i;
+  if (argc > 1) {
+    iterations = strtoul(argv[1], NULL, 0);
+  }
+  if (iterations == 0) {
+    fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+    return EINVAL;
+  }
+  for (i = 0; i < N_SAMPLES; i++) {
+    lens[i] = strlen(SAMPLES[i]);
+  }
+
+  start_ns = energymon_gettime_ns();
+  for (i = 0; i < iterations; i++) {
+    sink += strtoull(SAMPLES[i % N_SAMPLES], NULL, 0);
+  }
+  strtoull_ns = energymon_gettime_ns() - start_ns;
+
+  start_ns = energymon_gettime_ns();
+  for (i = 0; i < iterations; i++) {
+    if (energymon_strntou64(SAMPLES[i % N_SAMPLES], lens[i % N_SAMPLES], &val)) {
+      sink -= val;
+    }
+  }
+  strntou64_ns = energymon_gettime_ns() - start_ns;
+
+  // results should cancel out - prevents the compiler from optimizing the loops away
+  if (sink != 0) {
+    fprintf(stderr, "Parsed values differ!\n");
+    return 1;
+  }
+  printf("strtoull: %.2f ns\n", (double) strtoull_ns / iterations);
+  printf("energymon_strntou64: %.2f ns\n", (double) strntou64_ns / iterations);
+  return 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * Fuzz test energymon_strntou64 and energymon_strntou64_fixed against strtoull semantics.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "energymon-util.h"
+
+#define FUZZ_ITERATIONS 1000000
+#define FUZZ_LEN_MAX 32
+// 10^FUZZ_FRAC_DIGITS_MAX must fit in 64 bits
+#define FUZZ_FRAC_DIGITS_MAX 12
+
+// Weighted toward digits, but also produces whitespace, signs, decimal points, and junk
+static const char ALPHABET[] = "0123456789012345678901234567890123456789 \t\n+-.xX9aZ";
+// Like ALPHABET, but with more decimal points and other separators for fixed-point values
+static const char ALPHABET_FIXED[] = "0123456789012345678901234567890123456789 \t\n+-...,:9e";
+
+static uint64_t xorshift64(uint64_t* s) {
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+  return *s;
+}
+
+static int check_u64(const char* buf, size_t len) {
+  char cstr[FUZZ_LEN_MAX + 1];
+  char* end;
+  uint64_t expected;
+  uint64_t val = 0;
+  size_t n;
+  int err_expected;
+  memcpy(cstr, buf, len);
+  cstr[len] = '\0';
+  // strtoull silently negates values with a leading '-', which we reject by design
+  end = cstr + strspn(cstr, " \t\n\v\f\r");
+  if (*end == '-') {
+    errno = 0;
+    if (energymon_strntou64(buf, len, &val) || errno != EINVAL) {
+      fprintf(stderr, "Accepted negative value: '%s'\n", cstr);
+      return -1;
+    }
+    return 0;
+  }
+  errno = 0;
+  expected = strtoull(cstr, &end, 10);
+  err_expected = errno;
+  errno = 0;
+  n = energymon_strntou64(buf, len, &val);
+  if (end == cstr) {
+    if (n != 0 || errno != EINVAL) {
+      fprintf(stderr, "Expected EINVAL: '%s': n=%zu, errno=%d\n", cstr, n, errno);
+      return -1;
+    }
+  } else if (err_expected == ERANGE) {
+    if (n != 0 || errno != ERANGE) {
+      fprintf(stderr, "Expected ERANGE: '%s': n=%zu, errno=%d\n", cstr, n, errno);
+      return -1;
+    }
+  } else if (n != (size_t) (end - cstr) || val != expected) {
+    fprintf(stderr, "Mismatch: '%s': expected %"PRIu64" (%zu chars), got %"PRIu64" (%zu chars)\n",
+            cstr, expected, (size_t) (end - cstr), val, n);
+    return -1;
+  }
+  return 0;
+}
+
+static int check_fixed(const char* str, unsigned int frac_digits, size_t n_expected, uint64_t expected) {
+  uint64_t val = 0;
+  size_t n = energymon_strntou64_fixed(str, strlen(str), frac_digits, &val);
+  if (n != n_expected || (n && val != expected)) {
+    fprintf(stderr, "Fixed mismatch: '%s' (%u): expected %"PRIu64" (%zu chars), got %"PRIu64" (%zu chars)\n",
+            str, frac_digits, expected, n_expected, val, n);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * The expected value is strtoull's integer part, scaled by 10^frac_digits, plus the first frac_digits fractional
+ * digits (padded with zeros).
+ */
+static int fuzz_fixed(const char* buf, size_t len, unsigned int frac_digits) {
+  char cstr[FUZZ_LEN_MAX + 1];
+  const char* p;
+  uint64_t expected = 0;
+  uint64_t frac = 0;
+  uint64_t scale = 1;
+  uint64_t val = 0;
+  size_t n_int;
+  size_t n_frac = 0;
+  size_t n_expected;
+  size_t n;
+  unsigned int f;
+  int err_expected = 0;
+  memcpy(cstr, buf, len);
+  cstr[len] = '\0';
+  p = cstr + strspn(cstr, " \t\n\v\f\r");
+  if (*p == '-') {
+    err_expected = EINVAL;
+  } else if (*p == '+') {
+    p++;
+  }
+  n_int = strspn(p, "0123456789");
+  n_expected = (size_t) (p - cstr) + n_int;
+  if (p[n_int] == '.') {
+    n_frac = strspn(p + n_int + 1, "0123456789");
+    n_expected += 1 + n_frac;
+  }
+  if (n_int + n_frac == 0) {
+    err_expected = EINVAL;
+  }
+  if (!err_expected) {
+    errno = 0;
+    expected = n_int > 0 ? strtoull(p, NULL, 10) : 0;
+    err_expected = errno;
+    for (f = 0; f < frac_digits; f++) {
+      scale *= 10;
+      frac = frac * 10 + (f < n_frac ? (uint64_t) (p[n_int + 1 + f] - '0') : 0);
+    }
+    if (!err_expected &&
+        (__builtin_mul_overflow(expected, scale, &expected) || __builtin_add_overflow(expected, frac, &expected))) {
+      err_expected = ERANGE;
+    }
+  }
+  errno = 0;
+  n = energymon_strntou64_fixed(buf, len, frac_digits, &val);
+  if (err_expected) {
+    if (n != 0 || errno != err_expected) {
+      fprintf(stderr, "Fixed expected errno %d: '%s' (%u): n=%zu, errno=%d\n", err_expected, cstr, frac_digits, n,
+              errno);
+      return -1;
+    }
+  } else if (n != n_expected || val != expected) {
+    fprintf(stderr, "Fixed mismatch: '%s' (%u): expected %"PRIu64" (%zu chars), got %"PRIu64" (%zu chars)\n",
+            cstr, frac_digits, expected, n_expected, val, n);
+    return -1;
+  }
+  return 0;
+}
+
+static int test_fixed(void) {
+  return check_fixed("1.234567\n", 6, 8, 1234567) ||
+         check_fixed("1.2345678", 6, 9, 1234567) ||
+         check_fixed("1.2", 6, 3, 1200000) ||
+         check_fixed("  +12", 3, 5, 12000) ||
+         check_fixed("0.5", 0, 3, 0) ||
+         check_fixed(".5", 1, 2, 5) ||
+         check_fixed("7.", 2, 2, 700) ||
+         check_fixed(".", 6, 0, 0) ||
+         check_fixed("-1.0", 6, 0, 0) ||
+         check_fixed("18446744073709551.615", 3, 21, UINT64_MAX) ||
+         check_fixed("18446744073709551.616", 3, 0, 0) ||
+         check_fixed("18446744073709552", 3, 0, 0);
+}
+
+static int test_boundaries(void) {
+  uint64_t val = 0;
+  // not null-terminated and length-limited
+  const char digits[4] = { '1', '2', '3', '4' };
+  if (energymon_strntou64(digits, 3, &val) != 3 || val != 123) {
+    fprintf(stderr, "Length limit not respected\n");
+    return -1;
+  }
+  if (energymon_strntou64(digits, 0, &val) != 0 || errno != EINVAL) {
+    fprintf(stderr, "Empty buffer not rejected\n");
+    return -1;
+  }
+  return check_u64("18446744073709551615", 20) ||
+         check_u64("18446744073709551616", 20) ||
+         check_u64("0x1F", 4) ||
+         check_u64("007", 3);
+}
+
+int main(void) {
+  char buf[FUZZ_LEN_MAX];
+  uint64_t seed = 0x9E3779B97F4A7C15ULL;
+  size_t len;
+  size_t i;
+  unsigned long iter;
+  if (test_boundaries() || test_fixed()) {
+    return 1;
+  }
+  for (iter = 0; iter < FUZZ_ITERATIONS; iter++) {
+    len = (size_t) (xorshift64(&seed) % (FUZZ_LEN_MAX + 1));
+    for (i = 0; i < len; i++) {
+      buf[i] = ALPHABET[xorshift64(&seed) % (sizeof(ALPHABET) - 1)];
+    }
+    if (check_u64(buf, len)) {
+      return 1;
+    }
+  }
+  for (iter = 0; iter < FUZZ_ITERATIONS; iter++) {
+    len = (size_t) (xorshift64(&seed) % (FUZZ_LEN_MAX + 1));
+    for (i = 0; i < len; i++) {
+      buf[i] = ALPHABET_FIXED[xorshift64(&seed) % (sizeof(ALPHABET_FIXED) - 1)];
+    }
+    if (fuzz_fixed(buf, len, (unsigned int) (xorshift64(&seed) % (FUZZ_FRAC_DIGITS_MAX + 1)))) {
+      return 1;
+    }
+  }
+  printf("Passed %d fuzz iterations of each parser\n", FUZZ_ITERATIONS);
+  return 0;
+}
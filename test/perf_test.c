@@ -0,0 +1,209 @@
+/**
+ * Test energymon-perf event groups and channels against a fixture power PMU and mocked perf events.
+ * PERF_POWER_DIR is defined by the build to a directory for the fixture.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "energymon.h"
+#include "energymon-perf.h"
+
+#define CHECK(cond) \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+    return -1; \
+  }
+
+#define CONFIG_PKG 0x2
+#define CONFIG_PSYS 0x5
+#define MAX_GROUPS 8
+#define MAX_EVENTS 8
+
+// a group leader's PERF_FORMAT_GROUP data: { u64 nr; u64 values[nr]; }
+typedef struct mock_group {
+  int fd;
+  uint64_t data[1 + MAX_EVENTS];
+} mock_group;
+
+static mock_group groups[MAX_GROUPS];
+static size_t n_groups;
+
+// a distinct count for every (cpu, event) - the fixture's scale is 1 J, so energy is count * 10^6 uJ
+static uint64_t count_val(int cpu, uint64_t config) {
+  return 1000 * (uint64_t) (cpu + 1) + config;
+}
+
+static int open_tmp(void) {
+  char path[] = "/tmp/energymon-perf-test-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd >= 0) {
+    unlink(path);
+  }
+  return fd;
+}
+
+// energymon-perf opens events with syscall(2), so this takes its place - reading a group leader returns its data
+long syscall(long number, ...) {
+  va_list ap;
+  const struct perf_event_attr* attr;
+  mock_group* grp = NULL;
+  int cpu;
+  int group_fd;
+  int fd;
+  size_t i;
+  if (number != __NR_perf_event_open) {
+    errno = ENOSYS;
+    return -1;
+  }
+  va_start(ap, number);
+  attr = va_arg(ap, const struct perf_event_attr*);
+  (void) va_arg(ap, int);
+  cpu = va_arg(ap, int);
+  group_fd = va_arg(ap, int);
+  va_end(ap);
+  if (group_fd < 0) {
+    if (n_groups == MAX_GROUPS || (fd = open_tmp()) < 0) {
+      errno = EMFILE;
+      return -1;
+    }
+    grp = &groups[n_groups++];
+    grp->fd = fd;
+    grp->data[0] = 0;
+  } else {
+    for (i = 0; i < n_groups; i++) {
+      if (groups[i].fd == group_fd) {
+        grp = &groups[i];
+      }
+    }
+    if (grp == NULL || grp->data[0] == MAX_EVENTS || (fd = open_tmp()) < 0) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+  grp->data[1 + grp->data[0]++] = count_val(cpu, attr->config);
+  if (pwrite(grp->fd, grp->data, (1 + grp->data[0]) * sizeof(uint64_t), 0) < 0) {
+    return -1;
+  }
+  return fd;
+}
+
+static int write_file(const char* name, const char* content) {
+  char path[512];
+  FILE* f;
+  snprintf(path, sizeof(path), PERF_POWER_DIR"/%s", name);
+  if ((f = fopen(path, "w")) == NULL) {
+    perror(path);
+    return -1;
+  }
+  fputs(content, f);
+  fclose(f);
+  return 0;
+}
+
+static const char* const FIXTURE_FILES[] = {
+  "type",
+  "cpumask",
+  "events/energy-pkg",
+  "events/energy-pkg.unit",
+  "events/energy-pkg.scale",
+  "events/energy-psys",
+  "events/energy-psys.unit",
+  "events/energy-psys.scale",
+};
+#define N_FIXTURE_FILES (sizeof(FIXTURE_FILES) / sizeof(FIXTURE_FILES[0]))
+
+static void remove_fixture(void) {
+  char path[512];
+  size_t i;
+  for (i = 0; i < N_FIXTURE_FILES; i++) {
+    snprintf(path, sizeof(path), PERF_POWER_DIR"/%s", FIXTURE_FILES[i]);
+    unlink(path);
+  }
+  rmdir(PERF_POWER_DIR"/events");
+  rmdir(PERF_POWER_DIR);
+}
+
+// two packages, led by CPUs 0 and 1
+static int create_fixture(void) {
+  remove_fixture();
+  if (mkdir(PERF_POWER_DIR, 0755) || mkdir(PERF_POWER_DIR"/events", 0755)) {
+    perror(PERF_POWER_DIR);
+    return -1;
+  }
+  return write_file("type", "42\n") ||
+         write_file("cpumask", "0-1\n") ||
+         write_file("events/energy-pkg", "event=0x02\n") ||
+         write_file("events/energy-pkg.unit", "Joules\n") ||
+         write_file("events/energy-pkg.scale", "1\n") ||
+         write_file("events/energy-psys", "event=0x05\n") ||
+         write_file("events/energy-psys.unit", "Joules\n") ||
+         write_file("events/energy-psys.scale", "1\n");
+}
+
+/**
+ * psys is only read by the first package's group, so the other group has no events.
+ */
+static int test_psys_only(void) {
+  energymon em;
+  uint64_t uj[4];
+  char name[64];
+  n_groups = 0;
+  setenv(ENERGYMON_PERF_DOMAINS, "psys", 1);
+  energymon_get_perf(&em);
+  CHECK(em.finit(&em) == 0);
+  CHECK(energymon_get_channel_count_perf(&em) == 1);
+  CHECK(energymon_get_channel_name_perf(&em, 0, name, sizeof(name)) != NULL);
+  CHECK(!strcmp(name, "cpu-0:energy-psys"));
+  CHECK(energymon_get_channel_name_perf(&em, 1, name, sizeof(name)) == NULL);
+  errno = 0;
+  CHECK(energymon_read_channels_perf(&em, uj, 4) == count_val(0, CONFIG_PSYS) * 1000000 && errno == 0);
+  CHECK(uj[0] == count_val(0, CONFIG_PSYS) * 1000000);
+  CHECK(em.ffinish(&em) == 0);
+  return 0;
+}
+
+static int test_pkg_psys(void) {
+  energymon em;
+  uint64_t uj[4];
+  char name[64];
+  n_groups = 0;
+  setenv(ENERGYMON_PERF_DOMAINS, "psys,pkg", 1);
+  energymon_get_perf(&em);
+  CHECK(em.finit(&em) == 0);
+  CHECK(energymon_get_channel_count_perf(&em) == 3);
+  CHECK(energymon_get_channel_name_perf(&em, 1, name, sizeof(name)) != NULL);
+  CHECK(!strcmp(name, "cpu-0:energy-psys"));
+  CHECK(energymon_get_channel_name_perf(&em, 2, name, sizeof(name)) != NULL);
+  CHECK(!strcmp(name, "cpu-1:energy-pkg"));
+  errno = 0;
+  CHECK(energymon_read_channels_perf(&em, uj, 4) ==
+        (count_val(0, CONFIG_PKG) + count_val(0, CONFIG_PSYS) + count_val(1, CONFIG_PKG)) * 1000000 && errno == 0);
+  CHECK(uj[0] == count_val(0, CONFIG_PKG) * 1000000);
+  CHECK(uj[1] == count_val(0, CONFIG_PSYS) * 1000000);
+  CHECK(uj[2] == count_val(1, CONFIG_PKG) * 1000000);
+  CHECK(em.ffinish(&em) == 0);
+  return 0;
+}
+
+int main(void) {
+  int ret;
+  if (create_fixture()) {
+    remove_fixture();
+    return 1;
+  }
+  ret = test_psys_only() || test_pkg_psys();
+  remove_fixture();
+  return ret;
+}
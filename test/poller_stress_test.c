@@ -0,0 +1,188 @@
+/**
+ * Stress test publishing energy totals from polling threads to many concurrent readers.
+ * The poller reads power from a fixture file, like the sysfs files read by polling implementations, while another
+ * thread replaces it.
+ * Power is high enough that totals cross 2^32 every few polls, so a torn total (e.g., from the 32-bit implementation
+ * of shared values, see ENERGYMON_SEQLOCK_FORCE_SPLIT) would be off by a multiple of 2^32.
+ * Run with ThreadSanitizer to check for data races.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "energymon-poller.h"
+#include "energymon-seqlock.h"
+#include "energymon-time-util.h"
+#include "energymon-util.h"
+
+#define N_READERS 8
+#define RUN_US 500000
+#define INTERVAL_US 1000
+// about 2^40 uW, so each poll adds about 2^30 uJ - multiples of 1 W keep the max energy bound exact
+#define POWER_UW_MIN 1000000000000ULL
+#define POWER_UW_MAX (2 * POWER_UW_MIN)
+
+typedef struct stress_ctx {
+  char path[64];
+  char tmp_path[64];
+  energymon_poller_source src;
+  energymon_shared_u64 pattern;
+  // the largest total any reader has returned from a read
+  uint64_t max_total;
+  uint64_t start_us;
+  int run;
+  int failed;
+} stress_ctx;
+
+static void fail(stress_ctx* c, const char* msg, uint64_t a, uint64_t b) {
+  fprintf(stderr, "%s: %"PRIu64", %"PRIu64"\n", msg, a, b);
+  __atomic_store_n(&c->failed, 1, __ATOMIC_RELAXED);
+}
+
+// reads a fixture file like the polling implementations read sysfs files
+static int fixture_read(void* ctx, uint64_t* power_uw) {
+  stress_ctx* c = (stress_ctx*) ctx;
+  char cdata[24];
+  ssize_t len;
+  int fd;
+  // the file is replaced, never rewritten, so opening it each time always gets a complete value
+  if ((fd = open(c->path, O_RDONLY)) < 0) {
+    return -1;
+  }
+  len = read(fd, cdata, sizeof(cdata));
+  close(fd);
+  if (len <= 0 || !energymon_strntou64(cdata, (size_t) len, power_uw)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (*power_uw < POWER_UW_MIN || *power_uw >= POWER_UW_MAX) {
+    fail(c, "Fixture power out of range", *power_uw, POWER_UW_MAX);
+  }
+  return 0;
+}
+
+static int fixture_write(const stress_ctx* c, uint64_t power_uw) {
+  char buf[24];
+  int len = snprintf(buf, sizeof(buf), "%"PRIu64"\n", power_uw);
+  int fd;
+  if ((fd = open(c->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    return -1;
+  }
+  if (write(fd, buf, (size_t) len) != len) {
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  return rename(c->tmp_path, c->path);
+}
+
+static void* fixture_writer(void* arg) {
+  stress_ctx* c = (stress_ctx*) arg;
+  uint64_t i;
+  for (i = 0; __atomic_load_n(&c->run, __ATOMIC_RELAXED); i++) {
+    if (fixture_write(c, POWER_UW_MIN + (i * 7919) % POWER_UW_MIN)) {
+      perror("fixture_write");
+    }
+    // both halves of the pattern are equal, so a torn read is detectable
+    energymon_shared_u64_store(&c->pattern, i << 32 | (i & 0xFFFFFFFF));
+  }
+  return NULL;
+}
+
+static void* reader(void* arg) {
+  stress_ctx* c = (stress_ctx*) arg;
+  uint64_t total;
+  uint64_t prev;
+  uint64_t pattern;
+  uint64_t start_us = c->start_us;
+  uint64_t max_uj;
+  while (__atomic_load_n(&c->run, __ATOMIC_RELAXED)) {
+    // totals must not decrease across readers: no read may return less than one that finished before it started
+    prev = __atomic_load_n(&c->max_total, __ATOMIC_ACQUIRE);
+    total = energymon_poller_get_total_uj(&c->src);
+    if (total < prev) {
+      fail(c, "Energy decreased", prev, total);
+      break;
+    }
+    while (total > prev &&
+           !__atomic_compare_exchange_n(&c->max_total, &prev, total, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+    // can't exceed the max power for the elapsed time (read the clock after the total)
+    max_uj = POWER_UW_MAX / 1000000 * (energymon_gettime_us() - start_us);
+    if (total > max_uj) {
+      fail(c, "Energy exceeds max power", total, max_uj);
+      break;
+    }
+    pattern = energymon_shared_u64_load(&c->pattern);
+    if ((pattern >> 32) != (pattern & 0xFFFFFFFF)) {
+      fail(c, "Torn read", pattern >> 32, pattern & 0xFFFFFFFF);
+      break;
+    }
+  }
+  return NULL;
+}
+
+int main(void) {
+  static stress_ctx c;
+  char dir[] = "/tmp/energymon-poller-stress-XXXXXX";
+  pthread_t readers[N_READERS];
+  pthread_t writer;
+  size_t i;
+  int ret = 0;
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  snprintf(c.path, sizeof(c.path), "%s/power", dir);
+  snprintf(c.tmp_path, sizeof(c.tmp_path), "%s/power.tmp", dir);
+  if (fixture_write(&c, POWER_UW_MIN)) {
+    perror("fixture_write");
+    rmdir(dir);
+    return 1;
+  }
+  c.src.name = "poller-stress-test";
+  c.src.read = fixture_read;
+  c.src.ctx = &c;
+  c.src.interval_us = INTERVAL_US;
+  c.run = 1;
+  c.start_us = energymon_gettime_us();
+  if (energymon_poller_start(&c.src)) {
+    perror("energymon_poller_start");
+    return 1;
+  }
+  if ((errno = pthread_create(&writer, NULL, fixture_writer, &c))) {
+    perror("pthread_create");
+    return 1;
+  }
+  for (i = 0; i < N_READERS; i++) {
+    if ((errno = pthread_create(&readers[i], NULL, reader, &c))) {
+      perror("pthread_create");
+      return 1;
+    }
+  }
+  energymon_sleep_us(RUN_US, NULL);
+  __atomic_store_n(&c.run, 0, __ATOMIC_RELAXED);
+  for (i = 0; i < N_READERS; i++) {
+    pthread_join(readers[i], NULL);
+  }
+  pthread_join(writer, NULL);
+  if (energymon_poller_stop(&c.src)) {
+    perror("energymon_poller_stop");
+    ret = 1;
+  }
+  if (energymon_poller_get_total_uj(&c.src) <= UINT32_MAX) {
+    fprintf(stderr, "Total didn't exceed 32 bits: %"PRIu64"\n", energymon_poller_get_total_uj(&c.src));
+    ret = 1;
+  }
+  unlink(c.path);
+  unlink(c.tmp_path);
+  rmdir(dir);
+  return ret || c.failed;
+}
@@ -0,0 +1,237 @@
+/**
+ * Test the internal polling engine with fake power sources.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "energymon-poller.h"
+#include "energymon-time-util.h"
+
+#define INTERVAL_US 10000
+#define RUN_US 200000
+
+#define CHECK(cond) \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+    return -1; \
+  }
+
+typedef struct fake_source {
+  uint64_t power_uw;
+  uint64_t sleep_us;
+  int fail;
+  unsigned int reads;
+  uint64_t last_read_ns;
+  int in_read;
+  // counts reads in the same wakeup as the partner's
+  const struct fake_source* partner;
+  unsigned int batched;
+} fake_source;
+
+static int fake_read(void* ctx, uint64_t* power_uw) {
+  fake_source* f = (fake_source*) ctx;
+  uint64_t now_ns;
+  __atomic_store_n(&f->in_read, 1, __ATOMIC_SEQ_CST);
+  if (f->sleep_us) {
+    energymon_sleep_us(f->sleep_us, NULL);
+  }
+  now_ns = energymon_gettime_ns();
+  __atomic_store_n(&f->last_read_ns, now_ns, __ATOMIC_SEQ_CST);
+  if (f->partner != NULL && now_ns - __atomic_load_n(&f->partner->last_read_ns, __ATOMIC_SEQ_CST) < 1000000) {
+    f->batched++;
+  }
+  __atomic_add_fetch(&f->reads, 1, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&f->in_read, 0, __ATOMIC_SEQ_CST);
+  if (f->fail) {
+    errno = EIO;
+    return -1;
+  }
+  *power_uw = f->power_uw;
+  return 0;
+}
+
+static void init_source(energymon_poller_source* src, fake_source* f, uint64_t interval_us, int dedicated) {
+  memset(src, 0, sizeof(*src));
+  src->name = "poller-test";
+  src->read = fake_read;
+  src->ctx = f;
+  src->interval_us = interval_us;
+  src->dedicated = dedicated;
+}
+
+// the integrated energy is power * time, within a couple intervals at the start and end
+static int check_total(const energymon_poller_source* src, uint64_t power_uw, uint64_t elapsed_us) {
+  uint64_t total_uj = energymon_poller_get_total_uj(src);
+  uint64_t expected_uj = power_uw * elapsed_us / 1000000;
+  uint64_t slack_uj = power_uw * 2 * src->interval_us / 1000000 + 1;
+  CHECK(total_uj <= expected_uj);
+  CHECK(total_uj + slack_uj >= expected_uj);
+  return 0;
+}
+
+static int test_integrate(int dedicated) {
+  energymon_poller_source src;
+  fake_source f = { 0 };
+  uint64_t start_us;
+  f.power_uw = 1000000;
+  init_source(&src, &f, INTERVAL_US, dedicated);
+  start_us = energymon_gettime_us();
+  CHECK(energymon_poller_start(&src) == 0);
+  energymon_sleep_us(RUN_US, NULL);
+  CHECK(energymon_poller_stop(&src) == 0);
+  CHECK(f.reads > 0);
+  CHECK(check_total(&src, f.power_uw, energymon_gettime_elapsed_us(&start_us)) == 0);
+  // stopping again does nothing
+  CHECK(energymon_poller_stop(&src) == 0);
+  return 0;
+}
+
+static int test_remainder(void) {
+  energymon_poller_source src;
+  fake_source f = { 0 };
+  uint64_t start_us;
+  // less than 1 uJ per read, which would be lost without carrying the remainder
+  f.power_uw = 50;
+  init_source(&src, &f, 1000, 0);
+  start_us = energymon_gettime_us();
+  CHECK(energymon_poller_start(&src) == 0);
+  energymon_sleep_us(RUN_US, NULL);
+  CHECK(energymon_poller_stop(&src) == 0);
+  CHECK(energymon_poller_get_total_uj(&src) > 0);
+  CHECK(check_total(&src, f.power_uw, energymon_gettime_elapsed_us(&start_us)) == 0);
+  return 0;
+}
+
+static int test_trapezoid(void) {
+  energymon_integrator in;
+  uint64_t start_us;
+  CHECK(energymon_integrator_init(&in, 0) == 0);
+  start_us = in.sample_us;
+  // the first reading has nothing to interpolate from
+  energymon_integrator_update(&in, 0, start_us);
+  CHECK(energymon_integrator_read(&in) == 0);
+  // power ramps linearly from 0 to 1 W over a second
+  energymon_integrator_update(&in, 1000000, start_us + 1000000);
+  CHECK(energymon_integrator_read(&in) == 500000);
+  // half-microjoule remainders are carried
+  energymon_integrator_update(&in, 0, start_us + 1000001);
+  energymon_integrator_update(&in, 1000000, start_us + 1000002);
+  CHECK(energymon_integrator_read(&in) == 500001);
+  // a skipped interval isn't integrated, and the next one starts from the new reading
+  energymon_integrator_skip(&in, start_us + 2000000);
+  energymon_integrator_update(&in, 2000000, start_us + 3000000);
+  CHECK(energymon_integrator_read(&in) == 2500001);
+  return 0;
+}
+
+static int test_failure(void) {
+  energymon_poller_source src;
+  fake_source f = { 0 };
+  f.power_uw = 1000000;
+  f.fail = 1;
+  init_source(&src, &f, INTERVAL_US, 0);
+  CHECK(energymon_poller_start(&src) == 0);
+  energymon_sleep_us(5 * INTERVAL_US, NULL);
+  CHECK(energymon_poller_stop(&src) == 0);
+  // failed reads aren't integrated
+  CHECK(f.reads > 0);
+  CHECK(energymon_poller_get_total_uj(&src) == 0);
+  return 0;
+}
+
+static int test_batching(void) {
+  energymon_poller_source src1;
+  energymon_poller_source src2;
+  fake_source f1 = { 0 };
+  fake_source f2 = { 0 };
+  init_source(&src1, &f1, INTERVAL_US, 0);
+  init_source(&src2, &f2, 2 * INTERVAL_US, 0);
+  f1.partner = &f2;
+  f2.partner = &f1;
+  CHECK(energymon_poller_start(&src1) == 0);
+  CHECK(energymon_poller_start(&src2) == 0);
+  energymon_sleep_us(RUN_US, NULL);
+  CHECK(energymon_poller_stop(&src2) == 0);
+  CHECK(energymon_poller_stop(&src1) == 0);
+  CHECK(f1.reads > f2.reads && f2.reads > 0);
+  // the slower source's deadlines are a subset of the faster source's, so they're read in the same wakeup
+  // (allowing for some wakeups to be late)
+  CHECK(2 * (f1.batched + f2.batched) >= f2.reads);
+  return 0;
+}
+
+static int test_stop_during_read(int dedicated) {
+  energymon_poller_source src;
+  fake_source f = { 0 };
+  unsigned int reads;
+  f.sleep_us = 3 * INTERVAL_US;
+  init_source(&src, &f, INTERVAL_US, dedicated);
+  CHECK(energymon_poller_start(&src) == 0);
+  while (!__atomic_load_n(&f.in_read, __ATOMIC_SEQ_CST)) {
+    energymon_sleep_us(1000, NULL);
+  }
+  // waits for the read to finish, after which there are no more reads
+  CHECK(energymon_poller_stop(&src) == 0);
+  CHECK(!__atomic_load_n(&f.in_read, __ATOMIC_SEQ_CST));
+  reads = __atomic_load_n(&f.reads, __ATOMIC_SEQ_CST);
+  energymon_sleep_us(5 * INTERVAL_US, NULL);
+  CHECK(__atomic_load_n(&f.reads, __ATOMIC_SEQ_CST) == reads);
+  return 0;
+}
+
+static int test_extrapolate(void) {
+  energymon_poller_source src;
+  fake_source f = { 0 };
+  uint64_t last_uj;
+  uint64_t total_uj;
+  unsigned int i;
+  f.power_uw = 1000000;
+  CHECK(setenv(ENERGYMON_ENABLE_ESTIMATES, "1", 1) == 0);
+  init_source(&src, &f, 10 * INTERVAL_US, 0);
+  CHECK(energymon_poller_start(&src) == 0);
+  CHECK(unsetenv(ENERGYMON_ENABLE_ESTIMATES) == 0);
+  while (!__atomic_load_n(&f.reads, __ATOMIC_SEQ_CST)) {
+    energymon_sleep_us(1000, NULL);
+  }
+  // reads between polls advance with the last power, and never go backward when the next poll is integrated
+  for (i = 0, last_uj = energymon_poller_get_total_uj(&src); i < 30; i++, last_uj = total_uj) {
+    energymon_sleep_us(INTERVAL_US / 2, NULL);
+    total_uj = energymon_poller_get_total_uj(&src);
+    CHECK(total_uj > last_uj);
+  }
+  CHECK(energymon_poller_stop(&src) == 0);
+  // extrapolation is capped at one interval
+  last_uj = energymon_poller_get_total_uj(&src);
+  energymon_sleep_us(20 * INTERVAL_US, NULL);
+  CHECK(energymon_poller_get_total_uj(&src) <= last_uj + f.power_uw * src.interval_us / 1000000);
+  return 0;
+}
+
+static int test_invalid(void) {
+  energymon_poller_source src;
+  fake_source f = { 0 };
+  init_source(&src, &f, 0, 0);
+  CHECK(energymon_poller_start(&src) == -1 && errno == EINVAL);
+  init_source(&src, &f, INTERVAL_US, 0);
+  src.read = NULL;
+  CHECK(energymon_poller_start(&src) == -1 && errno == EINVAL);
+  return 0;
+}
+
+int main(void) {
+  return test_integrate(0) ||
+         test_integrate(1) ||
+         test_remainder() ||
+         test_trapezoid() ||
+         test_failure() ||
+         test_batching() ||
+         test_stop_during_read(0) ||
+         test_stop_during_read(1) ||
+         test_extrapolate() ||
+         test_invalid();
+}
@@ -0,0 +1,100 @@
+/**
+ * Minimal mock of the raplcap and raplcap-msr APIs used by energymon-raplcap-msr.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include "raplcap.h"
+#include "raplcap-msr.h"
+
+#define MOCK_RAPLCAP_ZONES (RAPLCAP_ZONE_PSYS + 1)
+
+static uint32_t mock_n_pkg;
+static uint32_t mock_n_die[MOCK_RAPLCAP_MAX_PKG];
+static unsigned int mock_zones_supported;
+static uint32_t mock_counters[MOCK_RAPLCAP_MAX_PKG][MOCK_RAPLCAP_MAX_DIE][MOCK_RAPLCAP_ZONES];
+static uint64_t mock_reads;
+
+void mock_raplcap_set_layout(uint32_t n_pkg, const uint32_t* n_die, unsigned int zones_supported) {
+  uint32_t pkg;
+  mock_n_pkg = n_pkg;
+  for (pkg = 0; pkg < n_pkg; pkg++) {
+    mock_n_die[pkg] = n_die[pkg];
+  }
+  mock_zones_supported = zones_supported;
+  memset(mock_counters, 0, sizeof(mock_counters));
+  mock_reads = 0;
+}
+
+void mock_raplcap_set_counter(uint32_t pkg, uint32_t die, raplcap_zone zone, uint32_t raw) {
+  mock_counters[pkg][die][zone] = raw;
+}
+
+uint64_t mock_raplcap_get_reads(void) {
+  return mock_reads;
+}
+
+static int mock_check(uint32_t pkg, uint32_t die, raplcap_zone zone) {
+  if (pkg >= mock_n_pkg || die >= mock_n_die[pkg] || (unsigned int) zone >= MOCK_RAPLCAP_ZONES) {
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+int raplcap_init(raplcap* rc) {
+  rc->nsockets = mock_n_pkg;
+  rc->state = NULL;
+  return 0;
+}
+
+int raplcap_destroy(raplcap* rc) {
+  (void) rc;
+  return 0;
+}
+
+uint32_t raplcap_get_num_packages(const raplcap* rc) {
+  (void) rc;
+  if (mock_n_pkg == 0) {
+    errno = ENODEV;
+  }
+  return mock_n_pkg;
+}
+
+uint32_t raplcap_get_num_die(const raplcap* rc, uint32_t pkg) {
+  (void) rc;
+  if (pkg >= mock_n_pkg) {
+    errno = EINVAL;
+    return 0;
+  }
+  return mock_n_die[pkg];
+}
+
+int raplcap_pd_is_zone_supported(const raplcap* rc, uint32_t pkg, uint32_t die, raplcap_zone zone) {
+  (void) rc;
+  if (mock_check(pkg, die, zone)) {
+    return -1;
+  }
+  return (mock_zones_supported >> zone) & 1;
+}
+
+double raplcap_msr_pd_get_energy_units(const raplcap* rc, uint32_t pkg, uint32_t die, raplcap_zone zone) {
+  (void) rc;
+  if (mock_check(pkg, die, zone)) {
+    return -1;
+  }
+  return zone == RAPLCAP_ZONE_DRAM ? MOCK_RAPLCAP_UNITS_DRAM : MOCK_RAPLCAP_UNITS;
+}
+
+double raplcap_pd_get_energy_counter(const raplcap* rc, uint32_t pkg, uint32_t die, raplcap_zone zone) {
+  (void) rc;
+  if (mock_check(pkg, die, zone)) {
+    return -1;
+  }
+  mock_reads++;
+  return mock_counters[pkg][die][zone] *
+         (zone == RAPLCAP_ZONE_DRAM ? MOCK_RAPLCAP_UNITS_DRAM : MOCK_RAPLCAP_UNITS);
+}
@@ -0,0 +1,23 @@
+/**
+ * Minimal mock of the raplcap-msr API used by energymon-raplcap-msr.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _RAPLCAP_MSR_MOCK_H_
+#define _RAPLCAP_MSR_MOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "raplcap.h"
+
+double raplcap_msr_pd_get_energy_units(const raplcap* rc, uint32_t pkg, uint32_t die, raplcap_zone zone);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * Minimal mock of the raplcap API used by energymon-raplcap-msr, for testing without the real library or MSRs.
+ * Only the subset of the API that energymon uses is declared.
+ * The package/die layout and energy counters are controlled by the test through the mock_raplcap_* functions.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#ifndef _RAPLCAP_MOCK_H_
+#define _RAPLCAP_MOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef struct raplcap {
+  uint32_t nsockets;
+  void* state;
+} raplcap;
+
+typedef enum raplcap_zone {
+  RAPLCAP_ZONE_PACKAGE = 0,
+  RAPLCAP_ZONE_CORE,
+  RAPLCAP_ZONE_UNCORE,
+  RAPLCAP_ZONE_DRAM,
+  RAPLCAP_ZONE_PSYS,
+} raplcap_zone;
+
+int raplcap_init(raplcap* rc);
+
+int raplcap_destroy(raplcap* rc);
+
+uint32_t raplcap_get_num_packages(const raplcap* rc);
+
+uint32_t raplcap_get_num_die(const raplcap* rc, uint32_t pkg);
+
+int raplcap_pd_is_zone_supported(const raplcap* rc, uint32_t pkg, uint32_t die, raplcap_zone zone);
+
+double raplcap_pd_get_energy_counter(const raplcap* rc, uint32_t pkg, uint32_t die, raplcap_zone zone);
+
+/**
+ * Set the package/die layout and reset all counters.
+ *
+ * @param n_pkg
+ *  the number of packages, at most MOCK_RAPLCAP_MAX_PKG
+ * @param n_die
+ *  die counts for each package, each at most MOCK_RAPLCAP_MAX_DIE
+ * @param zones_supported
+ *  bitmask of supported zones, where zone Z is bit (1 << Z)
+ */
+void mock_raplcap_set_layout(uint32_t n_pkg, const uint32_t* n_die, unsigned int zones_supported);
+
+/**
+ * Set the raw 32-bit energy counter for a zone.
+ */
+void mock_raplcap_set_counter(uint32_t pkg, uint32_t die, raplcap_zone zone, uint32_t raw);
+
+/**
+ * Get the number of counter reads since the layout was last set.
+ */
+uint64_t mock_raplcap_get_reads(void);
+
+#define MOCK_RAPLCAP_MAX_PKG 8
+#define MOCK_RAPLCAP_MAX_DIE 8
+// Joules per raw count: 2^-14 J, except DRAM, which uses 2^-16 J (as on many server parts)
+#define MOCK_RAPLCAP_UNITS (1.0 / (1 << 14))
+#define MOCK_RAPLCAP_UNITS_DRAM (1.0 / (1 << 16))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
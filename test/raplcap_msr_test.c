@@ -0,0 +1,175 @@
+/**
+ * Test energymon-raplcap-msr instance indexing, zones, and channels against a mocked raplcap.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <raplcap.h>
+#include "energymon.h"
+#include "energymon-raplcap-msr.h"
+
+#define ZONE_BIT(z) (1U << (z))
+
+#define CHECK(cond) \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+    return -1; \
+  }
+
+// exact expected energy: raw * units * 10^6, where units are 2^-14 J (or 2^-16 J for DRAM)
+static uint64_t expected_uj(uint64_t raw, raplcap_zone zone) {
+  return raw * 15625 / (zone == RAPLCAP_ZONE_DRAM ? 1024 : 256);
+}
+
+// a distinct counter value for every (pkg, die, zone)
+static uint32_t counter_val(uint32_t pkg, uint32_t die, raplcap_zone zone) {
+  return 1000000 * (pkg + 1) + 10000 * (die + 1) + 100 * (zone + 1);
+}
+
+static void set_counters(const uint32_t* n_die, uint32_t n_pkg) {
+  uint32_t pkg;
+  uint32_t die;
+  int zone;
+  for (pkg = 0; pkg < n_pkg; pkg++) {
+    for (die = 0; die < n_die[pkg]; die++) {
+      for (zone = RAPLCAP_ZONE_PACKAGE; zone <= RAPLCAP_ZONE_PSYS; zone++) {
+        mock_raplcap_set_counter(pkg, die, (raplcap_zone) zone, counter_val(pkg, die, (raplcap_zone) zone));
+      }
+    }
+  }
+}
+
+/**
+ * Every (pkg, die) gets its own channel with its own counter, in package-then-die order.
+ */
+static int test_layout(const uint32_t* n_die, uint32_t n_pkg) {
+  energymon em;
+  uint64_t uj[64];
+  uint64_t total;
+  uint64_t sum;
+  char name[64];
+  char exp_name[64];
+  uint32_t pkg;
+  uint32_t die;
+  size_t n;
+  size_t ch;
+  mock_raplcap_set_layout(n_pkg, n_die, ZONE_BIT(RAPLCAP_ZONE_PACKAGE));
+  set_counters(n_die, n_pkg);
+  CHECK(energymon_get_raplcap_msr(&em) == 0);
+  CHECK(em.finit(&em) == 0);
+  n = energymon_get_channel_count_raplcap_msr(&em);
+  total = energymon_read_channels_raplcap_msr(&em, uj, n);
+  for (sum = 0, ch = 0, pkg = 0; pkg < n_pkg; pkg++) {
+    for (die = 0; die < n_die[pkg]; die++, ch++) {
+      CHECK(ch < n);
+      CHECK(uj[ch] == expected_uj(counter_val(pkg, die, RAPLCAP_ZONE_PACKAGE), RAPLCAP_ZONE_PACKAGE));
+      snprintf(exp_name, sizeof(exp_name), "package-%"PRIu32"-die-%"PRIu32":PACKAGE", pkg, die);
+      CHECK(energymon_get_channel_name_raplcap_msr(&em, ch, name, sizeof(name)) != NULL);
+      CHECK(!strcmp(name, exp_name));
+      sum += uj[ch];
+    }
+  }
+  CHECK(ch == n);
+  CHECK(total == sum);
+  CHECK(energymon_get_channel_name_raplcap_msr(&em, n, name, sizeof(name)) == NULL && errno == EINVAL);
+  CHECK(em.ffinish(&em) == 0);
+  return 0;
+}
+
+/**
+ * Overflow state must not be shared between instances, including the last die of one package and the first die of
+ * the next.
+ */
+static int test_overflow_isolation(void) {
+  static const uint32_t n_die[] = { 2, 2 };
+  energymon em;
+  uint64_t uj[4];
+  mock_raplcap_set_layout(2, n_die, ZONE_BIT(RAPLCAP_ZONE_PACKAGE));
+  mock_raplcap_set_counter(0, 1, RAPLCAP_ZONE_PACKAGE, UINT32_MAX - 9);
+  mock_raplcap_set_counter(1, 0, RAPLCAP_ZONE_PACKAGE, 100);
+  CHECK(energymon_get_raplcap_msr(&em) == 0);
+  CHECK(em.finit(&em) == 0);
+  CHECK(energymon_read_channels_raplcap_msr(&em, uj, 4) > 0);
+  // (0, 1) wraps around by 20 counts, (1, 0) advances by 20 counts
+  mock_raplcap_set_counter(0, 1, RAPLCAP_ZONE_PACKAGE, 10);
+  mock_raplcap_set_counter(1, 0, RAPLCAP_ZONE_PACKAGE, 120);
+  CHECK(energymon_read_channels_raplcap_msr(&em, uj, 4) > 0);
+  CHECK(uj[0] == 0);
+  CHECK(uj[1] == expected_uj((uint64_t) UINT32_MAX - 9 + 20, RAPLCAP_ZONE_PACKAGE));
+  CHECK(uj[2] == expected_uj(120, RAPLCAP_ZONE_PACKAGE));
+  CHECK(uj[3] == 0);
+  CHECK(em.ffinish(&em) == 0);
+  return 0;
+}
+
+/**
+ * Selected instances are indexed across packages with different die counts, and each reads all zones.
+ */
+static int test_instances_zones(void) {
+  static const uint32_t n_die[] = { 1, 3, 2 };
+  energymon em;
+  uint64_t uj[8];
+  char name[64];
+  uint64_t reads;
+  mock_raplcap_set_layout(3, n_die, ZONE_BIT(RAPLCAP_ZONE_PACKAGE) | ZONE_BIT(RAPLCAP_ZONE_DRAM));
+  set_counters(n_die, 3);
+  // instances: 0 = (0, 0), 1-3 = (1, 0-2), 4-5 = (2, 0-1)
+  CHECK(setenv(ENERGYMON_RAPLCAP_MSR_INSTANCES, "3,4", 1) == 0);
+  // zones are always ordered the same way, and repeats are ignored
+  CHECK(setenv(ENERGYMON_RAPLCAP_MSR_ZONE, "DRAM,PACKAGE,DRAM", 1) == 0);
+  CHECK(energymon_get_raplcap_msr(&em) == 0);
+  CHECK(em.finit(&em) == 0);
+  CHECK(energymon_get_channel_count_raplcap_msr(&em) == 4);
+  CHECK(!strcmp(energymon_get_channel_name_raplcap_msr(&em, 0, name, sizeof(name)), "package-1-die-2:PACKAGE"));
+  CHECK(!strcmp(energymon_get_channel_name_raplcap_msr(&em, 1, name, sizeof(name)), "package-1-die-2:DRAM"));
+  CHECK(!strcmp(energymon_get_channel_name_raplcap_msr(&em, 2, name, sizeof(name)), "package-2-die-0:PACKAGE"));
+  CHECK(!strcmp(energymon_get_channel_name_raplcap_msr(&em, 3, name, sizeof(name)), "package-2-die-0:DRAM"));
+  reads = mock_raplcap_get_reads();
+  CHECK(energymon_read_channels_raplcap_msr(&em, uj, 4) == uj[0] + uj[1] + uj[2] + uj[3]);
+  // one counter read per channel
+  CHECK(mock_raplcap_get_reads() - reads == 4);
+  CHECK(uj[0] == expected_uj(counter_val(1, 2, RAPLCAP_ZONE_PACKAGE), RAPLCAP_ZONE_PACKAGE));
+  CHECK(uj[1] == expected_uj(counter_val(1, 2, RAPLCAP_ZONE_DRAM), RAPLCAP_ZONE_DRAM));
+  CHECK(uj[2] == expected_uj(counter_val(2, 0, RAPLCAP_ZONE_PACKAGE), RAPLCAP_ZONE_PACKAGE));
+  CHECK(uj[3] == expected_uj(counter_val(2, 0, RAPLCAP_ZONE_DRAM), RAPLCAP_ZONE_DRAM));
+  // precision is limited by the coarsest units
+  CHECK(em.fprecision(&em) == 61);
+  CHECK(em.ffinish(&em) == 0);
+
+  // the last instance is in range, the next one isn't
+  CHECK(setenv(ENERGYMON_RAPLCAP_MSR_INSTANCES, "5", 1) == 0);
+  CHECK(em.finit(&em) == 0);
+  CHECK(em.ffinish(&em) == 0);
+  CHECK(setenv(ENERGYMON_RAPLCAP_MSR_INSTANCES, "6", 1) == 0);
+  CHECK(em.finit(&em) == -1 && errno == ERANGE);
+
+  CHECK(unsetenv(ENERGYMON_RAPLCAP_MSR_INSTANCES) == 0);
+  CHECK(setenv(ENERGYMON_RAPLCAP_MSR_ZONE, "PACKAGE,CORE", 1) == 0);
+  CHECK(em.finit(&em) == -1 && errno == EINVAL);
+  CHECK(setenv(ENERGYMON_RAPLCAP_MSR_ZONE, "PACKAGE,FOO", 1) == 0);
+  CHECK(em.finit(&em) == -1 && errno == EINVAL);
+  CHECK(unsetenv(ENERGYMON_RAPLCAP_MSR_ZONE) == 0);
+  return 0;
+}
+
+int main(void) {
+  static const uint32_t layout_1x1[] = { 1 };
+  static const uint32_t layout_2x2[] = { 2, 2 };
+  static const uint32_t layout_mixed[] = { 1, 3, 2, 1 };
+  CHECK(unsetenv(ENERGYMON_RAPLCAP_MSR_INSTANCES) == 0);
+  CHECK(unsetenv(ENERGYMON_RAPLCAP_MSR_ZONE) == 0);
+  if (test_layout(layout_1x1, 1) ||
+      test_layout(layout_2x2, 2) ||
+      test_layout(layout_mixed, 4) ||
+      test_overflow_isolation() ||
+      test_instances_zones()) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,231 @@
+/**
+ * Microbenchmark energymon_read_total_shmem latency (through the energymon function pointer) and the inline
+ * energymon_read_view_shmem latency for the v1 and v2 shared memory layouts.
+ * The v2 layout is measured with an idle provider and with a provider that updates continuously from another thread,
+ * which forces the seqlock reader to observe concurrent writes.
+ * Results are in nanoseconds per read.
+ * Also measures the latency from an update being published to a consumer blocked in energymon_wait_shmem waking up.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+#include "energymon.h"
+#include "energymon-futex.h"
+#include "energymon-seqlock.h"
+#include "energymon-shmem.h"
+#include "energymon-shmem-inline.h"
+#include "energymon-time-util.h"
+
+#define BENCH_ITERATIONS 10000000
+#define BENCH_KEY_ID 42
+#define BENCH_WAKEUPS 1000
+#define BENCH_WAKEUP_INTERVAL_US 1000
+
+static volatile int writer_run;
+
+static void* writer(void* arg) {
+  energymon_shmem_v2* ems = (energymon_shmem_v2*) arg;
+  energymon_seqlock* sl = (energymon_seqlock*) &ems->seq;
+  uint64_t energy_uj = 0;
+  while (writer_run) {
+    energymon_seqlock_write_begin(sl);
+    energymon_seqlock_store(&ems->energy_uj, ++energy_uj);
+    energymon_seqlock_store(&ems->update_time_ns, energymon_gettime_ns());
+    energymon_seqlock_write_end(sl);
+  }
+  return NULL;
+}
+
+static void* periodic_writer(void* arg) {
+  energymon_shmem_v2* ems = (energymon_shmem_v2*) arg;
+  energymon_seqlock* sl = (energymon_seqlock*) &ems->seq;
+  uint64_t energy_uj = 0;
+  energymon_timer timer;
+  if (energymon_timer_init(&timer, BENCH_WAKEUP_INTERVAL_US)) {
+    return NULL;
+  }
+  while (writer_run) {
+    energymon_timer_wait(&timer, NULL);
+    energymon_seqlock_write_begin(sl);
+    energymon_seqlock_store(&ems->energy_uj, ++energy_uj);
+    energymon_seqlock_store(&ems->update_time_ns, energymon_gettime_ns());
+    energymon_seqlock_write_end(sl);
+    energymon_futex_bump(&ems->futex);
+  }
+  return NULL;
+}
+
+static int bench_read(unsigned long iterations, double* ns, double* inline_ns) {
+  energymon em;
+  energymon_shmem_view view;
+  uint64_t start_ns;
+  uint64_t last = 0;
+  uint64_t e;
+  unsigned long i;
+  energymon_get_shmem(&em);
+  if (em.finit(&em)) {
+    perror("energymon_init_shmem");
+    return -1;
+  }
+  if (energymon_get_view_shmem(&em, &view)) {
+    perror("energymon_get_view_shmem");
+    em.ffinish(&em);
+    return -1;
+  }
+  start_ns = energymon_gettime_ns();
+  for (i = 0; i < iterations; i++) {
+    // values must never go backwards, even with concurrent updates
+    if ((e = em.fread(&em)) < last) {
+      fprintf(stderr, "Energy went backwards: %"PRIu64" < %"PRIu64"\n", e, last);
+      em.ffinish(&em);
+      return -1;
+    }
+    last = e;
+  }
+  *ns = (double) (energymon_gettime_ns() - start_ns) / iterations;
+  start_ns = energymon_gettime_ns();
+  for (i = 0; i < iterations; i++) {
+    if ((e = energymon_read_view_shmem(&view)) < last) {
+      fprintf(stderr, "Energy went backwards (inline): %"PRIu64" < %"PRIu64"\n", e, last);
+      em.ffinish(&em);
+      return -1;
+    }
+    last = e;
+  }
+  *inline_ns = (double) (energymon_gettime_ns() - start_ns) / iterations;
+  return em.ffinish(&em);
+}
+
+static int bench_wait(double* ns) {
+  energymon em;
+  uint64_t total_ns = 0;
+  uint64_t last;
+  int i;
+  energymon_get_shmem(&em);
+  if (em.finit(&em)) {
+    perror("energymon_init_shmem");
+    return -1;
+  }
+  last = energymon_get_update_time_shmem(&em);
+  for (i = 0; i < BENCH_WAKEUPS; i++) {
+    if ((last = energymon_wait_shmem(&em, last, 1000000)) == 0) {
+      perror("energymon_wait_shmem");
+      em.ffinish(&em);
+      return -1;
+    }
+    total_ns += energymon_gettime_ns() - last;
+  }
+  *ns = (double) total_ns / BENCH_WAKEUPS;
+  return em.ffinish(&em);
+}
+
+static int create_segment(key_t key, size_t size, int* shm_id, void** mem) {
+  if ((*shm_id = shmget(key, size, 0644 | IPC_CREAT | IPC_EXCL)) < 0) {
+    perror("shmget");
+    return -1;
+  }
+  if ((*mem = shmat(*shm_id, NULL, 0)) == (void*) -1) {
+    perror("shmat");
+    shmctl(*shm_id, IPC_RMID, NULL);
+    return -1;
+  }
+  return 0;
+}
+
+static void destroy_segment(int shm_id, void* mem) {
+  shmdt(mem);
+  shmctl(shm_id, IPC_RMID, NULL);
+}
+
+int main(int argc, char** argv) {
+  char dir[] = "/tmp/energymon-shmem-bench-XXXXXX";
+  char id[8];
+  unsigned long iterations = BENCH_ITERATIONS;
+  energymon_shmem* v1;
+  energymon_shmem_v2* v2;
+  pthread_t thread;
+  double v1_ns = 0;
+  double v1_inline_ns = 0;
+  double v2_ns = 0;
+  double v2_inline_ns = 0;
+  double v2_contended_ns = 0;
+  double v2_contended_inline_ns = 0;
+  double wakeup_ns = 0;
+  key_t key;
+  int shm_id;
+  int ret = 0;
+  if (argc > 1) {
+    iterations = strtoul(argv[1], NULL, 0);
+  }
+  if (iterations == 0) {
+    fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+    return EINVAL;
+  }
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  snprintf(id, sizeof(id), "%d", BENCH_KEY_ID);
+  setenv(ENERGYMON_SHMEM_DIR, dir, 1);
+  setenv(ENERGYMON_SHMEM_ID, id, 1);
+  key = ftok(dir, BENCH_KEY_ID);
+
+  if (create_segment(key, sizeof(energymon_shmem), &shm_id, (void**) &v1) == 0) {
+    v1->interval_us = 1000;
+    v1->energy_uj = 1;
+    ret |= bench_read(iterations, &v1_ns, &v1_inline_ns);
+    destroy_segment(shm_id, v1);
+  } else {
+    ret = -1;
+  }
+
+  if (create_segment(key, sizeof(energymon_shmem_v2), &shm_id, (void**) &v2) == 0) {
+    v2->abi_version = ENERGYMON_SHMEM_ABI_VERSION;
+    v2->pid = (int32_t) getpid();
+    v2->interval_us = 1000;
+    v2->flags = ENERGYMON_SHMEM_FLAG_FUTEX;
+    __atomic_store_n(&v2->magic, ENERGYMON_SHMEM_MAGIC, __ATOMIC_RELEASE);
+    ret |= bench_read(iterations, &v2_ns, &v2_inline_ns);
+    writer_run = 1;
+    if ((errno = pthread_create(&thread, NULL, writer, v2))) {
+      perror("pthread_create");
+      ret = -1;
+    } else {
+      ret |= bench_read(iterations, &v2_contended_ns, &v2_contended_inline_ns);
+      writer_run = 0;
+      pthread_join(thread, NULL);
+    }
+    writer_run = 1;
+    if ((errno = pthread_create(&thread, NULL, periodic_writer, v2))) {
+      perror("pthread_create");
+      ret = -1;
+    } else {
+      ret |= bench_wait(&wakeup_ns);
+      writer_run = 0;
+      pthread_join(thread, NULL);
+    }
+    destroy_segment(shm_id, v2);
+  } else {
+    ret = -1;
+  }
+
+  rmdir(dir);
+  if (ret) {
+    return 1;
+  }
+  printf("v1: %.2f ns (inline: %.2f ns)\n", v1_ns, v1_inline_ns);
+  printf("v2: %.2f ns (inline: %.2f ns)\n", v2_ns, v2_inline_ns);
+  printf("v2 (concurrent writer): %.2f ns (inline: %.2f ns)\n", v2_contended_ns, v2_contended_inline_ns);
+  printf("v2 wakeup latency: %.2f ns\n", wakeup_ns);
+  return 0;
+}
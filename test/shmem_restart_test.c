@@ -0,0 +1,299 @@
+/**
+ * Test that shmem consumers follow a provider that restarts while they're reading, without energy ever decreasing.
+ * The provider is faked in-process with System V shared memory: it first retires cleanly, then "crashes" (stops
+ * updating without retiring) and has its memory replaced, then crashes during an update.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <time.h>
+#include <unistd.h>
+#include "energymon.h"
+#include "energymon-futex.h"
+#include "energymon-seqlock.h"
+#include "energymon-shmem.h"
+#include "energymon-shmem-inline.h"
+#include "energymon-time-util.h"
+
+#define TEST_KEY_ID 43
+#define INTERVAL_US 1000
+#define ENERGY_PER_UPDATE_UJ 1000
+#define N_READERS 2
+// long enough for readers to see some updates, and for consumers to notice a crashed provider's stale data
+#define RUN_US 200000
+#define CRASH_WAIT_US 2000000
+
+typedef struct provider {
+  energymon_shmem_v2* ems;
+  int shm_id;
+} provider;
+
+static key_t key;
+// the provider that the writer updates, or NULL while none is running
+static energymon_shmem_v2* current = NULL;
+static pthread_mutex_t current_lock = PTHREAD_MUTEX_INITIALIZER;
+// the provider whose memory still needs to be removed
+static provider* live = NULL;
+static int writer_running = 1;
+static int running = 1;
+static int failed = 0;
+
+static void set_current(energymon_shmem_v2* ems) {
+  pthread_mutex_lock(&current_lock);
+  current = ems;
+  pthread_mutex_unlock(&current_lock);
+}
+
+static int create_provider(provider* p, uint32_t generation) {
+  if ((p->shm_id = shmget(key, sizeof(energymon_shmem_v2), 0644 | IPC_CREAT | IPC_EXCL)) < 0) {
+    perror("shmget");
+    return -1;
+  }
+  if ((p->ems = shmat(p->shm_id, NULL, 0)) == (void*) -1) {
+    perror("shmat");
+    shmctl(p->shm_id, IPC_RMID, NULL);
+    return -1;
+  }
+  p->ems->abi_version = ENERGYMON_SHMEM_ABI_VERSION;
+  p->ems->interval_us = INTERVAL_US;
+  p->ems->flags = ENERGYMON_SHMEM_FLAG_FUTEX;
+  p->ems->generation = generation;
+  p->ems->update_time_ns = energymon_gettime_ns();
+  __atomic_store_n(&p->ems->magic, ENERGYMON_SHMEM_MAGIC, __ATOMIC_RELEASE);
+  set_current(p->ems);
+  live = p;
+  return 0;
+}
+
+// consumers keep the memory until they detach - the writer must not be updating it
+static void remove_provider(provider* p) {
+  shmctl(p->shm_id, IPC_RMID, NULL);
+  shmdt(p->ems);
+  live = NULL;
+}
+
+static void retire_provider(provider* p) {
+  set_current(NULL);
+  __atomic_or_fetch(&p->ems->flags, ENERGYMON_SHMEM_FLAG_RETIRED, __ATOMIC_RELEASE);
+  energymon_futex_bump(&p->ems->futex);
+}
+
+static void* writer(void* arg) {
+  energymon_seqlock* sl;
+  energymon_shmem_v2* ems;
+  energymon_timer timer;
+  (void) arg;
+  if (energymon_timer_init(&timer, INTERVAL_US)) {
+    perror("energymon_timer_init");
+    __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  while (__atomic_load_n(&writer_running, __ATOMIC_RELAXED)) {
+    energymon_timer_wait(&timer, NULL);
+    pthread_mutex_lock(&current_lock);
+    if ((ems = current) != NULL) {
+      sl = (energymon_seqlock*) &ems->seq;
+      energymon_seqlock_write_begin(sl);
+      energymon_seqlock_store(&ems->energy_uj, energymon_seqlock_load(&ems->energy_uj) + ENERGY_PER_UPDATE_UJ);
+      energymon_seqlock_store(&ems->update_time_ns, energymon_gettime_ns());
+      energymon_seqlock_write_end(sl);
+      energymon_futex_bump(&ems->futex);
+    }
+    pthread_mutex_unlock(&current_lock);
+  }
+  return NULL;
+}
+
+static void* reader(void* arg) {
+  const energymon* em = (const energymon*) arg;
+  uint64_t last = 0;
+  uint64_t e;
+  while (__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+    errno = 0;
+    e = em->fread(em);
+    if (errno == EAGAIN) {
+      // the provider crashed during an update and hasn't been replaced yet
+      continue;
+    }
+    if (errno) {
+      perror("fread");
+      __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+      break;
+    }
+    if (e < last) {
+      fprintf(stderr, "Energy went backwards: %"PRIu64" < %"PRIu64"\n", e, last);
+      __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+      break;
+    }
+    last = e;
+  }
+  return NULL;
+}
+
+// waiters must follow the restarts too, including the crashed provider that never wakes them
+static void* waiter(void* arg) {
+  const energymon* em = (const energymon*) arg;
+  uint64_t last = 0;
+  uint64_t t;
+  while (__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+    if ((t = energymon_wait_shmem(em, last, CRASH_WAIT_US)) == 0) {
+      perror("energymon_wait_shmem");
+      __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+      break;
+    }
+    last = t;
+  }
+  return NULL;
+}
+
+static void sleep_us(uint64_t us) {
+  const struct timespec ts = { (time_t) (us / 1000000), (long) (us % 1000000) * 1000 };
+  nanosleep(&ts, NULL);
+}
+
+static int restart(energymon* em, provider* p) {
+  energymon_shmem_view view;
+  uint64_t view_uj;
+  uint64_t before;
+  uint64_t after;
+
+  // a clean restart: the successor starts from 0, below what consumers have seen
+  before = em->fread(em);
+  retire_provider(&p[0]);
+  remove_provider(&p[0]);
+  if (create_provider(&p[1], 2)) {
+    return -1;
+  }
+  sleep_us(RUN_US);
+  after = em->fread(em);
+  if (energymon_get_generation_shmem(em) != 2 || after < before) {
+    fprintf(stderr, "Didn't follow a retired provider: generation=%"PRIu32", %"PRIu64" -> %"PRIu64"\n",
+            energymon_get_generation_shmem(em), before, after);
+    return -1;
+  }
+  // a new view continues from the old provider too
+  if (energymon_get_view_shmem(em, &view)) {
+    perror("energymon_get_view_shmem");
+    return -1;
+  }
+  before = em->fread(em);
+  view_uj = energymon_read_view_shmem(&view);
+  after = em->fread(em);
+  if (view_uj < before || view_uj > after) {
+    fprintf(stderr, "View doesn't match the consumer: %"PRIu64" not in [%"PRIu64", %"PRIu64"]\n", view_uj, before,
+            after);
+    return -1;
+  }
+
+  // a crash: the provider stops updating without retiring, and its memory is replaced
+  before = em->fread(em);
+  set_current(NULL);
+  remove_provider(&p[1]);
+  if (create_provider(&p[2], 3)) {
+    return -1;
+  }
+  sleep_us(CRASH_WAIT_US);
+  after = em->fread(em);
+  if (energymon_get_generation_shmem(em) != 3 || after < before) {
+    fprintf(stderr, "Didn't follow a crashed provider: generation=%"PRIu32", %"PRIu64" -> %"PRIu64"\n",
+            energymon_get_generation_shmem(em), before, after);
+    return -1;
+  }
+
+  // a crash during an update: the sequence lock stays held, so reads must give up instead of waiting forever
+  set_current(NULL);
+  before = em->fread(em);
+  energymon_seqlock_write_begin((energymon_seqlock*) &p[2].ems->seq);
+  errno = 0;
+  if (em->fread(em) != 0 || errno != EAGAIN) {
+    perror("Didn't fail reading from a provider that crashed during an update");
+    return -1;
+  }
+  errno = 0;
+  if (energymon_get_view_shmem(em, &view) || energymon_read_view_shmem(&view) != 0 || errno != EAGAIN) {
+    perror("Didn't fail reading a view of a provider that crashed during an update");
+    return -1;
+  }
+  remove_provider(&p[2]);
+  if (create_provider(&p[3], 4)) {
+    return -1;
+  }
+  sleep_us(RUN_US);
+  after = em->fread(em);
+  if (energymon_get_generation_shmem(em) != 4 || after < before) {
+    fprintf(stderr, "Didn't follow a provider that crashed during an update: generation=%"PRIu32", %"PRIu64" -> %"
+            PRIu64"\n", energymon_get_generation_shmem(em), before, after);
+    return -1;
+  }
+  return 0;
+}
+
+int main(void) {
+  char dir[] = "/tmp/energymon-shmem-restart-test-XXXXXX";
+  char id[8];
+  energymon em;
+  provider p[4];
+  pthread_t writer_thread;
+  pthread_t threads[N_READERS + 1];
+  int n_threads;
+  int ret = -1;
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  snprintf(id, sizeof(id), "%d", TEST_KEY_ID);
+  setenv(ENERGYMON_SHMEM_DIR, dir, 1);
+  setenv(ENERGYMON_SHMEM_ID, id, 1);
+  key = ftok(dir, TEST_KEY_ID);
+  energymon_get_shmem(&em);
+
+  if (create_provider(&p[0], 1)) {
+    rmdir(dir);
+    return 1;
+  }
+  if (em.finit(&em)) {
+    perror("energymon_init_shmem");
+    remove_provider(&p[0]);
+    rmdir(dir);
+    return 1;
+  }
+  if ((errno = pthread_create(&writer_thread, NULL, writer, NULL))) {
+    perror("pthread_create");
+  } else {
+    for (n_threads = 0; n_threads < N_READERS + 1; n_threads++) {
+      if ((errno = pthread_create(&threads[n_threads], NULL, n_threads < N_READERS ? reader : waiter, &em))) {
+        perror("pthread_create");
+        break;
+      }
+    }
+    sleep_us(RUN_US);
+    if (n_threads == N_READERS + 1) {
+      ret = restart(&em, p);
+    }
+    // keep updating until the waiter returns
+    __atomic_store_n(&running, 0, __ATOMIC_RELAXED);
+    while (n_threads > 0) {
+      pthread_join(threads[--n_threads], NULL);
+    }
+    __atomic_store_n(&writer_running, 0, __ATOMIC_RELAXED);
+    pthread_join(writer_thread, NULL);
+  }
+  if (live != NULL) {
+    remove_provider(live);
+  }
+  if (em.ffinish(&em)) {
+    perror("energymon_finish_shmem");
+    ret = -1;
+  }
+  rmdir(dir);
+  return ret || __atomic_load_n(&failed, __ATOMIC_RELAXED) ? 1 : 0;
+}
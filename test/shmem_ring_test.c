@@ -0,0 +1,128 @@
+/**
+ * Test reading shmem sample rings, including a slot that a provider died while overwriting.
+ * The provider is faked in-process with System V shared memory.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+#include "energymon.h"
+#include "energymon-shmem.h"
+
+#define TEST_KEY_ID 44
+#define RING_LEN 4
+#define N_SAMPLES 6
+#define SHM_SIZE (sizeof(energymon_shmem_v2) + sizeof(energymon_shmem_channel) + \
+                  RING_LEN * sizeof(energymon_shmem_ring_slot))
+
+static energymon_shmem_channel* channel;
+static energymon_shmem_ring_slot* ring;
+
+// the provider's side of the ring protocol, optionally dying before the slot is complete
+static void push_sample(uint64_t seq, int die) {
+  energymon_shmem_ring_slot* slot = &ring[seq & (RING_LEN - 1)];
+  slot->seq = 0;
+  if (die) {
+    return;
+  }
+  slot->time_ns = seq * 1000;
+  slot->energy_uj = seq * 10;
+  slot->seq = seq;
+  channel->ring_head = seq;
+}
+
+static int check_samples(const energymon* em, uint64_t since, uint64_t first, uint64_t last) {
+  energymon_shmem_sample samples[2 * RING_LEN];
+  size_t n;
+  size_t i;
+  errno = 0;
+  n = energymon_read_samples_shmem(em, since, samples, 2 * RING_LEN);
+  if (errno) {
+    perror("energymon_read_samples_shmem");
+    return -1;
+  }
+  if (n != last - first + 1) {
+    fprintf(stderr, "Expected samples %"PRIu64"-%"PRIu64" since %"PRIu64", got %zu\n", first, last, since, n);
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    if (samples[i].seq != first + i || samples[i].energy_uj != samples[i].seq * 10 ||
+        samples[i].time_ns != samples[i].seq * 1000) {
+      fprintf(stderr, "Bad sample at %zu: seq=%"PRIu64", energy_uj=%"PRIu64"\n", i, samples[i].seq,
+              samples[i].energy_uj);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  char dir[] = "/tmp/energymon-shmem-ring-test-XXXXXX";
+  char id[8];
+  energymon em;
+  energymon_shmem_v2* ems;
+  uint64_t i;
+  int shm_id;
+  int ret = 0;
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  snprintf(id, sizeof(id), "%d", TEST_KEY_ID);
+  setenv(ENERGYMON_SHMEM_DIR, dir, 1);
+  setenv(ENERGYMON_SHMEM_ID, id, 1);
+  if ((shm_id = shmget(ftok(dir, TEST_KEY_ID), SHM_SIZE, 0644 | IPC_CREAT | IPC_EXCL)) < 0) {
+    perror("shmget");
+    rmdir(dir);
+    return 1;
+  }
+  if ((ems = shmat(shm_id, NULL, 0)) == (void*) -1) {
+    perror("shmat");
+    shmctl(shm_id, IPC_RMID, NULL);
+    rmdir(dir);
+    return 1;
+  }
+  channel = (energymon_shmem_channel*) (ems + 1);
+  ring = (energymon_shmem_ring_slot*) (channel + 1);
+  ems->abi_version = ENERGYMON_SHMEM_ABI_VERSION;
+  ems->interval_us = 1000;
+  ems->n_channels = 1;
+  ems->channel_size = sizeof(energymon_shmem_channel);
+  ems->ring_len = RING_LEN;
+  ems->ring_slot_size = sizeof(energymon_shmem_ring_slot);
+  ems->generation = 1;
+  strcpy(channel->name, "test");
+  ems->magic = ENERGYMON_SHMEM_MAGIC;
+  for (i = 1; i <= N_SAMPLES; i++) {
+    push_sample(i, 0);
+  }
+
+  energymon_get_shmem(&em);
+  if (em.finit(&em)) {
+    perror("energymon_init_shmem");
+    ret = 1;
+  } else {
+    // overwritten samples are skipped
+    ret |= check_samples(&em, 1, N_SAMPLES - RING_LEN + 1, N_SAMPLES);
+    ret |= check_samples(&em, N_SAMPLES - 1, N_SAMPLES - 1, N_SAMPLES);
+    // the provider dies while overwriting the oldest sample, so the ring head never moves past it
+    push_sample(N_SAMPLES + 1, 1);
+    ret |= check_samples(&em, 1, N_SAMPLES - RING_LEN + 2, N_SAMPLES);
+    if (em.ffinish(&em)) {
+      perror("energymon_finish_shmem");
+      ret = 1;
+    }
+  }
+  shmdt(ems);
+  shmctl(shm_id, IPC_RMID, NULL);
+  rmdir(dir);
+  return ret ? 1 : 0;
+}
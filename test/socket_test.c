@@ -0,0 +1,227 @@
+/**
+ * Test the socket client against an energymon-server hosting the dummy implementation.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "energymon.h"
+#include "energymon-socket.h"
+
+#define SAMPLE_INTERVAL_US 1000
+#define N_SAMPLES 5
+#define N_THREADS 4
+#define N_THREAD_READS 1000
+
+static char path[64];
+
+#define CHECK(cond) \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+    return -1; \
+  }
+
+static int connect_socket(void) {
+  struct sockaddr_un addr;
+  int ret;
+  int fd;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    return -1;
+  }
+  ret = connect(fd, (struct sockaddr*) &addr, sizeof(addr));
+  close(fd);
+  return ret;
+}
+
+static int wait_for_socket(pid_t pid) {
+  const struct timespec ts = { 0, 10000000 };
+  int i;
+  // the socket file exists before the server starts, so wait until it's listening
+  for (i = 0; i < 500; i++) {
+    if (connect_socket() == 0) {
+      return 0;
+    }
+    if (waitpid(pid, NULL, WNOHANG) == pid) {
+      fprintf(stderr, "Server exited\n");
+      return -1;
+    }
+    nanosleep(&ts, NULL);
+  }
+  fprintf(stderr, "Timed out waiting for server\n");
+  return -1;
+}
+
+static int test_read(void) {
+  energymon em;
+  char buf[ENERGYMON_SOCKET_NAME_LEN];
+  uint64_t energy_uj;
+  energymon_get_socket(&em);
+  CHECK(em.finit(&em) == 0);
+  errno = 0;
+  em.fread(&em);
+  CHECK(errno == 0);
+  CHECK(em.finterval(&em) > 0);
+  CHECK(energymon_get_channel_count_socket(&em) == 1);
+  CHECK(energymon_get_channel_name_socket(&em, 0, buf, sizeof(buf)) != NULL && !strcmp(buf, "dummy"));
+  CHECK(energymon_get_channel_name_socket(&em, 1, buf, sizeof(buf)) == NULL && errno == EINVAL);
+  errno = 0;
+  energymon_read_channels_socket(&em, &energy_uj, 1);
+  CHECK(errno == 0);
+  CHECK(em.ffinish(&em) == 0);
+  return 0;
+}
+
+static int test_channel(void) {
+  energymon em;
+  setenv(ENERGYMON_SOCKET_CHANNEL, "dummy", 1);
+  energymon_get_socket(&em);
+  CHECK(em.finit(&em) == 0);
+  CHECK(em.ffinish(&em) == 0);
+  setenv(ENERGYMON_SOCKET_CHANNEL, "nope", 1);
+  CHECK(em.finit(&em) == -1 && errno == ENOENT);
+  unsetenv(ENERGYMON_SOCKET_CHANNEL);
+  return 0;
+}
+
+static void* concurrent_reader(void* arg) {
+  const energymon* em = (const energymon*) arg;
+  char buf[ENERGYMON_SOCKET_NAME_LEN];
+  int i;
+  for (i = 0; i < N_THREAD_READS; i++) {
+    // mix requests whose responses differ, so that a response delivered to the wrong thread is detected
+    errno = 0;
+    em->fread(em);
+    if (errno || energymon_get_channel_name_socket(em, 0, buf, sizeof(buf)) == NULL || strcmp(buf, "dummy")) {
+      perror("concurrent_reader");
+      return (void*) 1;
+    }
+  }
+  return NULL;
+}
+
+static int test_concurrent(void) {
+  energymon em;
+  pthread_t threads[N_THREADS];
+  void* result;
+  int failed = 0;
+  int i;
+  energymon_get_socket(&em);
+  CHECK(em.finit(&em) == 0);
+  for (i = 0; i < N_THREADS; i++) {
+    CHECK(pthread_create(&threads[i], NULL, concurrent_reader, &em) == 0);
+  }
+  for (i = 0; i < N_THREADS; i++) {
+    failed |= pthread_join(threads[i], &result) || result != NULL;
+  }
+  CHECK(!failed);
+  CHECK(em.ffinish(&em) == 0);
+  return 0;
+}
+
+// leave a socket behind, as a server that crashed would
+static int create_stale_socket(void) {
+  struct sockaddr_un addr;
+  int fd;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  CHECK((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0);
+  CHECK(bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+  close(fd);
+  return 0;
+}
+
+static int test_subscribe(void) {
+  energymon em;
+  energymon_socket_sample sample;
+  uint64_t last_ns = 0;
+  int i;
+  energymon_get_socket(&em);
+  CHECK(em.finit(&em) == 0);
+  CHECK(energymon_recv_sample_socket(&em, &sample) == -1 && errno == EINVAL);
+  CHECK(energymon_subscribe_socket(&em, SAMPLE_INTERVAL_US) == 0);
+  for (i = 0; i < N_SAMPLES; i++) {
+    CHECK(energymon_recv_sample_socket(&em, &sample) == 0);
+    CHECK(sample.time_ns > last_ns);
+    last_ns = sample.time_ns;
+    // request/response still works while subscribed
+    errno = 0;
+    em.fread(&em);
+    CHECK(errno == 0);
+  }
+  CHECK(energymon_unsubscribe_socket(&em) == 0);
+  CHECK(em.ffinish(&em) == 0);
+  return 0;
+}
+
+static int test_map(void) {
+  energymon em;
+  setenv(ENERGYMON_SOCKET_MAP, "1", 1);
+  energymon_get_socket(&em);
+  CHECK(em.finit(&em) == 0);
+  errno = 0;
+  em.fread(&em);
+  CHECK(errno == 0);
+  CHECK(em.ffinish(&em) == 0);
+  unsetenv(ENERGYMON_SOCKET_MAP);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  energymon em;
+  pid_t pid;
+  int status;
+  int ret;
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s SERVER\n", argv[0]);
+    return 1;
+  }
+  snprintf(path, sizeof(path), "/tmp/energymon-socket-test-%d.sock", (int) getpid());
+  if (create_stale_socket()) {
+    return 1;
+  }
+  if ((pid = fork()) < 0) {
+    perror("fork");
+    return 1;
+  }
+  if (pid == 0) {
+    execl(argv[1], argv[1], "-b", "dummy", "-s", path, (char*) NULL);
+    perror(argv[1]);
+    _exit(127);
+  }
+  if (wait_for_socket(pid)) {
+    kill(pid, SIGKILL);
+    return 1;
+  }
+  setenv(ENERGYMON_SOCKET, path, 1);
+  ret = test_read() || test_channel() || test_concurrent() || test_subscribe() || test_map();
+  kill(pid, SIGTERM);
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "Server didn't exit cleanly\n");
+    ret = 1;
+  }
+  // the server removes its socket on exit
+  energymon_get_socket(&em);
+  if (em.finit(&em) == 0 || errno != ENOENT) {
+    fprintf(stderr, "Socket wasn't removed\n");
+    unlink(path);
+    ret = 1;
+  }
+  return ret ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+/**
+ * Test sysfs topology discovery against a fixture directory tree.
+ *
+ * @author Connor Imes
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "energymon-topology.h"
+#include "energymon-topology-util.h"
+
+// 2 packages, package 1 has 2 dies, cpu5 is offline; 2 NUMA nodes, one per package
+#define N_CPUS 6
+static const int PKG[N_CPUS] = { 0, 0, 1, 1, 1, 1 };
+static const int DIE[N_CPUS] = { 0, 0, 0, 0, 1, 1 };
+
+static char root[64];
+
+static int write_file(const char* rel, const char* content) {
+  char path[256];
+  char* p;
+  FILE* f;
+  snprintf(path, sizeof(path), "%s/%s", root, rel);
+  // mkdir -p
+  for (p = strchr(path + strlen(root) + 1, '/'); p; p = strchr(p + 1, '/')) {
+    *p = '\0';
+    if (mkdir(path, 0755) && errno != EEXIST) {
+      perror(path);
+      return -1;
+    }
+    *p = '/';
+  }
+  if ((f = fopen(path, "w")) == NULL) {
+    perror(path);
+    return -1;
+  }
+  fputs(content, f);
+  fclose(f);
+  return 0;
+}
+
+static int create_fixture(void) {
+  char rel[128];
+  char val[16];
+  int cpu;
+  snprintf(root, sizeof(root), "/tmp/energymon-topology-test-XXXXXX");
+  if (mkdtemp(root) == NULL) {
+    perror("mkdtemp");
+    return -1;
+  }
+  if (write_file("devices/system/cpu/online", "0-4\n") ||
+      write_file("devices/system/node/node0/cpulist", "0-1\n") ||
+      write_file("devices/system/node/node1/cpulist", "2-4\n") ||
+      write_file("devices/system/node/possible", "0-1\n")) {
+    return -1;
+  }
+  for (cpu = 0; cpu < N_CPUS - 1; cpu++) {
+    snprintf(rel, sizeof(rel), "devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    snprintf(val, sizeof(val), "%d\n", PKG[cpu]);
+    if (write_file(rel, val)) {
+      return -1;
+    }
+    // package 0 emulates a kernel without die_id
+    if (PKG[cpu] == 1) {
+      snprintf(rel, sizeof(rel), "devices/system/cpu/cpu%d/topology/die_id", cpu);
+      snprintf(val, sizeof(val), "%d\n", DIE[cpu]);
+      if (write_file(rel, val)) {
+        return -1;
+      }
+    }
+  }
+  return write_file("devices/system/cpu/cpu5/online", "0\n");
+}
+
+#define CHECK(cond) \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+    return -1; \
+  }
+
+static int test_parse_cpulist(void) {
+  uint64_t mask[ENERGYMON_TOPOLOGY_CPU_WORDS];
+  CHECK(energymon_topology_parse_cpulist("0-3,8,64-65\n", 12, mask) == 7);
+  CHECK(mask[0] == 0x10F && mask[1] == 0x3);
+  CHECK(energymon_topology_parse_cpulist("\n", 1, mask) == 0);
+  CHECK(energymon_topology_parse_cpulist("1,", 2, mask) == -1);
+  CHECK(energymon_topology_parse_cpulist("3-1", 3, mask) == -1);
+  CHECK(energymon_topology_parse_cpulist("0,x", 3, mask) == -1);
+  CHECK(energymon_topology_parse_cpulist("1024", 4, mask) == -1 && errno == ERANGE);
+  return 0;
+}
+
+static int test_fixture(void) {
+  energymon_topology topo;
+  int pkg;
+  int die;
+  CHECK(energymon_topology_get_cpu_ids(root, 1, &pkg, &die) == 0);
+  CHECK(pkg == 0 && die == 0);
+  CHECK(energymon_topology_get_cpu_ids(root, 4, &pkg, &die) == 0);
+  CHECK(pkg == 1 && die == 1);
+  CHECK(energymon_topology_get_cpu_ids(root, 5, &pkg, &die) == -1 && errno == ENODEV);
+
+  CHECK(energymon_topology_get_cpu(root, 1, &topo) == 0);
+  CHECK(topo.package_id == 0 && topo.die_id == 0 && topo.numa_node == 0);
+  CHECK(topo.cpu_count == 2 && topo.cpus[0] == 0x3);
+  CHECK(energymon_topology_has_cpu(&topo, 0) && !energymon_topology_has_cpu(&topo, 2));
+
+  CHECK(energymon_topology_get_cpu(root, 3, &topo) == 0);
+  CHECK(topo.package_id == 1 && topo.die_id == 0 && topo.numa_node == 1);
+  CHECK(topo.cpu_count == 2 && topo.cpus[0] == 0xC);
+
+  // whole package, excluding offline cpu5
+  CHECK(energymon_topology_get_package(root, 1, -1, &topo) == 0);
+  CHECK(topo.package_id == 1 && topo.die_id == -1 && topo.numa_node == 1);
+  CHECK(topo.cpu_count == 3 && topo.cpus[0] == 0x1C);
+
+  // platform-wide spans both nodes
+  CHECK(energymon_topology_get_package(root, -1, -1, &topo) == 0);
+  CHECK(topo.package_id == -1 && topo.die_id == -1 && topo.numa_node == -1);
+  CHECK(topo.cpu_count == 5 && topo.cpus[0] == 0x1F);
+
+  CHECK(energymon_topology_get_package(root, 2, -1, &topo) == -1 && errno == ENODEV);
+  return 0;
+}
+
+static int test_package_cpus(void) {
+  uint64_t avoid[ENERGYMON_TOPOLOGY_CPU_WORDS];
+  unsigned int cpus[4] = { 0 };
+  // one CPU per (package, die): (0, 0), (1, 0), (1, 1)
+  CHECK(energymon_topology_get_package_cpus(root, NULL, cpus, 4) == 3);
+  CHECK(cpus[0] == 0 && cpus[1] == 2 && cpus[2] == 4);
+  // only the first n are written
+  cpus[1] = 99;
+  CHECK(energymon_topology_get_package_cpus(root, NULL, cpus, 1) == 3);
+  CHECK(cpus[0] == 0 && cpus[1] == 99);
+  // avoided CPUs are only used if there's no alternative (cpu5 is offline)
+  CHECK(energymon_topology_parse_cpulist("0,2,4", 5, avoid) == 3);
+  CHECK(energymon_topology_get_package_cpus(root, avoid, cpus, 4) == 3);
+  CHECK(cpus[0] == 1 && cpus[1] == 3 && cpus[2] == 4);
+  return 0;
+}
+
+int main(void) {
+  char cmd[96];
+  int ret;
+  if (test_parse_cpulist() || create_fixture()) {
+    return 1;
+  }
+  ret = test_fixture() || test_package_cpus();
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+  if (system(cmd)) {
+    fprintf(stderr, "Failed to remove fixture: %s\n", root);
+  }
+  return ret ? 1 : 0;
+}
@@ -121,6 +121,7 @@ int main(int argc, char** argv) {
   energymon em;
   uint64_t min_interval;
   uint64_t energy;
+  energymon_timer timer = { 0 };
   FILE* fout = stdout;
   int ret = 0;
 
@@ -161,6 +162,11 @@ int main(int argc, char** argv) {
   }
 
   // update file at regular intervals
+  if (energymon_timer_init(&timer, interval)) {
+    perror("energymon_timer_init");
+    ret = 1;
+    running = 0;
+  }
   while (running) {
     if (count) {
       running--;
@@ -193,9 +199,12 @@ int main(int argc, char** argv) {
     }
     fflush(fout);
     if (running) {
-      energymon_sleep_us(interval, &running);
+      energymon_timer_wait(&timer, &running);
     }
   }
+  if (timer.missed) {
+    fprintf(stderr, "Missed %"PRIu64" update deadlines, the interval may be too short\n", timer.missed);
+  }
 
   // cleanup
   if (em.ffinish(&em)) {
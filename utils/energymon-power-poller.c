@@ -132,6 +132,7 @@ int main(int argc, char** argv) {
   uint64_t energy_last;
   uint64_t last_us;
   uint64_t exec_us;
+  energymon_timer timer = { 0 };
   float power;
   uint64_t n = 0;
   float pmin = FLT_MAX;
@@ -182,7 +183,13 @@ int main(int argc, char** argv) {
   // output at regular intervals
   energy_last = em.fread(&em);
   last_us = energymon_gettime_us();
-  energymon_sleep_us(interval, &IGNORE_INTERRUPT);
+  if (energymon_timer_init(&timer, interval)) {
+    perror("energymon_timer_init");
+    ret = 1;
+    running = 0;
+  } else {
+    energymon_timer_wait(&timer, &IGNORE_INTERRUPT);
+  }
   while (running) {
     if (count) {
       running--;
@@ -218,9 +225,12 @@ int main(int argc, char** argv) {
     }
     pstd = pstd + (power - pavg) * (power - pavg_last);
     if (running) {
-      energymon_sleep_us(interval, &IGNORE_INTERRUPT);
+      energymon_timer_wait(&timer, &IGNORE_INTERRUPT);
     }
   }
+  if (timer.missed) {
+    fprintf(stderr, "Missed %"PRIu64" polling deadlines, the interval may be too short\n", timer.missed);
+  }
 
   if (summarize) {
     fprintf(fout, "Samples: %"PRIu64"\n", n);
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "energymon.h"
+#include "energymon-integrator.h"
 #include "energymon-time-util.h"
 #include "energymon-wattsup.h"
 #include "wattsup-driver.h"
@@ -27,9 +28,7 @@ int energymon_get_default(energymon* em) {
 #endif
 
 // Environment variable to enable updating energy estimates b/w device reads.
-// This can provide faster energy data, but risks the total energy being more
-// inaccurate in the long run.
-// Keeping this as an undocumented feature for now.
+// Superseded by ENERGYMON_ENABLE_ESTIMATES, but still supported.
 #define ENERGYMON_WATTSUP_ENABLE_ESTIMATES "ENERGYMON_WATTSUP_ENABLE_ESTIMATES"
 
 // WattsUp values refresh every second
@@ -50,46 +49,24 @@ typedef struct energymon_wattsup {
 
   int poll;
   pthread_t thread;
-  int use_estimates;
 
-  uint64_t exec_us;
-  uint64_t last_us;
   unsigned int deciwatts;
-  int lock;
-  uint64_t total_uj;
+  energymon_integrator integrator;
 } energymon_wattsup;
 
-static void lock_acquire(int* lock) {
-  assert(lock != NULL);
-#if defined(_WIN32)
-  while (InterlockedExchange((long*) lock, 1)) {
-#else
-  while (__sync_lock_test_and_set(lock, 1)) {
-#endif
-    while (*lock);
-  }
-}
-
-static void lock_release(int* lock) {
-#if defined(_WIN32)
-  InterlockedExchange((long*) lock, 0);
-#else
-  __sync_lock_release(lock);
-#endif
-}
-
 // Only for use by the polling thread - enables pthread cancel while sleeping, then disables it
-static int wattsup_thread_sleep_us(uint64_t us, volatile const int* poll) {
+// If timer is not NULL, sleeps until its next deadline instead of for the given time
+static int wattsup_thread_sleep_us(uint64_t us, energymon_timer* timer, volatile const int* poll) {
   assert(poll != NULL);
   int ret = 0;
   if (*poll) {
 #ifndef __ANDROID__
     // Deadlock can occur during disconnect in some wattsup_driver impls if thread is canceled during I/O
-    // Enable thread cancel while sleeping, disable during I/O and when holding locks
+    // Enable thread cancel while sleeping, disable during I/O
     int dummy_old_state;
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &dummy_old_state);
 #endif
-    ret = energymon_sleep_us(us, poll);
+    ret = timer == NULL ? energymon_sleep_us(us, poll) : energymon_timer_wait(timer, poll);
 #ifndef __ANDROID__
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &dummy_old_state);
 #endif
@@ -172,7 +149,7 @@ static char* data_packet_read(energymon_wattsup_ctx* ctx, char* buf, size_t bufs
       return NULL;
     }
     // short wait before reading again to try and get the rest of the packet
-    wattsup_thread_sleep_us(WU_PACKET_WAIT_INTERVAL_US, poll);
+    wattsup_thread_sleep_us(WU_PACKET_WAIT_INTERVAL_US, NULL, poll);
     if (!(*poll)) {
       // we were probably ordered to stop during I/O or sleep
       return NULL;
@@ -202,26 +179,21 @@ static void* wattsup_poll_sensors(void* args) {
   energymon_wattsup* state = (energymon_wattsup*) args;
   char buf[WU_BUFSIZE] = { 0 };
   char* pstart;
+  energymon_timer timer;
   state->deciwatts = 0;
-  if (!(state->last_us = energymon_gettime_us())) {
+  if (energymon_timer_init(&timer, WU_POLL_INTERVAL_US)) {
     // must be that CLOCK_MONOTONIC is not supported
     perror("wattsup_poll_sensors");
     return (void*) NULL;
   }
-  wattsup_thread_sleep_us(WU_POLL_INTERVAL_US, &state->poll);
+  wattsup_thread_sleep_us(WU_POLL_INTERVAL_US, &timer, &state->poll);
   while (state->poll) {
     if ((pstart = data_packet_read(state->ctx, buf, sizeof(buf), &state->poll))) {
       data_packet_parse(pstart, &state->deciwatts);
     }
-    if (state->use_estimates) {
-      lock_acquire(&state->lock);
-    }
-    state->exec_us = energymon_gettime_elapsed_us(&state->last_us);
-    state->total_uj += state->deciwatts * state->exec_us / 10;
-    if (state->use_estimates) {
-      lock_release(&state->lock);
-    }
-    wattsup_thread_sleep_us(WU_POLL_INTERVAL_US, &state->poll);
+    // deciwatts to microwatts - the device sends new readings when ready, so anchor them to when they were received
+    energymon_integrator_update(&state->integrator, (uint64_t) state->deciwatts * 100000, energymon_gettime_us());
+    wattsup_thread_sleep_us(WU_POLL_INTERVAL_US, &timer, &state->poll);
   }
   return (void*) NULL;
 }
@@ -305,7 +277,15 @@ int energymon_init_wattsup(energymon* em) {
   }
 
   // set state properties
-  state->use_estimates = getenv(ENERGYMON_WATTSUP_ENABLE_ESTIMATES) != NULL;
+  if (energymon_integrator_init(&state->integrator, (getenv(ENERGYMON_WATTSUP_ENABLE_ESTIMATES) != NULL ||
+                                                     getenv(ENERGYMON_ENABLE_ESTIMATES) != NULL) ?
+                                                    WU_POLL_INTERVAL_US : 0)) {
+    err_save = errno;
+    wattsup_disconnect(state->ctx);
+    free(state);
+    errno = err_save;
+    return -1;
+  }
 
   // start polling thread
   state->poll = 1;
@@ -360,15 +340,8 @@ uint64_t energymon_read_total_wattsup(const energymon* em) {
     errno = EINVAL;
     return 0;
   }
-  energymon_wattsup* state = (energymon_wattsup*) em->state;
   errno = 0;
-  if (state->use_estimates) {
-    lock_acquire(&state->lock);
-    state->exec_us = energymon_gettime_elapsed_us(&state->last_us);
-    state->total_uj += state->deciwatts * state->exec_us / 10;
-    lock_release(&state->lock);
-  }
-  return state->total_uj;
+  return energymon_integrator_read(&((energymon_wattsup*) em->state)->integrator);
 }
 
 char* energymon_get_source_wattsup(char* buffer, size_t n) {
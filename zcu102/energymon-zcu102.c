@@ -9,14 +9,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "energymon.h"
 #include "energymon-zcu102.h"
-#include "energymon-time-util.h"
+#include "energymon-poller.h"
 #include "energymon-util.h"
 
 #ifdef ENERGYMON_DEFAULT
@@ -39,11 +38,8 @@ int energymon_get_default(energymon* em) {
 typedef struct energymon_zcu102 {
   // sensor update interval in microseconds
   unsigned long read_delay_us;
-  // thread variables
-  pthread_t thread;
-  int poll_sensors;
-  // total energy estimate
-  uint64_t total_uj;
+  // polls the sensors and integrates the total energy estimate
+  energymon_poller_source poller;
   // sensor file descriptors
   unsigned int count;
   int fds[];
@@ -51,7 +47,7 @@ typedef struct energymon_zcu102 {
 
 static inline unsigned long get_update_interval(char** sensors, unsigned int num) {
   unsigned long ret = 0;
-  unsigned long tmp;
+  uint64_t tmp;
   unsigned int i;
   char file[64];
   int fd;
@@ -75,13 +71,11 @@ static inline unsigned long get_update_interval(char** sensors, unsigned int num
       perror(file);
     }
     if (read_ret > 0) {
-      errno = 0;
-      tmp = strtoul(cdata, NULL, 0);
-      if (errno) {
+      if (!energymon_strntou64(cdata, (size_t) read_ret, &tmp)) {
         perror(file);
       } else {
         // keep the largest update_interval
-        ret = tmp > ret ? tmp : ret;
+        ret = tmp > ret ? (unsigned long) tmp : ret;
       }
     }
   }
@@ -105,13 +99,9 @@ int energymon_finish_zcu102(energymon* em) {
   unsigned int i;
   energymon_zcu102* state = (energymon_zcu102*) em->state;
 
-  if (state->poll_sensors) {
-    // stop sensors polling thread and cleanup
-    state->poll_sensors = 0;
-#ifndef __ANDROID__
-    pthread_cancel(state->thread);
-#endif
-    err_save = pthread_join(state->thread, NULL);
+  // stop polling sensors
+  if (energymon_poller_stop(&state->poller)) {
+    err_save = errno;
   }
 
   // close individual sensor files
@@ -172,56 +162,34 @@ static inline char** get_sensor_directories(unsigned int* count) {
 }
 
 /**
- * pthread function to poll the sensors at regular intervals.
+ * Read the sensors, called at regular intervals by the poller.
  */
-static void* zcu102_poll_sensors(void* args) {
-  energymon_zcu102* state = (energymon_zcu102*) args;
+static int zcu102_read_power(void* ctx, uint64_t* power_uw) {
+  const energymon_zcu102* state = (const energymon_zcu102*) ctx;
   char cdata[10];
-  double sum_w;
-  unsigned long sum_uw;
+  ssize_t len;
+  uint64_t uw;
+  uint64_t sum_uw;
   unsigned int i;
-  uint64_t exec_us;
-  uint64_t last_us;
-  uint64_t delta_uj;
-  int err_save;
-  if (!(last_us = energymon_gettime_us())) {
-    // must be that CLOCK_MONOTONIC is not supported
-    perror("zcu102_poll_sensors");
-    return (void*) NULL;
-  }
-  energymon_sleep_us(state->read_delay_us, &state->poll_sensors);
-  while (state->poll_sensors) {
-    // read individual sensors (values in microWatts)
-    for (sum_uw = 0, errno = 0, i = 0; i < state->count && !errno; i++) {
-      if (pread(state->fds[i], cdata, sizeof(cdata), 0) > 0) {
-        sum_uw += strtoul(cdata, NULL, 0);
-      }
+  // read individual sensors (values in microWatts)
+  for (sum_uw = 0, errno = 0, i = 0; i < state->count && !errno; i++) {
+    if ((len = pread(state->fds[i], cdata, sizeof(cdata), 0)) > 0 &&
+        energymon_strntou64(cdata, (size_t) len, &uw)) {
+      sum_uw += uw;
     }
-    err_save = errno;
-    exec_us = energymon_gettime_elapsed_us(&last_us);
-    if (err_save) {
-      errno = err_save;
-      perror("zcu102_poll_sensors: skipping power sensor reading");
-    } else {
-      sum_w = sum_uw / 1e6;
-      delta_uj = (uint64_t) (sum_w * (double) exec_us);
+  }
+  if (errno) {
+    return -1;
+  }
 #ifdef ENERGYMON_DEBUG
-      fprintf(stderr, "zcu102_poll_sensors: Read total power: %lu uW (%f W)\n", sum_uw, sum_w);
-      fprintf(stderr, "zcu102_poll_sensors: Calculated energy: %f W * %"PRIi64" us = %"PRIu64" uJ\n", sum_w, exec_us, delta_uj);
+  fprintf(stderr, "zcu102_read_power: Read total power: %"PRIu64" uW\n", sum_uw);
 #endif
-      state->total_uj += delta_uj;
-    }
-    // sleep for the update interval of the sensors
-    if (state->poll_sensors) {
-      energymon_sleep_us(state->read_delay_us, &state->poll_sensors);
-    }
-    errno = 0;
-  }
-  return (void*) NULL;
+  *power_uw = sum_uw;
+  return 0;
 }
 
 /**
- * Open all sensor files and start the thread to poll the sensors.
+ * Open all sensor files and start polling the sensors.
  */
 int energymon_init_zcu102(energymon* em) {
   if (em == NULL || em->state != NULL) {
@@ -273,10 +241,12 @@ int energymon_init_zcu102(energymon* em) {
   // we're finished with this variable
   free_sensor_directories(sensor_dirs, state->count);
 
-  // start sensors polling thread
-  state->poll_sensors = 1;
-  errno = pthread_create(&state->thread, NULL, zcu102_poll_sensors, state);
-  if (errno) {
+  // start polling sensors
+  state->poller.name = "energymon-zcu102";
+  state->poller.read = zcu102_read_power;
+  state->poller.ctx = state;
+  state->poller.interval_us = state->read_delay_us;
+  if (energymon_poller_start(&state->poller)) {
     err_save = errno;
     energymon_finish_zcu102(em);
     errno = err_save;
@@ -292,7 +262,7 @@ uint64_t energymon_read_total_zcu102(const energymon* em) {
     return 0;
   }
   errno = 0;
-  return ((energymon_zcu102*) em->state)->total_uj;
+  return energymon_poller_get_total_uj(&((energymon_zcu102*) em->state)->poller);
 }
 
 char* energymon_get_source_zcu102(char* buffer, size_t n) {